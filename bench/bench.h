@@ -0,0 +1,41 @@
+#ifndef __BENCH__
+#define __BENCH__
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+	typedef std::chrono::steady_clock clock;
+
+	struct options
+	{
+		// 0 for one per core
+		std::size_t threads = 0;
+		// multiplies every problem size
+		std::size_t scale = 1;
+		// where trees are built for the walker runs
+		std::string dir;
+	};
+
+	std::size_t threads(const options& o);
+	double seconds(clock::time_point start);
+	// p is in percent; sorts samples
+	std::uint64_t percentile(std::vector<std::uint64_t>& samples, double p);
+	// one line per result, so runs diff and grep well
+	void report(const std::string& name, std::size_t threads, double value,
+		const char* unit);
+	// a busy loop of about the given length, without touching memory
+	void spin(std::chrono::nanoseconds length);
+
+	void thread_pool(const options& o);
+	void parallel(const options& o);
+	void scheduler(const options& o);
+	void parallel_walker(const options& o);
+	void placement(const options& o);
+}
+
+#endif
+
@@ -0,0 +1,105 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace
+{
+	struct suite
+	{
+		const char* name;
+		void (*run)(const bench::options& o);
+	};
+
+	const suite suites[] = {
+		{ "thread_pool", bench::thread_pool },
+		{ "parallel", bench::parallel },
+		{ "scheduler", bench::scheduler },
+		{ "parallel_walker", bench::parallel_walker },
+		{ "placement", bench::placement }
+	};
+
+	void usage(void)
+	{
+		std::fprintf(stderr, "usage: bench [-t threads] [-s scale] [-d dir] [suite...]\nsuites:");
+		for (const suite& s : suites)
+			std::fprintf(stderr, " %s", s.name);
+		std::fprintf(stderr, "\n");
+	}
+}
+
+std::size_t bench::threads(const bench::options& o)
+{
+	if (o.threads != 0)
+		return o.threads;
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+double bench::seconds(bench::clock::time_point start)
+{
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+std::uint64_t bench::percentile(std::vector<std::uint64_t>& samples, double p)
+{
+	if (samples.empty())
+		return 0;
+	std::sort(samples.begin(), samples.end());
+	const std::size_t rank = static_cast<std::size_t>(
+		std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(samples.size() - 1));
+	return samples[rank];
+}
+
+void bench::report(const std::string& name, std::size_t threads, double value,
+	const char* unit)
+{
+	std::printf("%-48s %4zu %14.2f %s\n", name.c_str(), threads, value, unit);
+	std::fflush(stdout);
+}
+
+void bench::spin(std::chrono::nanoseconds length)
+{
+	const clock::time_point end = clock::now() + length;
+	while (clock::now() < end)
+		;
+}
+
+int main(int argc, char* argv[])
+{
+	bench::options o;
+	o.dir = (std::filesystem::temp_directory_path() / "sys.bench").string();
+	std::vector<const suite*> selected;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 < argc && std::strcmp(argv[i], "-t") == 0)
+			o.threads = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (i + 1 < argc && std::strcmp(argv[i], "-s") == 0)
+			o.scale = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+		else if (i + 1 < argc && std::strcmp(argv[i], "-d") == 0)
+			o.dir = argv[++i];
+		else
+		{
+			const suite* found = nullptr;
+			for (const suite& s : suites)
+				if (std::strcmp(argv[i], s.name) == 0)
+					found = &s;
+			if (found == nullptr)
+			{
+				usage();
+				return 1;
+			}
+			selected.push_back(found);
+		}
+	}
+	if (selected.empty())
+		for (const suite& s : suites)
+			selected.push_back(&s);
+
+	for (const suite* s : selected)
+		s->run(o);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "sys.parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <version>
+
+// libstdc++ runs the parallel algorithms on TBB, so link with -ltbb there
+#if defined(__cpp_lib_execution)
+#include <execution>
+#endif
+
+static const std::size_t parallel_elements = 1 << 24;
+static const int parallel_repeats = 5;
+
+namespace
+{
+	// the best of a few runs, as the first one also pays for page faults
+	template<class Function>
+	void measure(const std::string& name, std::size_t threads, Function f)
+	{
+		double best = 0;
+		for (int i = 0; i < parallel_repeats; ++i)
+		{
+			const bench::clock::time_point start = bench::clock::now();
+			f();
+			const double elapsed = bench::seconds(start);
+			if (i == 0 || elapsed < best)
+				best = elapsed;
+		}
+		bench::report(name, threads, best * 1000, "ms");
+	}
+
+	// an element wise kernel heavy enough not to be bound by memory
+	inline double kernel(double x)
+	{
+		return std::sqrt(x) * std::sin(x);
+	}
+}
+
+void bench::parallel(const bench::options& o)
+{
+	const std::size_t n = parallel_elements * o.scale;
+	const std::size_t threads = bench::threads(o);
+	sys::thread_group group;
+	sys::thread_pool pool(group, threads);
+	sys::parallel_options options;
+	options.pool = &pool;
+
+	std::vector<double> input(n);
+	std::mt19937_64 random(42);
+	std::uniform_real_distribution<double> values(0, 1000000);
+	for (double& x : input)
+		x = values(random);
+	std::vector<double> output(n);
+
+	measure("parallel/for/sys", threads, [&]() {
+		sys::parallel_for(0, n, [&](std::size_t i) { output[i] = kernel(input[i]); },
+			options);
+	});
+	measure("parallel/transform/sys", threads, [&]() {
+		sys::parallel_transform(input.begin(), input.end(), output.begin(), kernel,
+			options);
+	});
+	measure("parallel/reduce/sys", threads, [&]() {
+		volatile double sum = sys::parallel_reduce(0, n, 0.0,
+			[&](std::size_t i) { return kernel(input[i]); }, std::plus<double>(),
+			options);
+		(void)sum;
+	});
+	measure("parallel/sort/sys", threads, [&]() {
+		output = input;
+		sys::parallel_sort(output.begin(), output.end(), std::less<double>(), options);
+	});
+
+#if defined(__cpp_lib_execution)
+	// the standard library picks its own thread count
+	measure("parallel/for/std::execution::par", 0, [&]() {
+		std::for_each(std::execution::par, input.begin(), input.end(),
+			[&](const double& x) { output[&x - input.data()] = kernel(x); });
+	});
+	measure("parallel/transform/std::execution::par", 0, [&]() {
+		std::transform(std::execution::par, input.begin(), input.end(),
+			output.begin(), kernel);
+	});
+	measure("parallel/reduce/std::execution::par", 0, [&]() {
+		volatile double sum = std::transform_reduce(std::execution::par,
+			input.begin(), input.end(), 0.0, std::plus<double>(), kernel);
+		(void)sum;
+	});
+	measure("parallel/sort/std::execution::par", 0, [&]() {
+		output = input;
+		std::sort(std::execution::par, output.begin(), output.end());
+	});
+#endif
+
+	measure("parallel/sort/std::sort", 1, [&]() {
+		output = input;
+		std::sort(output.begin(), output.end());
+	});
+}
\ No newline at end of file
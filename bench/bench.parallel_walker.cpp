@@ -0,0 +1,138 @@
+#include "bench.h"
+#include "sys.parallel_walker.h"
+#include "sys.thread_group.h"
+#include "sys.walker.h"
+
+#include <filesystem>
+#include <fstream>
+
+static const std::size_t wide_dirs = 256;
+static const std::size_t wide_files = 200;
+static const std::size_t deep_chains = 16;
+static const std::size_t deep_depth = 256;
+static const std::size_t deep_files = 8;
+static const std::size_t max_threads = 64;
+
+namespace
+{
+	class count_visitor : public sys::walk_visitor
+	{
+		struct alignas(64) counter
+		{
+			std::size_t entries = 0;
+		};
+
+		std::vector<counter> counters_;
+	public:
+		count_visitor(std::size_t workers)
+			: counters_(workers)
+		{
+		}
+
+		sys::walk_action_t visit(const sys::walk_entry&, std::size_t worker) override
+		{
+			++counters_[worker].entries;
+			return sys::walk_continue;
+		}
+
+		std::size_t entries(void) const
+		{
+			std::size_t total = 0;
+			for (const counter& c : counters_)
+				total += c.entries;
+			return total;
+		}
+	};
+
+	void touch(const std::filesystem::path& name)
+	{
+		std::ofstream file(name);
+	}
+
+	// trees are kept between runs, as building them takes longer than
+	// walking them
+	std::filesystem::path wide_tree(const bench::options& o)
+	{
+		const std::filesystem::path root = std::filesystem::path(o.dir) /
+			("wide." + std::to_string(o.scale));
+		if (std::filesystem::exists(root))
+			return root;
+		const std::filesystem::path tmp = root.string() + ".tmp";
+		std::filesystem::remove_all(tmp);
+		for (std::size_t d = 0; d < wide_dirs * o.scale; ++d)
+		{
+			const std::filesystem::path dir = tmp / ("d" + std::to_string(d));
+			std::filesystem::create_directories(dir);
+			for (std::size_t f = 0; f < wide_files; ++f)
+				touch(dir / ("f" + std::to_string(f)));
+		}
+		std::filesystem::rename(tmp, root);
+		return root;
+	}
+
+	std::filesystem::path deep_tree(const bench::options& o)
+	{
+		const std::filesystem::path root = std::filesystem::path(o.dir) /
+			("deep." + std::to_string(o.scale));
+		if (std::filesystem::exists(root))
+			return root;
+		const std::filesystem::path tmp = root.string() + ".tmp";
+		std::filesystem::remove_all(tmp);
+		for (std::size_t c = 0; c < deep_chains * o.scale; ++c)
+		{
+			std::filesystem::path dir = tmp / ("c" + std::to_string(c));
+			for (std::size_t d = 0; d < deep_depth; ++d, dir /= "d")
+			{
+				std::filesystem::create_directories(dir);
+				for (std::size_t f = 0; f < deep_files; ++f)
+					touch(dir / ("f" + std::to_string(f)));
+			}
+		}
+		std::filesystem::rename(tmp, root);
+		return root;
+	}
+
+	void walk(const std::string& name, const std::filesystem::path& root,
+		std::size_t limit)
+	{
+		const sys::path top(root.string());
+		std::size_t entries = 0;
+		bench::clock::time_point start = bench::clock::now();
+		sys::walker(top).walk([&entries](const sys::walk_entry&) {
+			++entries;
+			return sys::walk_continue;
+		});
+		bench::report(name + "/walker", 1,
+			static_cast<double>(entries) / bench::seconds(start), "entries/s");
+
+		for (std::size_t threads = 1; threads <= limit; threads *= 2)
+		{
+			sys::parallel_walk_options options;
+			options.threads = threads;
+			sys::thread_group group;
+			count_visitor visitor(threads);
+			start = bench::clock::now();
+			sys::parallel_walker(top, options).walk(group, visitor);
+			bench::report(name + "/parallel_walker", threads,
+				static_cast<double>(visitor.entries()) / bench::seconds(start),
+				"entries/s");
+		}
+	}
+}
+
+// the trees are walked once before timing, so these are warm cache
+// numbers; drop the caches between runs to see cold storage
+void bench::parallel_walker(const bench::options& o)
+{
+	const std::size_t limit = o.threads != 0 ? o.threads : max_threads;
+	const std::filesystem::path wide = wide_tree(o);
+	const std::filesystem::path deep = deep_tree(o);
+	sys::walker(sys::path(wide.string())).walk([](const sys::walk_entry&) {
+		return sys::walk_continue;
+	});
+	sys::walker(sys::path(deep.string())).walk([](const sys::walk_entry&) {
+		return sys::walk_continue;
+	});
+	walk("parallel_walker/wide", wide, limit);
+	walk("parallel_walker/deep", deep, limit);
+}
\ No newline at end of file
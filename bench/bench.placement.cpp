@@ -0,0 +1,88 @@
+#include "bench.h"
+#include "sys.cpu_topology.h"
+#include "sys.thread_group.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// per array and worker; well past the caches, so the triad is bound
+// by memory bandwidth
+static const std::size_t placement_elements = 1 << 21;
+static const int placement_repeats = 20;
+
+namespace
+{
+	struct policy
+	{
+		const char* name;
+		sys::placement_t placement;
+	};
+
+	const policy policies[] = {
+		{ "any", sys::placement_any },
+		{ "pinned", sys::placement_pinned },
+		{ "compact", sys::placement_compact },
+		{ "scatter", sys::placement_scatter },
+		{ "numa_node", sys::placement_numa_node }
+	};
+
+	void wait_for(std::atomic<std::size_t>& counter, std::size_t value)
+	{
+		while (counter.load(std::memory_order_acquire) < value)
+			std::this_thread::yield();
+	}
+
+	// STREAM triad; each worker allocates and first touches its arrays
+	// after create() has placed it, so they land on its node
+	void run(const policy& p, std::size_t threads, std::size_t n)
+	{
+		sys::thread_group group;
+		std::atomic<std::size_t> ready(0);
+		std::atomic<std::size_t> go(0);
+		std::vector<double> elapsed(threads);
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			sys::placement where;
+			where.policy = p.placement;
+			// pinned takes a cpu rather than a worker number
+			where.index = p.placement == sys::placement_pinned ?
+				static_cast<std::size_t>(sys::cpu_topology::system().compact_cpu(i)) : i;
+			group.create(where, [&, i]() {
+				std::vector<double> a(n, 0.0);
+				std::vector<double> b(n, 1.0);
+				std::vector<double> c(n, 2.0);
+				ready.fetch_add(1, std::memory_order_acq_rel);
+				wait_for(go, 1);
+				const bench::clock::time_point start = bench::clock::now();
+				for (int r = 0; r < placement_repeats; ++r)
+					for (std::size_t j = 0; j < n; ++j)
+						a[j] = b[j] + 3.0 * c[j];
+				elapsed[i] = bench::seconds(start);
+				// keeps the stores from being optimized away
+				volatile double sink = a[n / 2];
+				(void)sink;
+			});
+		}
+		wait_for(ready, threads);
+		go.store(1, std::memory_order_release);
+		group.join_all();
+
+		const double bytes = 3.0 * sizeof(double) * static_cast<double>(n) *
+			placement_repeats * static_cast<double>(threads);
+		const double slowest = *std::max_element(elapsed.begin(), elapsed.end());
+		const std::string prefix = std::string("placement/") + p.name;
+		bench::report(prefix + "/triad", threads, bytes / slowest / 1e9, "GB/s");
+		if (group.misplaced() != 0)
+			bench::report(prefix + "/misplaced", threads,
+				static_cast<double>(group.misplaced()), "threads");
+	}
+}
+
+void bench::placement(const bench::options& o)
+{
+	const std::size_t threads = bench::threads(o);
+	for (const policy& p : policies)
+		run(p, threads, placement_elements * o.scale);
+}
\ No newline at end of file
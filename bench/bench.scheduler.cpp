@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "sys.scheduler.h"
+#include "sys.thread_group.h"
+#include "sys.thread_pool.h"
+
+#include <atomic>
+#include <thread>
+
+static const std::chrono::seconds scheduler_duration(2);
+// lookups arrive at a steady rate while bulk work keeps every worker busy
+static const std::chrono::microseconds lookup_interval(250);
+static const std::chrono::microseconds lookup_length(20);
+static const std::chrono::microseconds bulk_length(2000);
+// queued bulk tasks per worker
+static const std::size_t bulk_depth = 2;
+
+namespace
+{
+	typedef enum
+	{
+		// both classes at one priority, which is one first in first out queue
+		mix_shared,
+		// lookups rank above bulk work
+		mix_priority,
+		// bulk work may hold all workers but one
+		mix_reserved
+	} mix_t;
+
+	void run(const char* name, mix_t mix, std::size_t threads,
+		std::chrono::nanoseconds duration)
+	{
+		sys::thread_group group;
+		sys::thread_pool pool(group, threads);
+		sys::scheduler s(pool);
+
+		sys::class_options lookup_options;
+		sys::class_options bulk_options;
+		if (mix == mix_priority)
+			lookup_options.priority = 1;
+		if (mix == mix_reserved)
+			bulk_options.max_running = threads - 1;
+		const sys::scheduler::class_id lookups = s.add_class(lookup_options);
+		const sys::scheduler::class_id bulk = s.add_class(bulk_options);
+
+		std::atomic<std::size_t> done(0);
+		std::size_t posted = 0;
+		const bench::clock::time_point end = bench::clock::now() + duration;
+		for (bench::clock::time_point next = bench::clock::now(); next < end;
+			next += lookup_interval)
+		{
+			while (s.queued(bulk) < threads * bulk_depth)
+			{
+				s.post(bulk, [&done]() {
+					bench::spin(bulk_length);
+					done.fetch_add(1, std::memory_order_relaxed);
+				});
+				++posted;
+			}
+			s.post(lookups, [&done]() {
+				bench::spin(lookup_length);
+				done.fetch_add(1, std::memory_order_relaxed);
+			});
+			++posted;
+			std::this_thread::sleep_until(next + lookup_interval);
+		}
+		while (done.load(std::memory_order_relaxed) != posted)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// wait is from post to start, recorded per class
+		const std::vector<sys::scheduler_class_stats> stats = s.statistics();
+		const std::string prefix = std::string("scheduler/") + name;
+		bench::report(prefix + "/lookup/p50", threads,
+			stats[lookups].wait.percentile(50) / 1000.0, "us");
+		bench::report(prefix + "/lookup/p99", threads,
+			stats[lookups].wait.percentile(99) / 1000.0, "us");
+		bench::report(prefix + "/bulk/p99", threads,
+			stats[bulk].wait.percentile(99) / 1000.0, "us");
+		bench::report(prefix + "/bulk/completed", threads,
+			static_cast<double>(stats[bulk].completed), "tasks");
+	}
+}
+
+void bench::scheduler(const bench::options& o)
+{
+	const std::size_t threads = bench::threads(o);
+	const std::chrono::nanoseconds duration = scheduler_duration * o.scale;
+	run("shared", mix_shared, threads, duration);
+	run("priority", mix_priority, threads, duration);
+	if (threads > 1)
+		run("reserved", mix_reserved, threads, duration);
+}
\ No newline at end of file
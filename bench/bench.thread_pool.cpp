@@ -0,0 +1,126 @@
+#include "bench.h"
+#include "sys.thread_group.h"
+#include "sys.thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <vector>
+
+static const std::size_t create_tasks = 20000;
+static const std::size_t pool_tasks = 1000000;
+static const std::size_t latency_samples = 5000;
+// create() keeps at most this many threads alive at once
+static const std::size_t create_batch = 256;
+
+namespace
+{
+	// short enough that starting a task is most of its cost
+	const std::chrono::nanoseconds task_length(1000);
+
+	void throughput_create(std::size_t tasks)
+	{
+		sys::thread_group group;
+		std::atomic<std::size_t> done(0);
+		const bench::clock::time_point start = bench::clock::now();
+		for (std::size_t i = 0; i < tasks; i += create_batch)
+		{
+			for (std::size_t j = i; j < std::min(tasks, i + create_batch); ++j)
+				group.create([&done]() {
+					bench::spin(task_length);
+					done.fetch_add(1, std::memory_order_relaxed);
+				});
+			group.join_all();
+		}
+		bench::report("thread_pool/throughput/create", create_batch,
+			static_cast<double>(tasks) / bench::seconds(start), "tasks/s");
+	}
+
+	void throughput_pool(sys::thread_pool& pool, std::size_t tasks)
+	{
+		std::atomic<std::size_t> done(0);
+		auto task = [&done]() {
+			bench::spin(task_length);
+			done.fetch_add(1, std::memory_order_release);
+		};
+		auto finished = [&done, tasks]() {
+			return done.load(std::memory_order_acquire) == tasks;
+		};
+
+		bench::clock::time_point start = bench::clock::now();
+		for (std::size_t i = 0; i < tasks; ++i)
+			pool.post(task);
+		pool.wait(finished);
+		bench::report("thread_pool/throughput/post", pool.size(),
+			static_cast<double>(tasks) / bench::seconds(start), "tasks/s");
+
+		done.store(0);
+		start = bench::clock::now();
+		std::vector<std::future<void>> futures;
+		futures.reserve(tasks);
+		for (std::size_t i = 0; i < tasks; ++i)
+			futures.push_back(pool.submit(task));
+		for (auto& f : futures)
+			f.get();
+		bench::report("thread_pool/throughput/submit", pool.size(),
+			static_cast<double>(tasks) / bench::seconds(start), "tasks/s");
+
+		done.store(0);
+		start = bench::clock::now();
+		auto results = pool.bulk_submit(tasks, [&task](std::size_t) { task(); });
+		for (auto& f : results)
+			f.get();
+		bench::report("thread_pool/throughput/bulk_submit", pool.size(),
+			static_cast<double>(tasks) / bench::seconds(start), "tasks/s");
+	}
+
+	// from asking for a task to it starting, one at a time, so every
+	// sample pays the wake-up of an idle pool or a new thread
+	void latency_create(std::size_t samples)
+	{
+		sys::thread_group group;
+		std::vector<std::uint64_t> latency(samples);
+		for (std::size_t i = 0; i < samples; ++i)
+		{
+			const bench::clock::time_point start = bench::clock::now();
+			std::uint64_t& sample = latency[i];
+			group.create([start, &sample]() {
+				sample = static_cast<std::uint64_t>(
+					(bench::clock::now() - start).count());
+			});
+			group.join_all();
+		}
+		bench::report("thread_pool/latency/create/p50", 1,
+			bench::percentile(latency, 50) / 1000.0, "us");
+		bench::report("thread_pool/latency/create/p99", 1,
+			bench::percentile(latency, 99) / 1000.0, "us");
+	}
+
+	void latency_pool(sys::thread_pool& pool, std::size_t samples)
+	{
+		std::vector<std::uint64_t> latency(samples);
+		for (std::size_t i = 0; i < samples; ++i)
+		{
+			const bench::clock::time_point start = bench::clock::now();
+			latency[i] = pool.submit([start]() {
+				return static_cast<std::uint64_t>(
+					(bench::clock::now() - start).count());
+			}).get();
+		}
+		bench::report("thread_pool/latency/submit/p50", pool.size(),
+			bench::percentile(latency, 50) / 1000.0, "us");
+		bench::report("thread_pool/latency/submit/p99", pool.size(),
+			bench::percentile(latency, 99) / 1000.0, "us");
+	}
+}
+
+void bench::thread_pool(const bench::options& o)
+{
+	throughput_create(create_tasks * o.scale);
+	latency_create(latency_samples * o.scale);
+
+	sys::thread_group group;
+	sys::thread_pool pool(group, bench::threads(o));
+	throughput_pool(pool, pool_tasks * o.scale);
+	latency_pool(pool, latency_samples * o.scale);
+}
\ No newline at end of file
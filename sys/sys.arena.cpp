@@ -0,0 +1,288 @@
+#include "sys.config.h"
+#include "sys.arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+
+static const std::size_t default_chunk_size = 64 * 1024;
+static const std::size_t slab_size = 64 * 1024;
+
+namespace
+{
+	struct registry
+	{
+		std::mutex mutex;
+		std::vector<sys::worker_memory*> workers;
+	};
+
+	// never destroyed, as pool threads can still exit after static
+	// destructors have run
+	registry& workers(void)
+	{
+		static registry* r = new registry;
+		return *r;
+	}
+
+	inline std::size_t class_of(std::size_t bytes)
+	{
+		return bytes <= 16 ? 0 : std::bit_width(bytes - 1) - 4;
+	}
+}
+
+sys::arena::arena(void)
+	: arena(default_chunk_size, std::pmr::new_delete_resource())
+{
+}
+
+sys::arena::arena(std::size_t chunk_size)
+	: arena(chunk_size, std::pmr::new_delete_resource())
+{
+}
+
+sys::arena::arena(std::size_t chunk_size, std::pmr::memory_resource* upstream)
+	: upstream_(upstream)
+	, chunk_size_(std::max<std::size_t>(chunk_size, 256))
+	, current_(0)
+	, offset_(0)
+	, used_(0)
+	, high_water_(0)
+	, reserved_(0)
+{
+}
+
+sys::arena::~arena(void)
+{
+	for (const chunk& c : chunks_)
+		upstream_->deallocate(c.data, c.size, alignof(std::max_align_t));
+}
+
+void sys::arena::reset(void)
+{
+	current_ = 0;
+	offset_ = 0;
+	used_.store(0, std::memory_order_relaxed);
+}
+
+std::size_t sys::arena::used(void) const
+{
+	return used_.load(std::memory_order_relaxed);
+}
+
+std::size_t sys::arena::high_water(void) const
+{
+	return high_water_.load(std::memory_order_relaxed);
+}
+
+std::size_t sys::arena::reserved(void) const
+{
+	return reserved_.load(std::memory_order_relaxed);
+}
+
+void* sys::arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	for (;;)
+	{
+		if (current_ < chunks_.size())
+		{
+			const chunk& c = chunks_[current_];
+			const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(c.data);
+			const std::size_t start =
+				((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+			if (start + bytes <= c.size)
+			{
+				const std::size_t used = used_.load(std::memory_order_relaxed) +
+					start + bytes - offset_;
+				offset_ = start + bytes;
+				used_.store(used, std::memory_order_relaxed);
+				if (used > high_water_.load(std::memory_order_relaxed))
+					high_water_.store(used, std::memory_order_relaxed);
+				return c.data + start;
+			}
+			// retained chunks too small for this request are skipped
+			++current_;
+			offset_ = 0;
+			continue;
+		}
+
+		const std::size_t size = std::max(chunk_size_, bytes + alignment);
+		chunk c = { static_cast<std::byte*>(
+			upstream_->allocate(size, alignof(std::max_align_t))), size };
+		chunks_.push_back(c);
+		reserved_.fetch_add(size, std::memory_order_relaxed);
+		current_ = chunks_.size() - 1;
+		offset_ = 0;
+	}
+}
+
+void sys::arena::do_deallocate(void*, std::size_t, std::size_t)
+{
+}
+
+bool sys::arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+sys::pool_resource::pool_resource(void)
+	: pool_resource(std::pmr::new_delete_resource())
+{
+}
+
+sys::pool_resource::pool_resource(std::pmr::memory_resource* upstream)
+	: upstream_(upstream)
+	, owner_(std::this_thread::get_id())
+	, references_(1)
+	, remote_frees_(0)
+{
+}
+
+sys::pool_resource::~pool_resource(void)
+{
+	for (void* slab : slabs_)
+		upstream_->deallocate(slab, slab_size, alignof(std::max_align_t));
+}
+
+std::size_t sys::pool_resource::allocated(void) const
+{
+	return references_.load(std::memory_order_relaxed) - 1;
+}
+
+std::size_t sys::pool_resource::remote_frees(void) const
+{
+	return remote_frees_.load(std::memory_order_relaxed);
+}
+
+// blocks freed from now on all take the remote path, since a new thread
+// may get the owner's id once it is gone
+void sys::pool_resource::abandon(void)
+{
+	owner_.store(std::thread::id(), std::memory_order_release);
+	release();
+}
+
+void sys::pool_resource::release(void)
+{
+	if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete this;
+}
+
+void sys::pool_resource::refill(std::size_t index)
+{
+	const std::size_t size = 16 << index;
+	std::byte* slab = static_cast<std::byte*>(
+		upstream_->allocate(slab_size, alignof(std::max_align_t)));
+	slabs_.push_back(slab);
+	block* head = classes_[index].free;
+	for (std::size_t offset = slab_size; offset >= size; offset -= size)
+	{
+		block* b = reinterpret_cast<block*>(slab + offset - size);
+		b->next = head;
+		head = b;
+	}
+	classes_[index].free = head;
+}
+
+void* sys::pool_resource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	references_.fetch_add(1, std::memory_order_relaxed);
+	if (bytes > largest || alignment > alignof(std::max_align_t))
+		return upstream_->allocate(bytes, alignment);
+
+	const std::size_t index = class_of(bytes);
+	size_class& sc = classes_[index];
+	if (sc.free == nullptr)
+		sc.free = sc.remote.exchange(nullptr, std::memory_order_acquire);
+	if (sc.free == nullptr)
+		refill(index);
+	block* b = sc.free;
+	sc.free = b->next;
+	return b;
+}
+
+void sys::pool_resource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+{
+	if (bytes > largest || alignment > alignof(std::max_align_t))
+	{
+		upstream_->deallocate(p, bytes, alignment);
+		release();
+		return;
+	}
+
+	size_class& sc = classes_[class_of(bytes)];
+	block* b = static_cast<block*>(p);
+	if (std::this_thread::get_id() == owner_.load(std::memory_order_acquire))
+	{
+		b->next = sc.free;
+		sc.free = b;
+		release();
+		return;
+	}
+
+	// only the owner ever takes the whole list, so pushing is ABA safe
+	block* head = sc.remote.load(std::memory_order_relaxed);
+	do
+		b->next = head;
+	while (!sc.remote.compare_exchange_weak(head, b,
+		std::memory_order_release, std::memory_order_relaxed));
+	remote_frees_.fetch_add(1, std::memory_order_relaxed);
+	release();
+}
+
+bool sys::pool_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+sys::worker_memory::worker_memory(void)
+	: thread_(std::this_thread::get_id())
+	, pool_(new pool_resource())
+{
+	registry& r = workers();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	r.workers.push_back(this);
+}
+
+sys::worker_memory::~worker_memory(void)
+{
+	registry& r = workers();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	r.workers.erase(std::find(r.workers.begin(), r.workers.end(), this));
+	pool_->abandon();
+}
+
+sys::worker_memory& sys::worker_memory::current(void)
+{
+	thread_local worker_memory memory;
+	return memory;
+}
+
+std::vector<sys::worker_memory_stats> sys::worker_memory::statistics(void)
+{
+	std::vector<worker_memory_stats> result;
+	registry& r = workers();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	for (const worker_memory* w : r.workers)
+	{
+		worker_memory_stats stats;
+		stats.thread = w->thread_;
+		stats.arena_used = w->scratch_.used();
+		stats.arena_high_water = w->scratch_.high_water();
+		stats.arena_reserved = w->scratch_.reserved();
+		stats.pool_allocated = w->pool_->allocated();
+		stats.pool_remote_frees = w->pool_->remote_frees();
+		result.push_back(stats);
+	}
+	return result;
+}
+
+sys::arena& sys::worker_memory::scratch(void)
+{
+	return scratch_;
+}
+
+sys::pool_resource& sys::worker_memory::pool(void)
+{
+	return *pool_;
+}
\ No newline at end of file
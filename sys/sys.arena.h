@@ -0,0 +1,126 @@
+#ifndef __SYS_ARENA__
+#define __SYS_ARENA__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+namespace sys
+{
+	// monotonic; deallocate does nothing and reset() hands everything back
+	// at once while keeping the chunks for the next round
+	class arena : public std::pmr::memory_resource, public noncopyable
+	{
+		struct chunk
+		{
+			std::byte* data;
+			std::size_t size;
+		};
+	private:
+		std::pmr::memory_resource* upstream_;
+		std::vector<chunk> chunks_;
+		std::size_t chunk_size_;
+		std::size_t current_;
+		std::size_t offset_;
+		std::atomic<std::size_t> used_;
+		std::atomic<std::size_t> high_water_;
+		std::atomic<std::size_t> reserved_;
+	public:
+		arena(void);
+		arena(std::size_t chunk_size);
+		arena(std::size_t chunk_size, std::pmr::memory_resource* upstream);
+		virtual ~arena(void);
+	public:
+		void reset(void);
+		std::size_t used(void) const;
+		std::size_t high_water(void) const;
+		std::size_t reserved(void) const;
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	};
+
+	// fixed-size blocks in power-of-two classes up to 1 KiB, bigger requests
+	// go upstream; allocate on the owning thread only, but blocks may be
+	// freed from any thread and come back through a lock-free list.
+	// A pool made with new can be abandon()ed by its owner and then lives
+	// on until the last block is freed.
+	class pool_resource : public std::pmr::memory_resource, public noncopyable
+	{
+		struct block
+		{
+			block* next;
+		};
+
+		struct size_class
+		{
+			block* free = nullptr;
+			alignas(64) std::atomic<block*> remote{ nullptr };
+		};
+	public:
+		static const std::size_t classes = 7;
+		static const std::size_t largest = 16 << (classes - 1);
+	private:
+		std::pmr::memory_resource* upstream_;
+		std::atomic<std::thread::id> owner_;
+		size_class classes_[classes];
+		std::vector<void*> slabs_;
+		// one per block out, plus one for the owner until it abandons
+		std::atomic<std::size_t> references_;
+		std::atomic<std::size_t> remote_frees_;
+	public:
+		pool_resource(void);
+		pool_resource(std::pmr::memory_resource* upstream);
+		virtual ~pool_resource(void);
+	public:
+		std::size_t allocated(void) const;
+		std::size_t remote_frees(void) const;
+		void abandon(void);
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	private:
+		void refill(std::size_t index);
+		void release(void);
+	};
+
+	struct worker_memory_stats
+	{
+		std::thread::id thread;
+		std::size_t arena_used = 0;
+		std::size_t arena_high_water = 0;
+		std::size_t arena_reserved = 0;
+		std::size_t pool_allocated = 0;
+		std::size_t pool_remote_frees = 0;
+	};
+
+	// one per thread, made on first use; thread_pool resets the scratch
+	// arena after every task, so anything that must outlive the task or
+	// move to another thread belongs in pool() or the default resource
+	class worker_memory : public noncopyable
+	{
+		std::thread::id thread_;
+		arena scratch_;
+		// abandoned when the thread exits, blocks freed later still work
+		pool_resource* pool_;
+	public:
+		worker_memory(void);
+		virtual ~worker_memory(void);
+	public:
+		static worker_memory& current(void);
+		static std::vector<worker_memory_stats> statistics(void);
+	public:
+		arena& scratch(void);
+		pool_resource& pool(void);
+	};
+}
+
+#endif
+
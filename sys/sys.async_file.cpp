@@ -0,0 +1,810 @@
+#include "sys.config.h"
+#include "sys.async_file.h"
+#include "sys.dir.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(SYS_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+	typedef enum
+	{
+		op_open, op_read, op_write, op_fsync, op_status, op_mkdir, op_nop
+	} operation_t;
+}
+
+struct sys::async_io::operation
+{
+	operation_t kind = op_nop;
+	async_file* file = nullptr;
+	std::string name;
+	int flags = 0;
+	std::uint64_t offset = 0;
+	std::byte* data = nullptr;
+	std::size_t size = 0;
+	int buffer = -1;
+	sys::file_type_t type = sys::type_unknown;
+#if defined(SYS_HAVE_IO_URING)
+	bool queued = false;
+	struct statx stx;
+#endif
+	async_file::completion_type callback;
+};
+
+#if defined(SYS_HAVE_IO_URING)
+struct sys::async_io::ring
+{
+	int fd = -1;
+	void* sq_map = MAP_FAILED;
+	std::size_t sq_map_size = 0;
+	void* cq_map = MAP_FAILED;
+	std::size_t cq_map_size = 0;
+	io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	std::size_t sqes_size = 0;
+	unsigned* sq_head = nullptr;
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned* sq_flags = nullptr;
+	unsigned sq_mask = 0;
+	unsigned sq_entries = 0;
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	io_uring_cqe* cqes = nullptr;
+	unsigned cq_mask = 0;
+	unsigned cq_entries = 0;
+	bool files = false;
+	std::vector<bool> supported;
+
+	~ring(void)
+	{
+		if (sqes != MAP_FAILED)
+			::munmap(sqes, sqes_size);
+		if (cq_map != MAP_FAILED && cq_map != sq_map)
+			::munmap(cq_map, cq_map_size);
+		if (sq_map != MAP_FAILED)
+			::munmap(sq_map, sq_map_size);
+		if (fd != -1)
+			::close(fd);
+	}
+};
+
+namespace
+{
+	int io_uring_setup(unsigned entries, io_uring_params* params)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	int io_uring_enter(int fd, unsigned submit, unsigned complete, unsigned flags)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, complete,
+			flags, nullptr, 0));
+	}
+
+	int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned count)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+	}
+
+	unsigned load(unsigned* p)
+	{
+		return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+	}
+
+	void store(unsigned* p, unsigned value)
+	{
+		std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+	}
+
+	template<class T>
+	T* at(void* map, unsigned offset)
+	{
+		return reinterpret_cast<T*>(static_cast<char*>(map) + offset);
+	}
+}
+#else
+struct sys::async_io::ring
+{
+};
+#endif
+
+sys::async_io::async_io(sys::thread_pool& pool)
+	: async_io(pool, async_io_options())
+{
+}
+
+sys::async_io::async_io(sys::thread_pool& pool, const sys::async_io_options& options)
+	: pool_(pool)
+	, options_(options)
+	, queued_(0)
+	, inflight_(0)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!options_.use_io_uring)
+		return;
+
+	auto r = std::make_unique<ring>();
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	r->fd = io_uring_setup(std::max(1u, options_.sq_depth), &params);
+	// plain read and write arrived together with this feature bit
+	if (r->fd == -1 || (params.features & IORING_FEAT_RW_CUR_POS) == 0)
+		return;
+
+	r->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	r->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single)
+		r->sq_map_size = r->cq_map_size = std::max(r->sq_map_size, r->cq_map_size);
+	r->sq_map = ::mmap(nullptr, r->sq_map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_map == MAP_FAILED)
+		return;
+	r->cq_map = single ? r->sq_map : ::mmap(nullptr, r->cq_map_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+	if (r->cq_map == MAP_FAILED)
+		return;
+	r->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	r->sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, r->sqes_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES));
+	if (r->sqes == MAP_FAILED)
+		return;
+
+	r->sq_head = at<unsigned>(r->sq_map, params.sq_off.head);
+	r->sq_tail = at<unsigned>(r->sq_map, params.sq_off.tail);
+	r->sq_array = at<unsigned>(r->sq_map, params.sq_off.array);
+	r->sq_flags = at<unsigned>(r->sq_map, params.sq_off.flags);
+	r->sq_mask = *at<unsigned>(r->sq_map, params.sq_off.ring_mask);
+	r->sq_entries = params.sq_entries;
+	r->cq_head = at<unsigned>(r->cq_map, params.cq_off.head);
+	r->cq_tail = at<unsigned>(r->cq_map, params.cq_off.tail);
+	r->cqes = at<io_uring_cqe>(r->cq_map, params.cq_off.cqes);
+	r->cq_mask = *at<unsigned>(r->cq_map, params.cq_off.ring_mask);
+	r->cq_entries = params.cq_entries;
+
+	// ops newer than the ring itself are checked one by one and run on
+	// the pool when missing
+	std::vector<char> probe(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+	io_uring_probe* p = reinterpret_cast<io_uring_probe*>(probe.data());
+	r->supported.assign(IORING_OP_LAST, false);
+	if (io_uring_register(r->fd, IORING_REGISTER_PROBE, p, 256) == 0)
+	{
+		for (unsigned i = 0; i < p->ops_len && i < IORING_OP_LAST; ++i)
+			r->supported[i] = (p->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+	}
+
+	// a sparse table, filled as files open
+	if (options_.registered_files != 0)
+	{
+		std::vector<int> fds(options_.registered_files, -1);
+		r->files = io_uring_register(r->fd, IORING_REGISTER_FILES, fds.data(),
+			static_cast<unsigned>(fds.size())) == 0;
+		if (r->files)
+		{
+			for (unsigned i = options_.registered_files; i > 0; --i)
+				free_files_.push_back(static_cast<int>(i - 1));
+		}
+	}
+
+	ring_ = std::move(r);
+	if (!pool_.attach(this))
+	{
+		ring_.reset();
+		free_files_.clear();
+	}
+#endif
+}
+
+// everything started must have completed by now
+sys::async_io::~async_io(void)
+{
+	if (ring_)
+		pool_.detach(this);
+}
+
+bool sys::async_io::uring(void) const
+{
+	return ring_ != nullptr;
+}
+
+sys::thread_pool& sys::async_io::pool(void) const
+{
+	return pool_;
+}
+
+bool sys::async_io::register_buffers(const std::vector<std::span<std::byte>>& buffers)
+{
+	unregister_buffers();
+#if defined(SYS_HAVE_IO_URING)
+	if (ring_)
+	{
+		std::vector<struct iovec> iov(buffers.size());
+		for (std::size_t i = 0; i < buffers.size(); ++i)
+		{
+			iov[i].iov_base = buffers[i].data();
+			iov[i].iov_len = buffers[i].size();
+		}
+		if (io_uring_register(ring_->fd, IORING_REGISTER_BUFFERS, iov.data(),
+				static_cast<unsigned>(iov.size())) != 0)
+			return false;
+	}
+#endif
+	buffers_ = buffers;
+	return true;
+}
+
+void sys::async_io::unregister_buffers(void)
+{
+	if (buffers_.empty())
+		return;
+#if defined(SYS_HAVE_IO_URING)
+	if (ring_)
+		io_uring_register(ring_->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+#endif
+	buffers_.clear();
+}
+
+void sys::async_io::submit(void)
+{
+	if (queued_.load(std::memory_order_relaxed) != 0)
+		flush();
+}
+
+// takes every completion that is ready; the callbacks run as tasks so
+// a worker that polls between tasks does not run foreign code inline
+bool sys::async_io::poll(void)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!ring_)
+		return false;
+	if (queued_.load(std::memory_order_relaxed) != 0)
+		flush();
+	ring& r = *ring_;
+	if (std::atomic_ref<unsigned>(*r.cq_head).load(std::memory_order_relaxed) ==
+			load(r.cq_tail))
+	{
+		// completions that did not fit are held back until asked for
+		if ((load(r.sq_flags) & IORING_SQ_CQ_OVERFLOW) == 0)
+			return false;
+		io_uring_enter(r.fd, 0, 0, IORING_ENTER_GETEVENTS);
+	}
+
+	std::vector<std::pair<operation*, long>> done;
+	{
+		std::unique_lock<std::mutex> lock(complete_mutex_, std::try_to_lock);
+		if (!lock.owns_lock())
+			return false;
+		unsigned head = *r.cq_head;
+		const unsigned tail = load(r.cq_tail);
+		for (; head != tail; ++head)
+		{
+			const io_uring_cqe& cqe = r.cqes[head & r.cq_mask];
+			if (cqe.user_data != 0)
+				done.emplace_back(reinterpret_cast<operation*>(cqe.user_data), cqe.res);
+		}
+		store(r.cq_head, head);
+	}
+	inflight_.fetch_sub(done.size(), std::memory_order_acq_rel);
+	for (auto& d : done)
+		pool_.post([this, d]() { complete(d.first, d.second); });
+	return !done.empty();
+#else
+	return false;
+#endif
+}
+
+bool sys::async_io::pending(void) const
+{
+	return ring_ != nullptr && inflight_.load(std::memory_order_acquire) != 0;
+}
+
+void sys::async_io::wait(void)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!ring_)
+		return;
+	flush();
+	io_uring_enter(ring_->fd, 0, 1, IORING_ENTER_GETEVENTS);
+#endif
+}
+
+// a no-op completes at once and ends the wait
+void sys::async_io::interrupt(void)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!ring_)
+		return;
+	ring& r = *ring_;
+	std::lock_guard<std::mutex> lock(submit_mutex_);
+	const unsigned tail = *r.sq_tail;
+	if (tail - load(r.sq_head) < r.sq_entries)
+	{
+		const unsigned index = tail & r.sq_mask;
+		std::memset(&r.sqes[index], 0, sizeof(io_uring_sqe));
+		r.sqes[index].opcode = IORING_OP_NOP;
+		r.sq_array[index] = index;
+		store(r.sq_tail, tail + 1);
+		queued_.fetch_add(1, std::memory_order_relaxed);
+	}
+	const int submitted = io_uring_enter(r.fd,
+		static_cast<unsigned>(queued_.load(std::memory_order_relaxed)), 0, 0);
+	if (submitted > 0)
+		queued_.fetch_sub(static_cast<std::size_t>(submitted), std::memory_order_relaxed);
+#endif
+}
+
+// inside a worker operations wait for the task to return, or for a full
+// batch, and go to the kernel together; from other threads at once
+void sys::async_io::queue(operation* op)
+{
+#if defined(SYS_HAVE_IO_URING)
+	unsigned opcode = IORING_OP_NOP;
+	switch (op->kind)
+	{
+	case op_open:
+		opcode = IORING_OP_OPENAT;
+		break;
+	case op_read:
+		opcode = op->buffer != -1 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		break;
+	case op_write:
+		opcode = op->buffer != -1 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		break;
+	case op_fsync:
+		opcode = IORING_OP_FSYNC;
+		break;
+	case op_status:
+		opcode = IORING_OP_STATX;
+		break;
+	case op_mkdir:
+		opcode = IORING_OP_MKDIRAT;
+		break;
+	case op_nop:
+		break;
+	}
+
+	if (ring_ && ring_->supported[opcode])
+	{
+		ring& r = *ring_;
+		while (inflight_.load(std::memory_order_acquire) >= r.cq_entries)
+		{
+			if (!poll())
+				std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(submit_mutex_);
+		while (*r.sq_tail - load(r.sq_head) == r.sq_entries)
+		{
+			lock.unlock();
+			if (flush() == 0 && !poll())
+				std::this_thread::yield();
+			lock.lock();
+		}
+
+		const unsigned tail = *r.sq_tail;
+		const unsigned index = tail & r.sq_mask;
+		io_uring_sqe& sqe = r.sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = static_cast<std::uint8_t>(opcode);
+		sqe.user_data = reinterpret_cast<std::uint64_t>(op);
+		if (op->file != nullptr)
+		{
+			if (op->file->slot_ != -1)
+			{
+				sqe.fd = op->file->slot_;
+				sqe.flags = IOSQE_FIXED_FILE;
+			}
+			else
+				sqe.fd = op->file->fd_;
+		}
+		switch (op->kind)
+		{
+		case op_open:
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(op->name.c_str());
+			sqe.len = 0666;
+			sqe.open_flags = static_cast<std::uint32_t>(op->flags);
+			break;
+		case op_read:
+		case op_write:
+			sqe.off = op->offset;
+			sqe.addr = reinterpret_cast<std::uint64_t>(op->data);
+			sqe.len = static_cast<std::uint32_t>(op->size);
+			if (op->buffer != -1)
+				sqe.buf_index = static_cast<std::uint16_t>(op->buffer);
+			break;
+		case op_status:
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(op->name.c_str());
+			sqe.len = STATX_TYPE;
+			sqe.off = reinterpret_cast<std::uint64_t>(&op->stx);
+			sqe.statx_flags = AT_SYMLINK_NOFOLLOW;
+			break;
+		case op_mkdir:
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(op->name.c_str());
+			sqe.len = S_IRWXU | S_IRWXG | S_IRWXO;
+			break;
+		case op_fsync:
+		case op_nop:
+			break;
+		}
+		op->queued = true;
+		r.sq_array[index] = index;
+		inflight_.fetch_add(1, std::memory_order_acq_rel);
+		store(r.sq_tail, tail + 1);
+		const std::size_t queued = queued_.fetch_add(1, std::memory_order_relaxed) + 1;
+		lock.unlock();
+
+		if (!pool_.in_worker())
+		{
+			flush();
+			pool_.notify();
+		}
+		else if (queued >= options_.batch)
+			flush();
+		return;
+	}
+#endif
+	pool_.post([this, op]() { complete(op, perform(*op)); });
+}
+
+void sys::async_io::fail(operation* op, int error)
+{
+	pool_.post([this, op, error]() { complete(op, -error); });
+}
+
+void sys::async_io::complete(operation* op, long result)
+{
+	int error = result < 0 ? static_cast<int>(-result) : 0;
+	if (op->kind == op_open && error == 0)
+	{
+#if !defined(SYS_WIN32)
+		op->file->fd_ = static_cast<int>(result);
+		op->file->slot_ = register_file(op->file->fd_);
+#endif
+	}
+	else if (op->kind == op_status)
+	{
+#if defined(SYS_HAVE_IO_URING)
+		if (error == 0 && op->queued)
+			op->type = dir::file_type(op->stx.stx_mode);
+#endif
+#if defined(SYS_WIN32)
+		const bool missing = error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+#else
+		const bool missing = error == ENOENT || error == ENOTDIR;
+#endif
+		if (missing)
+		{
+			op->type = file_not_found;
+			error = 0;
+		}
+		else if (error != 0)
+			op->type = status_error;
+		result = static_cast<long>(op->type);
+	}
+	async_file::completion_type callback = std::move(op->callback);
+	delete op;
+	if (callback)
+		callback(error == 0 ? static_cast<std::size_t>(result) : 0, error);
+}
+
+// the blocking version, for when there is no ring
+long sys::async_io::perform(operation& op)
+{
+#if defined(SYS_WIN32)
+	HANDLE handle = op.file->handle_;
+	DWORD count = 0;
+	OVERLAPPED overlapped;
+	std::memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = static_cast<DWORD>(op.offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(op.offset >> 32);
+	switch (op.kind)
+	{
+	case op_open:
+		handle = ::CreateFileA(op.name.c_str(),
+			((op.flags & async_file::open_read) ? GENERIC_READ : 0) |
+			((op.flags & async_file::open_write) ? GENERIC_WRITE : 0),
+			FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+			(op.flags & async_file::open_create) ?
+				((op.flags & async_file::open_truncate) ? CREATE_ALWAYS : OPEN_ALWAYS) :
+				((op.flags & async_file::open_truncate) ? TRUNCATE_EXISTING : OPEN_EXISTING),
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+			return -static_cast<long>(::GetLastError());
+		op.file->handle_ = handle;
+		return 0;
+	case op_read:
+		if (!::ReadFile(handle, op.data, static_cast<DWORD>(op.size), &count, &overlapped) &&
+				::GetLastError() != ERROR_HANDLE_EOF)
+			return -static_cast<long>(::GetLastError());
+		return static_cast<long>(count);
+	case op_write:
+		if (!::WriteFile(handle, op.data, static_cast<DWORD>(op.size), &count, &overlapped))
+			return -static_cast<long>(::GetLastError());
+		return static_cast<long>(count);
+	case op_fsync:
+		if (!::FlushFileBuffers(handle))
+			return -static_cast<long>(::GetLastError());
+		return 0;
+	case op_status:
+		op.type = path(op.name).status();
+		return op.type == status_error ? -static_cast<long>(::GetLastError()) : 0;
+	case op_mkdir:
+		if (!::CreateDirectoryA(op.name.c_str(), nullptr))
+			return -static_cast<long>(::GetLastError());
+		return 0;
+	case op_nop:
+		break;
+	}
+	return 0;
+#else
+	long result = 0;
+	switch (op.kind)
+	{
+	case op_open:
+		result = ::open(op.name.c_str(), op.flags, 0666);
+		break;
+	case op_read:
+		result = static_cast<long>(::pread(op.file->fd_, op.data, op.size,
+			static_cast<off_t>(op.offset)));
+		break;
+	case op_write:
+		result = static_cast<long>(::pwrite(op.file->fd_, op.data, op.size,
+			static_cast<off_t>(op.offset)));
+		break;
+	case op_fsync:
+		result = ::fsync(op.file->fd_);
+		break;
+	case op_status:
+	{
+		struct stat st;
+		result = ::lstat(op.name.c_str(), &st);
+		if (result == 0)
+			op.type = dir::file_type(st.st_mode);
+		break;
+	}
+	case op_mkdir:
+		result = ::mkdir(op.name.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+		break;
+	case op_nop:
+		break;
+	}
+	return result < 0 ? -errno : result;
+#endif
+}
+
+std::size_t sys::async_io::flush(void)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!ring_)
+		return 0;
+	std::lock_guard<std::mutex> lock(submit_mutex_);
+	const std::size_t queued = queued_.load(std::memory_order_relaxed);
+	if (queued == 0)
+		return 0;
+	const int submitted = io_uring_enter(ring_->fd, static_cast<unsigned>(queued), 0, 0);
+	if (submitted <= 0)
+		return 0;
+	queued_.fetch_sub(static_cast<std::size_t>(submitted), std::memory_order_relaxed);
+	return static_cast<std::size_t>(submitted);
+#else
+	return 0;
+#endif
+}
+
+void sys::async_io::status(const sys::path& name, std::function<void(std::size_t, int)> f)
+{
+	auto op = new operation;
+	op->kind = op_status;
+	op->name = name.c_str();
+	op->callback = std::move(f);
+	queue(op);
+}
+
+void sys::async_io::create_directory(const sys::path& name,
+	std::function<void(std::size_t, int)> f)
+{
+	auto op = new operation;
+	op->kind = op_mkdir;
+	op->name = name.c_str();
+	op->callback = std::move(f);
+	queue(op);
+}
+
+int sys::async_io::register_file(int fd)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (!ring_ || !ring_->files)
+		return -1;
+	std::lock_guard<std::mutex> lock(files_mutex_);
+	if (free_files_.empty())
+		return -1;
+	const int slot = free_files_.back();
+	io_uring_files_update update;
+	std::memset(&update, 0, sizeof(update));
+	update.offset = static_cast<unsigned>(slot);
+	update.fds = reinterpret_cast<std::uint64_t>(&fd);
+	if (io_uring_register(ring_->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+		return -1;
+	free_files_.pop_back();
+	return slot;
+#else
+	(void)fd;
+	return -1;
+#endif
+}
+
+void sys::async_io::unregister_file(int slot)
+{
+#if defined(SYS_HAVE_IO_URING)
+	if (slot == -1)
+		return;
+	const int fd = -1;
+	io_uring_files_update update;
+	std::memset(&update, 0, sizeof(update));
+	update.offset = static_cast<unsigned>(slot);
+	update.fds = reinterpret_cast<std::uint64_t>(&fd);
+	std::lock_guard<std::mutex> lock(files_mutex_);
+	io_uring_register(ring_->fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+	free_files_.push_back(slot);
+#else
+	(void)slot;
+#endif
+}
+
+sys::async_file::async_file(sys::async_io& io)
+	: io_(io)
+#if defined(SYS_WIN32)
+	, handle_(INVALID_HANDLE_VALUE)
+#else
+	, fd_(-1)
+	, slot_(-1)
+#endif
+{
+}
+
+sys::async_file::~async_file(void)
+{
+	close();
+}
+
+void sys::async_file::open(const sys::path& name, unsigned mode, completion_type f)
+{
+	close();
+	auto op = new async_io::operation;
+	op->kind = op_open;
+	op->file = this;
+	op->name = name.c_str();
+#if defined(SYS_WIN32)
+	op->flags = static_cast<int>(mode);
+#else
+	if ((mode & open_read) && (mode & open_write))
+		op->flags = O_RDWR;
+	else if (mode & open_write)
+		op->flags = O_WRONLY;
+	else
+		op->flags = O_RDONLY;
+	if (mode & open_create)
+		op->flags |= O_CREAT;
+	if (mode & open_truncate)
+		op->flags |= O_TRUNC;
+	if (mode & open_append)
+		op->flags |= O_APPEND;
+	op->flags |= O_CLOEXEC;
+#endif
+	op->callback = std::move(f);
+	io_.queue(op);
+}
+
+void sys::async_file::read(std::uint64_t offset, std::span<std::byte> data,
+	completion_type f)
+{
+	auto op = new async_io::operation;
+	op->kind = op_read;
+	op->file = this;
+	op->offset = offset;
+	op->data = data.data();
+	op->size = data.size();
+	op->callback = std::move(f);
+	io_.queue(op);
+}
+
+void sys::async_file::write(std::uint64_t offset, std::span<const std::byte> data,
+	completion_type f)
+{
+	auto op = new async_io::operation;
+	op->kind = op_write;
+	op->file = this;
+	op->offset = offset;
+	op->data = const_cast<std::byte*>(data.data());
+	op->size = data.size();
+	op->callback = std::move(f);
+	io_.queue(op);
+}
+
+void sys::async_file::read_fixed(std::uint64_t offset, std::size_t buffer,
+	std::span<std::byte> data, completion_type f)
+{
+	auto op = new async_io::operation;
+	op->kind = op_read;
+	op->file = this;
+	op->offset = offset;
+	op->data = data.data();
+	op->size = data.size();
+	op->buffer = static_cast<int>(buffer);
+	op->callback = std::move(f);
+	if (buffer >= io_.buffers_.size() || data.data() < io_.buffers_[buffer].data() ||
+			data.data() + data.size() > io_.buffers_[buffer].data() + io_.buffers_[buffer].size())
+		io_.fail(op, EINVAL);
+	else
+		io_.queue(op);
+}
+
+void sys::async_file::write_fixed(std::uint64_t offset, std::size_t buffer,
+	std::span<const std::byte> data, completion_type f)
+{
+	auto op = new async_io::operation;
+	op->kind = op_write;
+	op->file = this;
+	op->offset = offset;
+	op->data = const_cast<std::byte*>(data.data());
+	op->size = data.size();
+	op->buffer = static_cast<int>(buffer);
+	op->callback = std::move(f);
+	if (buffer >= io_.buffers_.size() || op->data < io_.buffers_[buffer].data() ||
+			op->data + op->size > io_.buffers_[buffer].data() + io_.buffers_[buffer].size())
+		io_.fail(op, EINVAL);
+	else
+		io_.queue(op);
+}
+
+void sys::async_file::fsync(completion_type f)
+{
+	auto op = new async_io::operation;
+	op->kind = op_fsync;
+	op->file = this;
+	op->callback = std::move(f);
+	io_.queue(op);
+}
+
+void sys::async_file::close(void)
+{
+#if defined(SYS_WIN32)
+	if (handle_ != INVALID_HANDLE_VALUE)
+		::CloseHandle(handle_);
+	handle_ = INVALID_HANDLE_VALUE;
+#else
+	io_.unregister_file(slot_);
+	if (fd_ != -1)
+		::close(fd_);
+	fd_ = -1;
+	slot_ = -1;
+#endif
+}
+
+bool sys::async_file::is_open(void) const
+{
+#if defined(SYS_WIN32)
+	return handle_ != INVALID_HANDLE_VALUE;
+#else
+	return fd_ != -1;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef __SYS_ASYNC_FILE__
+#define __SYS_ASYNC_FILE__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+#include "sys.thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace sys
+{
+	struct async_io_options
+	{
+		// submission queue entries, rounded up to a power of two
+		unsigned sq_depth = 256;
+		// queued operations that force a submit from inside a worker;
+		// otherwise they go in one call when the task returns
+		unsigned batch = 32;
+		// size of the registered file table, 0 to not register files
+		unsigned registered_files = 64;
+		bool use_io_uring = true;
+	};
+
+	// drives io_uring for the files that use it; completions are reaped
+	// by the pool's own workers, which run the callbacks as tasks. Without
+	// io_uring every operation is a blocking call on a pool task.
+	class async_io : public thread_pool::event_source, public noncopyable
+	{
+		struct operation;
+		struct ring;
+	private:
+		thread_pool& pool_;
+		async_io_options options_;
+		std::unique_ptr<ring> ring_;
+		std::mutex submit_mutex_;
+		std::mutex complete_mutex_;
+		std::atomic<std::size_t> queued_;
+		std::atomic<std::size_t> inflight_;
+		std::mutex files_mutex_;
+		std::vector<int> free_files_;
+		std::vector<std::span<std::byte>> buffers_;
+	public:
+		async_io(thread_pool& pool);
+		async_io(thread_pool& pool, const async_io_options& options);
+		virtual ~async_io(void);
+	public:
+		bool uring(void) const;
+		thread_pool& pool(void) const;
+		// the buffers stay registered until unregister_buffers(); fixed
+		// reads and writes name one by index and must stay inside it
+		bool register_buffers(const std::vector<std::span<std::byte>>& buffers);
+		void unregister_buffers(void);
+		// hands queued operations to the kernel now
+		void submit(void);
+	public:
+		// completes with the file_type_t of name itself, not following a
+		// final symlink; a missing file is file_not_found and no error
+		void status(const path& name, std::function<void(std::size_t, int)> f);
+		void create_directory(const path& name, std::function<void(std::size_t, int)> f);
+	public:
+		bool poll(void) override;
+		bool pending(void) const override;
+		void wait(void) override;
+		void interrupt(void) override;
+	private:
+		void queue(operation* op);
+		void fail(operation* op, int error);
+		void complete(operation* op, long result);
+		long perform(operation& op);
+		std::size_t flush(void);
+		int register_file(int fd);
+		void unregister_file(int slot);
+	friend class async_file;
+	};
+
+	// operations complete with the byte count, or the descriptor for open,
+	// and an errno value; the file must outlive everything it started
+	class async_file : public noncopyable
+	{
+	public:
+		typedef enum
+		{
+			open_read = 1, open_write = 2, open_create = 4,
+			open_truncate = 8, open_append = 16
+		} open_mode_t;
+
+		typedef std::function<void(std::size_t result, int error)> completion_type;
+	private:
+		async_io& io_;
+#if defined(SYS_WIN32)
+		HANDLE handle_;
+#else
+		int fd_;
+		int slot_;
+#endif
+	public:
+		async_file(async_io& io);
+		virtual ~async_file(void);
+	public:
+		void open(const path& name, unsigned mode, completion_type f);
+		void read(std::uint64_t offset, std::span<std::byte> data, completion_type f);
+		void write(std::uint64_t offset, std::span<const std::byte> data, completion_type f);
+		void read_fixed(std::uint64_t offset, std::size_t buffer,
+			std::span<std::byte> data, completion_type f);
+		void write_fixed(std::uint64_t offset, std::size_t buffer,
+			std::span<const std::byte> data, completion_type f);
+		void fsync(completion_type f);
+		// blocking, and only once nothing is in flight
+		void close(void);
+		bool is_open(void) const;
+	friend class async_io;
+	};
+}
+
+#endif
+
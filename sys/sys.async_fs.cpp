@@ -0,0 +1,189 @@
+#include "sys.config.h"
+#include "sys.async_fs.h"
+
+#include <cerrno>
+
+#if defined(SYS_WIN32)
+static const int exists_error = ERROR_ALREADY_EXISTS;
+static const int missing_error = ERROR_PATH_NOT_FOUND;
+#else
+static const int exists_error = EEXIST;
+static const int missing_error = ENOENT;
+#endif
+
+sys::status_awaiter::status_awaiter(const sys::path& name)
+	: name_(name)
+	, type_(type_unknown)
+{
+}
+
+bool sys::status_awaiter::await_ready(void) const noexcept
+{
+	return false;
+}
+
+sys::file_type_t sys::status_awaiter::await_resume(void) const
+{
+	return type_;
+}
+
+void sys::status_awaiter::start(sys::executor& exec, std::coroutine_handle<> h)
+{
+	exec.io().status(name_, [this, h](std::size_t type, int) {
+		type_ = static_cast<file_type_t>(type);
+		h.resume();
+	});
+}
+
+sys::status_batch_awaiter::status_batch_awaiter(std::vector<sys::path> names)
+	: names_(std::move(names))
+	, types_(names_.size(), type_unknown)
+	, remaining_(names_.size())
+{
+}
+
+bool sys::status_batch_awaiter::await_ready(void) const noexcept
+{
+	return names_.empty();
+}
+
+std::vector<sys::file_type_t> sys::status_batch_awaiter::await_resume(void)
+{
+	return std::move(types_);
+}
+
+// the awaiter may be gone as soon as the last request is out
+void sys::status_batch_awaiter::start(sys::executor& exec, std::coroutine_handle<> h)
+{
+	const std::size_t count = names_.size();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		exec.io().status(names_[i], [this, h, i](std::size_t type, int) {
+			types_[i] = static_cast<file_type_t>(type);
+			if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				h.resume();
+		});
+	}
+}
+
+sys::create_awaiter::create_awaiter(const sys::path& name)
+	: name_(name)
+	, error_(0)
+{
+}
+
+bool sys::create_awaiter::await_ready(void) const noexcept
+{
+	return false;
+}
+
+int sys::create_awaiter::await_resume(void) const
+{
+	return error_;
+}
+
+void sys::create_awaiter::start(sys::executor& exec, std::coroutine_handle<> h)
+{
+	exec.io().create_directory(name_, [this, h](std::size_t, int error) {
+		error_ = error;
+		h.resume();
+	});
+}
+
+sys::status_awaiter sys::async_status(const sys::path& name)
+{
+	return status_awaiter(name);
+}
+
+sys::status_batch_awaiter sys::async_status(std::vector<sys::path> names)
+{
+	return status_batch_awaiter(std::move(names));
+}
+
+sys::create_awaiter sys::async_create(const sys::path& name)
+{
+	return create_awaiter(name);
+}
+
+sys::task<sys::path> sys::async_canonical(sys::path name)
+{
+	co_return co_await async_canonical(std::move(name), path::current_path());
+}
+
+// until a symlink turns up every prefix is known in advance, so they are
+// all looked at in one batch; a symlink hands over to path::canonical()
+sys::task<sys::path> sys::async_canonical(sys::path name, sys::path base)
+{
+	path source(name.is_absolute() ? name : name.absolute(base));
+	path root(source.root_path());
+	path result;
+
+	std::vector<path> prefixes;
+	for (path::iterator itr = source.begin(); itr != source.end(); ++itr)
+	{
+		if (*itr == ".")
+			continue;
+		if (*itr == "..")
+		{
+			if (result != root)
+				result.remove_filename();
+			continue;
+		}
+		result.append(*itr);
+		prefixes.push_back(result);
+	}
+	prefixes.push_back(source);
+
+	std::vector<file_type_t> types = co_await async_status(std::move(prefixes));
+	if (types.back() == status_error || types.back() == file_not_found)
+		co_return path();
+	for (std::size_t i = 0; i + 1 < types.size(); ++i)
+	{
+		if (types[i] == status_error)
+			co_return path();
+		if (types[i] == symlink_file)
+		{
+			auto resolve = [source]() { return source.canonical(); };
+			co_return co_await async_call(resolve);
+		}
+	}
+	co_return result;
+}
+
+sys::task<std::vector<sys::list_entry>> sys::async_read_dir(sys::path name)
+{
+	co_return co_await async_read_dir(std::move(name), list_options());
+}
+
+sys::task<std::vector<sys::list_entry>> sys::async_read_dir(sys::path name,
+	sys::list_options options)
+{
+	auto list = [&name, &options]() {
+		dir d(name.c_str());
+		if (!d.is_open())
+			return std::vector<list_entry>();
+		return d.list(options);
+	};
+	co_return co_await async_call(list);
+}
+
+// tries the directory first and only walks up when the parent is
+// missing, so a directory whose parent exists costs a single call
+sys::task<bool> sys::async_create_all(sys::path name)
+{
+	path filename(name.filename());
+	if (filename == "." || filename == "..")
+		co_return co_await async_create_all(name.parent_path());
+
+	int error = co_await async_create(name);
+	if (error == missing_error)
+	{
+		path parent(name.parent_path());
+		if (parent.empty() || !co_await async_create_all(parent))
+			co_return false;
+		error = co_await async_create(name);
+	}
+	if (error == exists_error)
+		co_return co_await async_status(name) == directory_file;
+	co_return error == 0;
+}
\ No newline at end of file
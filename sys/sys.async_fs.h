@@ -0,0 +1,151 @@
+#ifndef __SYS_ASYNC_FS__
+#define __SYS_ASYNC_FS__
+
+#include "sys.config.h"
+#include "sys.dir.h"
+#include "sys.path.h"
+#include "sys.task.h"
+
+#include <atomic>
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sys
+{
+	// these are awaited from inside a sys::task, whose executor supplies
+	// the ring and the pool; each wait costs a coroutine frame, not a thread
+
+	class status_awaiter
+	{
+		path name_;
+		file_type_t type_;
+	public:
+		status_awaiter(const path& name);
+	public:
+		bool await_ready(void) const noexcept;
+		template<class Promise>
+		void await_suspend(std::coroutine_handle<Promise> h);
+		file_type_t await_resume(void) const;
+	private:
+		void start(executor& exec, std::coroutine_handle<> h);
+	};
+
+	// every status is requested at once and the kernel works through
+	// them together; resumes when the last one is in
+	class status_batch_awaiter
+	{
+		std::vector<path> names_;
+		std::vector<file_type_t> types_;
+		std::atomic<std::size_t> remaining_;
+	public:
+		status_batch_awaiter(std::vector<path> names);
+	public:
+		bool await_ready(void) const noexcept;
+		template<class Promise>
+		void await_suspend(std::coroutine_handle<Promise> h);
+		std::vector<file_type_t> await_resume(void);
+	private:
+		void start(executor& exec, std::coroutine_handle<> h);
+	};
+
+	class create_awaiter
+	{
+		path name_;
+		int error_;
+	public:
+		create_awaiter(const path& name);
+	public:
+		bool await_ready(void) const noexcept;
+		template<class Promise>
+		void await_suspend(std::coroutine_handle<Promise> h);
+		int await_resume(void) const;
+	private:
+		void start(executor& exec, std::coroutine_handle<> h);
+	};
+
+	// runs f on a pool task, for calls that only come in a blocking form
+	template<class Function>
+	class call_awaiter
+	{
+		typedef std::invoke_result_t<Function> result_type;
+		typedef std::conditional_t<std::is_void_v<result_type>, bool, result_type> stored_type;
+
+		Function f_;
+		std::optional<stored_type> result_;
+	public:
+		call_awaiter(Function f)
+			: f_(std::move(f))
+		{
+		}
+	public:
+		bool await_ready(void) const noexcept
+		{
+			return false;
+		}
+
+		template<class Promise>
+		void await_suspend(std::coroutine_handle<Promise> h)
+		{
+			h.promise().exec->pool().post([this, h]() {
+				if constexpr (std::is_void_v<result_type>)
+				{
+					f_();
+					result_.emplace(true);
+				}
+				else
+					result_.emplace(f_());
+				h.resume();
+			});
+		}
+
+		result_type await_resume(void)
+		{
+			if constexpr (!std::is_void_v<result_type>)
+				return std::move(*result_);
+		}
+	};
+
+	template<class Promise>
+	void status_awaiter::await_suspend(std::coroutine_handle<Promise> h)
+	{
+		start(*h.promise().exec, h);
+	}
+
+	template<class Promise>
+	void status_batch_awaiter::await_suspend(std::coroutine_handle<Promise> h)
+	{
+		start(*h.promise().exec, h);
+	}
+
+	template<class Promise>
+	void create_awaiter::await_suspend(std::coroutine_handle<Promise> h)
+	{
+		start(*h.promise().exec, h);
+	}
+
+	// like path::status(), a final symlink is not followed
+	status_awaiter async_status(const path& name);
+	status_batch_awaiter async_status(std::vector<path> names);
+	// one directory; 0 or the errno value
+	create_awaiter async_create(const path& name);
+
+	template<class Function>
+	call_awaiter<std::decay_t<Function>> async_call(Function&& f)
+	{
+		return call_awaiter<std::decay_t<Function>>(std::forward<Function>(f));
+	}
+
+	// same results as path::canonical() and path::create_all(); dir
+	// listings are read in large getdents batches on a pool task
+	task<path> async_canonical(path name);
+	task<path> async_canonical(path name, path base);
+	task<std::vector<list_entry>> async_read_dir(path name);
+	task<std::vector<list_entry>> async_read_dir(path name, list_options options);
+	task<bool> async_create_all(path name);
+}
+
+#endif
+
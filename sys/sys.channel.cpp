@@ -0,0 +1,76 @@
+#include "sys.config.h"
+#include "sys.channel.h"
+#include "sys.futex.h"
+
+sys::channel_base::channel_base(void)
+	: readable_(0)
+	, readers_(0)
+	, writable_(0)
+	, writers_(0)
+	, closed_(false)
+{
+}
+
+sys::channel_base::~channel_base(void)
+{
+}
+
+void sys::channel_base::close(void)
+{
+	closed_.store(true, std::memory_order_seq_cst);
+	readable_.fetch_add(1, std::memory_order_release);
+	writable_.fetch_add(1, std::memory_order_release);
+	futex_wake(readable_, UINT32_MAX);
+	futex_wake(writable_, UINT32_MAX);
+}
+
+bool sys::channel_base::closed(void) const
+{
+	return closed_.load(std::memory_order_acquire);
+}
+
+void sys::channel_base::notify_readers(std::uint32_t count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (readers_.load(std::memory_order_relaxed) != 0)
+	{
+		readable_.fetch_add(1, std::memory_order_release);
+		futex_wake(readable_, count);
+	}
+}
+
+void sys::channel_base::notify_writers(std::uint32_t count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (writers_.load(std::memory_order_relaxed) != 0)
+	{
+		writable_.fetch_add(1, std::memory_order_release);
+		futex_wake(writable_, count);
+	}
+}
+
+// the caller tries once more after this and only then waits, so a wakeup
+// sent in between is not lost
+std::uint32_t sys::channel_base::begin_wait(std::atomic<std::uint32_t>& epoch,
+	std::atomic<std::uint32_t>& waiters)
+{
+	const std::uint32_t expected = epoch.load(std::memory_order_acquire);
+	waiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return expected;
+}
+
+void sys::channel_base::wait(std::atomic<std::uint32_t>& epoch, std::uint32_t expected)
+{
+	futex_wait(epoch, expected);
+}
+
+void sys::channel_base::end_wait(std::atomic<std::uint32_t>& waiters)
+{
+	waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void sys::channel_base::relax(void)
+{
+	cpu_relax();
+}
\ No newline at end of file
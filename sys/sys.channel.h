@@ -0,0 +1,261 @@
+#ifndef __SYS_CHANNEL__
+#define __SYS_CHANNEL__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+namespace sys
+{
+	// close() belongs to the producing side once it is done; pushes that
+	// race with it may fail, and readers drain what is left before popping
+	// returns false
+	class channel_base : public noncopyable
+	{
+	protected:
+		alignas(64) std::atomic<std::uint32_t> readable_;
+		std::atomic<std::uint32_t> readers_;
+		alignas(64) std::atomic<std::uint32_t> writable_;
+		std::atomic<std::uint32_t> writers_;
+		alignas(64) std::atomic<bool> closed_;
+	public:
+		channel_base(void);
+		virtual ~channel_base(void);
+	public:
+		void close(void);
+		bool closed(void) const;
+	protected:
+		void notify_readers(std::uint32_t count);
+		void notify_writers(std::uint32_t count);
+		std::uint32_t begin_wait(std::atomic<std::uint32_t>& epoch,
+			std::atomic<std::uint32_t>& waiters);
+		void wait(std::atomic<std::uint32_t>& epoch, std::uint32_t expected);
+		void end_wait(std::atomic<std::uint32_t>& waiters);
+		void relax(void);
+	protected:
+		static const unsigned spin_count = 64;
+	};
+
+	// bounded multi-producer multi-consumer ring (Vyukov); every cell
+	// carries a sequence number telling whose turn it is
+	template<class T>
+	class channel : public channel_base
+	{
+		struct cell
+		{
+			std::atomic<std::size_t> sequence;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+	private:
+		std::unique_ptr<cell[]> cells_;
+		std::size_t mask_;
+		alignas(64) std::atomic<std::size_t> tail_;
+		alignas(64) std::atomic<std::size_t> head_;
+	public:
+		channel(std::size_t capacity);
+		virtual ~channel(void);
+	public:
+		std::size_t capacity(void) const;
+		bool empty(void) const;
+	public:
+		bool try_push(T& value);
+		bool try_pop(T& value);
+	public:
+		// block while full or empty; false once closed (and drained)
+		bool push(T value);
+		std::size_t push(std::span<T> values);
+		bool pop(T& value);
+		std::size_t pop(std::span<T> values);
+	private:
+		bool drained(void) const;
+	};
+
+	template<class T>
+	channel<T>::channel(std::size_t capacity)
+		: mask_(0)
+		, tail_(0)
+		, head_(0)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		cells_.reset(new cell[size]);
+		mask_ = size - 1;
+		for (std::size_t i = 0; i < size; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	template<class T>
+	channel<T>::~channel(void)
+	{
+		const std::size_t tail = tail_.load(std::memory_order_acquire);
+		for (std::size_t pos = head_.load(std::memory_order_acquire); pos != tail; ++pos)
+			std::launder(reinterpret_cast<T*>(cells_[pos & mask_].storage))->~T();
+	}
+
+	template<class T>
+	std::size_t channel<T>::capacity(void) const
+	{
+		return mask_ + 1;
+	}
+
+	template<class T>
+	bool channel<T>::empty(void) const
+	{
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+
+	template<class T>
+	bool channel<T>::drained(void) const
+	{
+		return closed_.load(std::memory_order_acquire) && empty();
+	}
+
+	template<class T>
+	bool channel<T>::try_push(T& value)
+	{
+		if (closed_.load(std::memory_order_relaxed))
+			return false;
+		std::size_t pos = tail_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell& c = cells_[pos & mask_];
+			const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+			const std::intptr_t diff = static_cast<std::intptr_t>(sequence - pos);
+			if (diff == 0)
+			{
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					new (c.storage) T(std::move(value));
+					c.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = tail_.load(std::memory_order_relaxed);
+		}
+	}
+
+	template<class T>
+	bool channel<T>::try_pop(T& value)
+	{
+		std::size_t pos = head_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell& c = cells_[pos & mask_];
+			const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+			const std::intptr_t diff = static_cast<std::intptr_t>(sequence - (pos + 1));
+			if (diff == 0)
+			{
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					T* item = std::launder(reinterpret_cast<T*>(c.storage));
+					value = std::move(*item);
+					item->~T();
+					c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	template<class T>
+	bool channel<T>::push(T value)
+	{
+		return push(std::span<T>(&value, 1)) == 1;
+	}
+
+	template<class T>
+	std::size_t channel<T>::push(std::span<T> values)
+	{
+		std::size_t done = 0;
+		std::size_t announced = 0;
+		unsigned spin = 0;
+		while (done < values.size())
+		{
+			if (try_push(values[done]))
+			{
+				++done;
+				spin = 0;
+				continue;
+			}
+			if (closed_.load(std::memory_order_acquire))
+				break;
+			// let readers at what is in before waiting for room
+			if (done != announced)
+			{
+				notify_readers(static_cast<std::uint32_t>(done - announced));
+				announced = done;
+			}
+			if (++spin < spin_count)
+			{
+				relax();
+				continue;
+			}
+			const std::uint32_t epoch = begin_wait(writable_, writers_);
+			if (try_push(values[done]))
+				++done;
+			else if (!closed_.load(std::memory_order_acquire))
+				wait(writable_, epoch);
+			end_wait(writers_);
+			spin = 0;
+		}
+		if (done != announced)
+			notify_readers(static_cast<std::uint32_t>(done - announced));
+		return done;
+	}
+
+	template<class T>
+	bool channel<T>::pop(T& value)
+	{
+		return pop(std::span<T>(&value, 1)) == 1;
+	}
+
+	template<class T>
+	std::size_t channel<T>::pop(std::span<T> values)
+	{
+		std::size_t done = 0;
+		unsigned spin = 0;
+		while (done < values.size())
+		{
+			if (try_pop(values[done]))
+			{
+				++done;
+				continue;
+			}
+			// hand back what is there rather than wait for a full batch
+			if (done != 0 || drained())
+				break;
+			if (++spin < spin_count)
+			{
+				relax();
+				continue;
+			}
+			const std::uint32_t epoch = begin_wait(readable_, readers_);
+			if (try_pop(values[done]))
+				++done;
+			else if (!drained())
+				wait(readable_, epoch);
+			end_wait(readers_);
+			spin = 0;
+		}
+		if (done != 0)
+			notify_writers(static_cast<std::uint32_t>(done));
+		return done;
+	}
+}
+
+#endif
+
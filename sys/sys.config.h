@@ -37,6 +37,18 @@
 
 #if defined(__linux)
 #define SYS_HAVE_PROC_SELF_EXE
+#define SYS_HAVE_GETDENTS64
+#define SYS_HAVE_INOTIFY
+#define SYS_HAVE_FICLONE
+#define SYS_HAVE_COPY_FILE_RANGE
+#define SYS_HAVE_SENDFILE
+#define SYS_HAVE_STATX
+#define SYS_HAVE_FUTEX
+#define SYS_HAVE_SCHED_AFFINITY
+#define SYS_HAVE_SET_MEMPOLICY
+#define SYS_HAVE_RUSAGE_THREAD
+#define SYS_HAVE_TIMERFD
+#define SYS_HAVE_IO_URING
 #elif defined(__sun)
 #define SYS_HAVE_PROC_SELF_PATH_AOUT
 #undef SYS_HAVE_GETEXECNAME
@@ -59,6 +71,19 @@
 #define SYS_HAVE_PROC_SELF_EXEFILE
 #endif
 
+#if defined(__linux) || defined(__APPLE__) || defined(__FreeBSD__) || \
+	defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define SYS_HAVE_DIRENT_D_TYPE
+#endif
+
+#if defined(SYS_NO_GETDENTS64)
+#undef SYS_HAVE_GETDENTS64
+#endif
+
+#if defined(SYS_NO_IO_URING)
+#undef SYS_HAVE_IO_URING
+#endif
+
 #if defined(SYS_LACKS_INLINE_FUNCTIONS) && !defined(SYS_NO_INLINE)
 #define SYS_NO_INLINE
 #endif
@@ -99,6 +124,10 @@
 #undef SYS_WIN32
 #include <windows.h>
 #define SYS_WIN32
+// walk_entry::dirfd has no directory handle to hold on windows
+#if !defined(AT_FDCWD)
+#define AT_FDCWD -1
+#endif
 #if defined(SYS_CYGWIN)
 #include <sys/cygwin.h>
 #endif
@@ -0,0 +1,425 @@
+#include "sys.config.h"
+#include "sys.copy.h"
+#include "sys.walker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#endif
+
+#if defined(SYS_HAVE_FICLONE)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#if defined(SYS_HAVE_SENDFILE)
+#include <sys/sendfile.h>
+#endif
+
+static const std::size_t copy_chunk_size = 1 << 30;
+static const std::size_t copy_buffer_size = 1 << 20;
+
+namespace
+{
+	struct copy_job
+	{
+		std::string src;
+		std::string dst;
+	};
+
+	struct dir_attributes
+	{
+		std::string dst;
+#if !defined(SYS_WIN32)
+		struct stat st;
+#endif
+	};
+
+#if !defined(SYS_WIN32)
+	void file_times(const struct stat& st, struct timespec times[2])
+	{
+#if defined(__APPLE__)
+		times[0] = st.st_atimespec;
+		times[1] = st.st_mtimespec;
+#else
+		times[0] = st.st_atim;
+		times[1] = st.st_mtim;
+#endif
+	}
+
+	bool fallback_error(int err)
+	{
+		return err == EXDEV || err == ENOSYS || err == EINVAL ||
+			err == EOPNOTSUPP || err == ENOTSUP || err == EBADF;
+	}
+
+	bool copy_data(int in, int out)
+	{
+#if defined(SYS_HAVE_FICLONE)
+		if (::ioctl(out, FICLONE, in) == 0)
+			return true;
+#endif
+#if defined(SYS_HAVE_COPY_FILE_RANGE)
+		for (std::uint64_t copied = 0;;)
+		{
+			const ssize_t n = ::copy_file_range(in, nullptr, out, nullptr,
+				copy_chunk_size, 0);
+			if (n > 0)
+			{
+				copied += static_cast<std::uint64_t>(n);
+				continue;
+			}
+			if (n == 0)
+				return true;
+			if (errno == EINTR)
+				continue;
+			if (copied != 0 || !fallback_error(errno))
+				return false;
+			break;
+		}
+#endif
+#if defined(SYS_HAVE_SENDFILE)
+		for (std::uint64_t copied = 0;;)
+		{
+			const ssize_t n = ::sendfile(out, in, nullptr, copy_chunk_size);
+			if (n > 0)
+			{
+				copied += static_cast<std::uint64_t>(n);
+				continue;
+			}
+			if (n == 0)
+				return true;
+			if (errno == EINTR)
+				continue;
+			if (copied != 0 || !fallback_error(errno))
+				return false;
+			break;
+		}
+#endif
+		std::vector<char> buf(copy_buffer_size);
+		for (;;)
+		{
+			const ssize_t n = ::read(in, buf.data(), buf.size());
+			if (n == 0)
+				return true;
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			for (ssize_t written = 0; written < n; )
+			{
+				const ssize_t w = ::write(out, buf.data() + written,
+					static_cast<std::size_t>(n - written));
+				if (w < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					return false;
+				}
+				written += w;
+			}
+		}
+	}
+
+	bool copy_symlink(const sys::walk_entry& entry, const std::string& dst,
+		const sys::copy_options& options)
+	{
+		const char* name = entry.path + entry.name_pos;
+		std::vector<char> buf(128);
+		for (;;)
+		{
+			const ssize_t n = ::readlinkat(entry.dirfd, name, buf.data(), buf.size());
+			if (n < 0)
+				return false;
+			if (static_cast<std::size_t>(n) < buf.size())
+			{
+				buf[static_cast<std::size_t>(n)] = '\0';
+				break;
+			}
+			buf.resize(buf.size() * 2);
+		}
+		if (::symlink(buf.data(), dst.c_str()) != 0)
+			return false;
+		if (options.preserve_times)
+		{
+			struct stat st;
+			struct timespec times[2];
+			if (::fstatat(entry.dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+			{
+				file_times(st, times);
+				::utimensat(AT_FDCWD, dst.c_str(), times, AT_SYMLINK_NOFOLLOW);
+			}
+		}
+		return true;
+	}
+#endif
+
+	int last_error(void)
+	{
+#if defined(SYS_WIN32)
+		return static_cast<int>(::GetLastError());
+#else
+		return errno;
+#endif
+	}
+
+	std::uintmax_t copy_tree(const sys::path& src, const sys::path& dst,
+		const sys::copy_options& options, sys::thread_group* group, int& error)
+	{
+		error = 0;
+		// a symlinked source is copied as a link or followed, like the
+		// links inside the tree
+		const sys::file_type_t type = options.copy_symlinks ?
+			src.status() : src.target_status();
+		if (type != sys::directory_file)
+		{
+			if (type == sys::file_not_found || type == sys::status_error)
+			{
+				error = ENOENT;
+				return 0;
+			}
+#if !defined(SYS_WIN32)
+			if (type == sys::symlink_file)
+			{
+				sys::walk_entry entry;
+				entry.path = src.c_str();
+				entry.size = src.size();
+				entry.name_pos = 0;
+				entry.dirfd = AT_FDCWD;
+				if (copy_symlink(entry, dst.native(), options))
+					return 1;
+				error = errno;
+				return 0;
+			}
+#endif
+			if (sys::copy_file(src, dst, options))
+				return 1;
+			error = last_error();
+			return 0;
+		}
+
+		if (!dst.create_all())
+		{
+			error = last_error();
+			return 0;
+		}
+
+		// entries keep the separator after the source, so that a root
+		// source ("/") and a root destination join up the same way
+		std::string base(dst.native());
+		while (!base.empty() && std::strchr(sys::path::separators, base.back()))
+			base.pop_back();
+		std::string root(src.native());
+		while (root.size() > 1 && std::strchr(sys::path::separators, root.back()))
+			root.pop_back();
+		const std::size_t prefix = root.size() -
+			(std::strchr(sys::path::separators, root.back()) ? 1 : 0);
+
+		std::uintmax_t count = 1;
+		std::vector<copy_job> files;
+		std::vector<dir_attributes> dirs;
+
+		sys::walk_options walk_options;
+		walk_options.order = sys::walk_pre_order | sys::walk_post_order;
+		walk_options.follow_symlinks = !options.copy_symlinks;
+		sys::walker w(src, walk_options);
+		w.walk([&](const sys::walk_entry& entry) {
+			std::string target(base);
+			target.append(entry.path + prefix, entry.size - prefix);
+
+			if (entry.order == sys::walk_post_order)
+			{
+				if (entry.type == sys::directory_file &&
+					(options.preserve_mode || options.preserve_times))
+				{
+					dir_attributes attributes;
+					attributes.dst = std::move(target);
+#if !defined(SYS_WIN32)
+					if (::fstatat(entry.dirfd, entry.path + entry.name_pos,
+							&attributes.st, 0) != 0)
+						return sys::walk_continue;
+#endif
+					dirs.push_back(std::move(attributes));
+				}
+				return sys::walk_continue;
+			}
+
+			switch (entry.type)
+			{
+			case sys::directory_file:
+				if (sys::path(target).create() ||
+					sys::path(target).status() == sys::directory_file)
+				{
+					++count;
+					return sys::walk_continue;
+				}
+				if (error == 0)
+					error = last_error();
+				return sys::walk_skip;
+			case sys::regular_file:
+				files.push_back({ std::string(entry.path, entry.size),
+					std::move(target) });
+				return sys::walk_continue;
+#if !defined(SYS_WIN32)
+			case sys::symlink_file:
+				if (copy_symlink(entry, target, options))
+					++count;
+				else if (error == 0)
+					error = errno;
+				return sys::walk_continue;
+#endif
+			default:
+				return sys::walk_continue;
+			}
+		});
+		if (error == 0)
+			error = w.error();
+
+		// the walker never hands out the root, so it goes last by hand
+		if (options.preserve_mode || options.preserve_times)
+		{
+			dir_attributes attributes;
+			attributes.dst = dst.native();
+#if !defined(SYS_WIN32)
+			if (::stat(src.c_str(), &attributes.st) == 0)
+#endif
+				dirs.push_back(std::move(attributes));
+		}
+
+		std::atomic<std::size_t> next(0);
+		std::atomic<std::uintmax_t> copied(0);
+		std::atomic<int> first_error(0);
+		auto copy_files = [&](std::size_t) {
+			for (std::size_t i = next++; i < files.size(); i = next++)
+			{
+				if (sys::copy_file(files[i].src, files[i].dst, options))
+					copied.fetch_add(1, std::memory_order_relaxed);
+				else
+				{
+					int expected = 0;
+					first_error.compare_exchange_strong(expected, last_error());
+				}
+			}
+		};
+
+		std::size_t threads = options.threads;
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, files.size());
+		if (group != nullptr && threads > 1)
+			group->run(threads, copy_files);
+		else
+			copy_files(0);
+
+		count += copied.load();
+		if (error == 0)
+			error = first_error.load();
+
+#if !defined(SYS_WIN32)
+		for (const dir_attributes& attributes : dirs)
+		{
+			if (options.preserve_mode)
+				::chmod(attributes.dst.c_str(), attributes.st.st_mode & 07777);
+			if (options.preserve_times)
+			{
+				struct timespec times[2];
+				file_times(attributes.st, times);
+				::utimensat(AT_FDCWD, attributes.dst.c_str(), times, 0);
+			}
+		}
+#endif
+		return count;
+	}
+}
+
+bool sys::copy_file(const sys::path& src, const sys::path& dst)
+{
+	return copy_file(src, dst, copy_options());
+}
+
+bool sys::copy_file(const sys::path& src, const sys::path& dst,
+	const sys::copy_options& options)
+{
+#if defined(SYS_WIN32)
+	(void)options;
+	return ::CopyFileA(src.c_str(), dst.c_str(), FALSE) != 0;
+#else
+	const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in == -1)
+		return false;
+
+	struct stat st;
+	if (::fstat(in, &st) != 0)
+	{
+		const int err = errno;
+		::close(in);
+		errno = err;
+		return false;
+	}
+
+	// truncated only once it is known not to be the source itself
+	const int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+		options.preserve_mode ? (st.st_mode & 0777) : 0666);
+	if (out == -1)
+	{
+		const int err = errno;
+		::close(in);
+		errno = err;
+		return false;
+	}
+
+	struct stat target;
+	int err = 0;
+	if (::fstat(out, &target) != 0)
+		err = errno;
+	else if (target.st_dev == st.st_dev && target.st_ino == st.st_ino)
+		err = EINVAL;
+	else if (::ftruncate(out, 0) != 0)
+		err = errno;
+	if (err != 0)
+	{
+		::close(in);
+		::close(out);
+		errno = err;
+		return false;
+	}
+
+	bool result = copy_data(in, out);
+	if (result && options.preserve_mode)
+		result = ::fchmod(out, st.st_mode & 07777) == 0;
+	if (result && options.preserve_times)
+	{
+		struct timespec times[2];
+		file_times(st, times);
+		result = ::futimens(out, times) == 0;
+	}
+
+	err = errno;
+	::close(in);
+	if (::close(out) != 0 && result)
+		return false;
+	errno = err;
+	return result;
+#endif
+}
+
+std::uintmax_t sys::copy_tree(const sys::path& src, const sys::path& dst,
+	const sys::copy_options& options, int& error)
+{
+	return ::copy_tree(src, dst, options, nullptr, error);
+}
+
+std::uintmax_t sys::copy_tree(const sys::path& src, const sys::path& dst,
+	const sys::copy_options& options, sys::thread_group& group, int& error)
+{
+	return ::copy_tree(src, dst, options, &group, error);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef __SYS_COPY__
+#define __SYS_COPY__
+
+#include "sys.config.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <cstdint>
+
+namespace sys
+{
+	struct copy_options
+	{
+		bool preserve_mode = true;
+		bool preserve_times = false;
+		bool copy_symlinks = true;
+		std::size_t threads = 0;
+	};
+
+	// fails with EINVAL, leaving both alone, when dst is src
+	bool copy_file(const path& src, const path& dst);
+	bool copy_file(const path& src, const path& dst, const copy_options& options);
+
+	std::uintmax_t copy_tree(const path& src, const path& dst,
+		const copy_options& options, int& error);
+	std::uintmax_t copy_tree(const path& src, const path& dst,
+		const copy_options& options, thread_group& group, int& error);
+}
+
+#endif
+
@@ -0,0 +1,205 @@
+#include "sys.config.h"
+#include "sys.cpu_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#if defined(SYS_HAVE_SCHED_AFFINITY)
+#include <sched.h>
+#endif
+
+namespace
+{
+	struct cpu_info
+	{
+		int cpu;
+		int node;
+		int package;
+		int core;
+		int sibling;
+		int slot;
+	};
+
+	bool read_line(const std::string& name, std::string& line)
+	{
+		std::ifstream ifs(name.c_str());
+		return static_cast<bool>(std::getline(ifs, line));
+	}
+
+	int read_int(const std::string& name, int fallback)
+	{
+		std::string line;
+		if (!read_line(name, line) || line.empty())
+			return fallback;
+		return std::atoi(line.c_str());
+	}
+
+	// "0-3,8,10-11"
+	std::vector<int> parse_list(const std::string& list)
+	{
+		std::vector<int> result;
+		const char* s = list.c_str();
+		while (*s != '\0')
+		{
+			char* end = nullptr;
+			const long first = std::strtol(s, &end, 10);
+			if (end == s)
+				break;
+			long last = first;
+			s = end;
+			if (*s == '-')
+			{
+				last = std::strtol(s + 1, &end, 10);
+				s = end;
+			}
+			for (long i = first; i <= last; ++i)
+				result.push_back(static_cast<int>(i));
+			if (*s == ',')
+				++s;
+			else
+				break;
+		}
+		return result;
+	}
+
+	std::vector<int> allowed_cpus(void)
+	{
+		std::vector<int> cpus;
+#if defined(SYS_HAVE_SCHED_AFFINITY)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			for (int i = 0; i < CPU_SETSIZE; ++i)
+				if (CPU_ISSET(i, &set))
+					cpus.push_back(i);
+		}
+#endif
+		if (cpus.empty())
+		{
+			const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+			for (unsigned i = 0; i < count; ++i)
+				cpus.push_back(static_cast<int>(i));
+		}
+		return cpus;
+	}
+}
+
+sys::cpu_topology::cpu_topology(void)
+{
+	const std::vector<int> allowed = allowed_cpus();
+
+#if !defined(SYS_WIN32)
+	static const std::string node_root("/sys/devices/system/node/");
+	std::string line;
+	if (read_line(node_root + "online", line))
+	{
+		for (int id : parse_list(line))
+		{
+			std::string cpulist;
+			if (!read_line(node_root + "node" + std::to_string(id) + "/cpulist", cpulist))
+				continue;
+			numa_node node;
+			node.id = id;
+			for (int cpu : parse_list(cpulist))
+				if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+					node.cpus.push_back(cpu);
+			if (!node.cpus.empty())
+				nodes_.push_back(std::move(node));
+		}
+	}
+#endif
+	if (nodes_.empty())
+	{
+		nodes_.resize(1);
+		nodes_[0].cpus = allowed;
+	}
+
+	std::vector<cpu_info> infos;
+	for (const numa_node& node : nodes_)
+	{
+		for (int cpu : node.cpus)
+		{
+			const std::string dir = "/sys/devices/system/cpu/cpu" +
+				std::to_string(cpu) + "/topology/";
+			infos.push_back({ cpu, node.id, read_int(dir + "physical_package_id", 0),
+				read_int(dir + "core_id", cpu), 0, 0 });
+		}
+	}
+
+	// hyperthreads of one core get increasing sibling numbers
+	std::sort(infos.begin(), infos.end(), [](const cpu_info& lhs, const cpu_info& rhs) {
+		return std::tie(lhs.node, lhs.package, lhs.core, lhs.cpu) <
+			std::tie(rhs.node, rhs.package, rhs.core, rhs.cpu);
+	});
+	for (std::size_t i = 1; i < infos.size(); ++i)
+	{
+		const cpu_info& prev = infos[i - 1];
+		if (infos[i].node == prev.node && infos[i].package == prev.package &&
+				infos[i].core == prev.core)
+			infos[i].sibling = prev.sibling + 1;
+	}
+	for (const cpu_info& info : infos)
+		compact_.push_back(info.cpu);
+
+	// spread over nodes first, then over physical cores, then siblings
+	std::sort(infos.begin(), infos.end(), [](const cpu_info& lhs, const cpu_info& rhs) {
+		return std::tie(lhs.node, lhs.sibling, lhs.package, lhs.core) <
+			std::tie(rhs.node, rhs.sibling, rhs.package, rhs.core);
+	});
+	for (std::size_t i = 1; i < infos.size(); ++i)
+		if (infos[i].node == infos[i - 1].node)
+			infos[i].slot = infos[i - 1].slot + 1;
+	std::sort(infos.begin(), infos.end(), [](const cpu_info& lhs, const cpu_info& rhs) {
+		return std::tie(lhs.slot, lhs.node) < std::tie(rhs.slot, rhs.node);
+	});
+	for (const cpu_info& info : infos)
+		scatter_.push_back(info.cpu);
+}
+
+sys::cpu_topology::~cpu_topology(void)
+{
+}
+
+const sys::cpu_topology& sys::cpu_topology::system(void)
+{
+	static const cpu_topology topology;
+	return topology;
+}
+
+const std::vector<sys::numa_node>& sys::cpu_topology::nodes(void) const
+{
+	return nodes_;
+}
+
+std::size_t sys::cpu_topology::cpus(void) const
+{
+	return compact_.size();
+}
+
+int sys::cpu_topology::compact_cpu(std::size_t index) const
+{
+	return compact_[index % compact_.size()];
+}
+
+int sys::cpu_topology::scatter_cpu(std::size_t index) const
+{
+	return scatter_[index % scatter_.size()];
+}
+
+const sys::numa_node& sys::cpu_topology::node(std::size_t index) const
+{
+	return nodes_[index % nodes_.size()];
+}
+
+int sys::cpu_topology::node_of(int cpu) const
+{
+	for (const numa_node& node : nodes_)
+		if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end())
+			return node.id;
+	return -1;
+}
\ No newline at end of file
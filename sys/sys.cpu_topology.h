@@ -0,0 +1,41 @@
+#ifndef __SYS_CPU_TOPOLOGY__
+#define __SYS_CPU_TOPOLOGY__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace sys
+{
+	struct numa_node
+	{
+		int id = 0;
+		std::vector<int> cpus;
+	};
+
+	// cpus usable by this process, grouped by NUMA node; falls back to a
+	// single node when /sys/devices/system/node is not available
+	class cpu_topology : public noncopyable
+	{
+		std::vector<numa_node> nodes_;
+		std::vector<int> compact_;
+		std::vector<int> scatter_;
+	public:
+		cpu_topology(void);
+		virtual ~cpu_topology(void);
+	public:
+		static const cpu_topology& system(void);
+	public:
+		const std::vector<numa_node>& nodes(void) const;
+		std::size_t cpus(void) const;
+		int compact_cpu(std::size_t index) const;
+		int scatter_cpu(std::size_t index) const;
+		const numa_node& node(std::size_t index) const;
+		int node_of(int cpu) const;
+	};
+}
+
+#endif
+
@@ -1,9 +1,30 @@
 #include "sys.config.h"
 #include "sys.dir.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstring>
 #include <cstdlib>
 
+#if defined(SYS_HAVE_GETDENTS64)
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+struct linux_dirent64
+{
+	std::uint64_t d_ino;
+	std::int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+#elif !defined(SYS_WIN32)
+#include <fcntl.h>
+#else
+#include <sys/stat.h>
+#endif
+
 #if defined(SYS_WIN32)
 static ::DIR* opendir(const char* path)
 {
@@ -38,7 +59,11 @@ static struct ::dirent* readdir(::DIR* entry)
 	{
 		int status = ::FindNextFileA(entry->search, &entry->win32_find_data);
 		if (status == 0)
+		{
+			if (::GetLastError() != ERROR_NO_MORE_FILES)
+				errno = EIO;
 			return nullptr;
+		}
 	}
 
 	entry->firsttime = FALSE;
@@ -54,24 +79,402 @@ static void closedir(::DIR* entry)
 }
 #endif
 
+static const std::size_t dir_list_batch_size = 256;
+
+static int natural_compare(const std::string& a, const std::string& b)
+{
+	std::size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size())
+	{
+		const unsigned char ca = static_cast<unsigned char>(a[i]);
+		const unsigned char cb = static_cast<unsigned char>(b[j]);
+		if (std::isdigit(ca) && std::isdigit(cb))
+		{
+			while (i < a.size() && a[i] == '0')
+				++i;
+			while (j < b.size() && b[j] == '0')
+				++j;
+			std::size_t ei = i, ej = j;
+			while (ei < a.size() && std::isdigit(static_cast<unsigned char>(a[ei])))
+				++ei;
+			while (ej < b.size() && std::isdigit(static_cast<unsigned char>(b[ej])))
+				++ej;
+			if (ei - i != ej - j)
+				return ei - i < ej - j ? -1 : 1;
+			const int result = a.compare(i, ei - i, b, j, ej - j);
+			if (result != 0)
+				return result;
+			i = ei;
+			j = ej;
+			continue;
+		}
+		if (ca != cb)
+			return ca < cb ? -1 : 1;
+		++i;
+		++j;
+	}
+	if (i < a.size())
+		return 1;
+	if (j < b.size())
+		return -1;
+	return a.compare(b);
+}
+
+// every open dir holds one, and walkers keep one per level or per kept
+// directory, so the default stays small; huge directories read in a
+// single pass can ask for large_buffer_size
+const std::size_t sys::dir::default_buffer_size = 64 * 1024;
+const std::size_t sys::dir::large_buffer_size = 1 << 20;
+
+static bool is_dot_or_dotdot(const char* name)
+{
+	return name[0] == '.' &&
+		(name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+#if defined(SYS_HAVE_GETDENTS64) || defined(SYS_HAVE_DIRENT_D_TYPE)
+static sys::file_type_t dtype_to_file_type(unsigned char d_type)
+{
+	switch (d_type)
+	{
+	case DT_REG:
+		return sys::regular_file;
+	case DT_DIR:
+		return sys::directory_file;
+	case DT_LNK:
+		return sys::symlink_file;
+	case DT_BLK:
+		return sys::block_file;
+	case DT_CHR:
+		return sys::character_file;
+	case DT_FIFO:
+		return sys::fifo_file;
+	case DT_SOCK:
+		return sys::socket_file;
+	default:
+		return sys::type_unknown;
+	}
+}
+#endif
+
+sys::file_type_t sys::dir::file_type(std::uint32_t mode)
+{
+#if defined(SYS_WIN32)
+	if (mode & _S_IFDIR)
+		return sys::directory_file;
+	if (mode & _S_IFREG)
+		return sys::regular_file;
+	if (mode & _S_IFCHR)
+		return sys::character_file;
+	return sys::type_unknown;
+#else
+	if (S_ISREG(mode))
+		return sys::regular_file;
+	if (S_ISDIR(mode))
+		return sys::directory_file;
+	if (S_ISLNK(mode))
+		return sys::symlink_file;
+	if (S_ISBLK(mode))
+		return sys::block_file;
+	if (S_ISCHR(mode))
+		return sys::character_file;
+	if (S_ISFIFO(mode))
+		return sys::fifo_file;
+	if (S_ISSOCK(mode))
+		return sys::socket_file;
+	return sys::type_unknown;
+#endif
+}
+
 sys::dir::dir(const char* name)
+	: dir(name, default_buffer_size)
+{
+}
+
+sys::dir::dir(const char* name, std::size_t buffer_size)
+#if defined(SYS_HAVE_GETDENTS64)
+	: fd_(::open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+#else
 	: dirp_(::opendir(name))
+#endif
+	, error_(is_open() ? 0 : errno)
+	, capacity_(std::max<std::size_t>(buffer_size, 4096))
+	, buf_(new char[capacity_])
+	, pos_(0)
+	, end_(0)
+{
+}
+
+#if !defined(SYS_WIN32)
+sys::dir::dir(int dirfd, const char* name, bool follow_symlinks,
+	std::size_t buffer_size)
+#if defined(SYS_HAVE_GETDENTS64)
+	: fd_(::openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+		(follow_symlinks ? 0 : O_NOFOLLOW)))
+#else
+	: dirp_(nullptr)
+#endif
+	, error_(is_open() ? 0 : errno)
+	, capacity_(std::max<std::size_t>(buffer_size, 4096))
+	, buf_(new char[capacity_])
+	, pos_(0)
+	, end_(0)
 {
+#if !defined(SYS_HAVE_GETDENTS64)
+	int fd = ::openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+		(follow_symlinks ? 0 : O_NOFOLLOW));
+	if (fd != -1 && (dirp_ = ::fdopendir(fd)) == nullptr)
+	{
+		error_ = errno;
+		::close(fd);
+	}
+	else
+		error_ = fd == -1 ? errno : 0;
+#endif
 }
+#endif
 
 sys::dir::~dir(void)
 {
+#if defined(SYS_HAVE_GETDENTS64)
+	if (fd_ != -1)
+		::close(fd_);
+#else
 	if (dirp_)
 		::closedir(dirp_);
+#endif
 }
 
+int sys::dir::error(void) const
+{
+	return error_;
+}
+
+bool sys::dir::is_open(void) const
+{
+#if defined(SYS_HAVE_GETDENTS64)
+	return fd_ != -1;
+#else
+	return dirp_ != nullptr;
+#endif
+}
+
+#if !defined(SYS_WIN32)
+int sys::dir::native_handle(void) const
+{
+#if defined(SYS_HAVE_GETDENTS64)
+	return fd_;
+#else
+	return dirp_ ? ::dirfd(dirp_) : -1;
+#endif
+}
+
+sys::file_type_t sys::dir::status(const char* name, bool follow_symlinks) const
+{
+	struct stat st;
+	if (follow_symlinks && ::fstatat(native_handle(), name, &st, 0) == 0)
+		return file_type(st.st_mode);
+	if (::fstatat(native_handle(), name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+		return file_type(st.st_mode);
+	return (errno == ENOENT || errno == ENOTDIR) ?
+		sys::file_not_found : sys::status_error;
+}
+#endif
+
 bool sys::dir::advance(std::string& dname)
 {
-	const struct ::dirent* entp = ::readdir(dirp_);
-	if (entp == nullptr)
+	dir_entry entry;
+	if (!advance(entry))
 		return false;
-	if (!std::strcmp(entp->d_name, ".") || !std::strcmp(entp->d_name, ".."))
-		return advance(dname);
-	dname = entp->d_name;
+	dname.assign(entry.name, entry.size);
 	return true;
-}
\ No newline at end of file
+}
+
+bool sys::dir::advance(sys::dir_entry& entry)
+{
+	return read_batch(std::span<dir_entry>(&entry, 1)) == 1;
+}
+
+std::vector<sys::list_entry> sys::dir::list(void)
+{
+	return list(list_options());
+}
+
+std::vector<sys::list_entry> sys::dir::list(const sys::list_options& options)
+{
+	struct name_ref
+	{
+		std::size_t offset;
+		std::size_t size;
+		std::uint64_t inode;
+		file_type_t type;
+	};
+
+	std::string names;
+	std::vector<name_ref> refs;
+	dir_entry batch[dir_list_batch_size];
+	for (std::size_t n; (n = read_batch(batch)) != 0; )
+	{
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			refs.push_back({ names.size(), batch[i].size,
+				batch[i].inode, batch[i].type });
+			names.append(batch[i].name, batch[i].size);
+		}
+	}
+
+	std::vector<list_entry> entries(refs.size());
+	for (std::size_t i = 0; i < refs.size(); ++i)
+	{
+		list_entry& entry = entries[i];
+		entry.name.assign(names, refs[i].offset, refs[i].size);
+		entry.inode = refs[i].inode;
+		entry.type = refs[i].type;
+		entry.has_metadata = false;
+		entry.mode = 0;
+		entry.size = 0;
+		entry.mtime = 0;
+	}
+
+#if !defined(SYS_WIN32)
+	if (options.metadata || options.order == list_by_mtime)
+	{
+		// inode order keeps the inode table reads sequential on ext4/xfs
+		std::vector<std::size_t> order(entries.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&entries](std::size_t a, std::size_t b) {
+			return entries[a].inode < entries[b].inode;
+		});
+
+		const int fd = native_handle();
+		for (std::size_t i : order)
+		{
+			list_entry& entry = entries[i];
+			struct stat st;
+			if ((!options.follow_symlinks ||
+					::fstatat(fd, entry.name.c_str(), &st, 0) != 0) &&
+				::fstatat(fd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+				continue;
+			entry.has_metadata = true;
+			entry.type = file_type(st.st_mode);
+			entry.mode = static_cast<std::uint32_t>(st.st_mode);
+			entry.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+			entry.mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+			entry.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+		}
+	}
+#endif
+
+	switch (options.order)
+	{
+	case list_by_name:
+		std::sort(entries.begin(), entries.end(),
+			[](const list_entry& a, const list_entry& b) {
+				return a.name < b.name;
+			});
+		break;
+	case list_natural:
+		std::sort(entries.begin(), entries.end(),
+			[](const list_entry& a, const list_entry& b) {
+				return natural_compare(a.name, b.name) < 0;
+			});
+		break;
+	case list_by_mtime:
+		std::sort(entries.begin(), entries.end(),
+			[](const list_entry& a, const list_entry& b) {
+				return a.mtime != b.mtime ? a.mtime < b.mtime : a.name < b.name;
+			});
+		break;
+	default:
+		break;
+	}
+	return entries;
+}
+
+#if defined(SYS_HAVE_GETDENTS64)
+std::size_t sys::dir::read_batch(std::span<sys::dir_entry> entries)
+{
+	if (!is_open() || entries.empty())
+		return 0;
+
+	std::size_t count = 0;
+	while (count == 0)
+	{
+		if (pos_ == end_ && !fill())
+			return 0;
+		while (pos_ < end_ && count < entries.size())
+		{
+			const linux_dirent64* entp =
+				reinterpret_cast<const linux_dirent64*>(buf_.get() + pos_);
+			pos_ += entp->d_reclen;
+			if (is_dot_or_dotdot(entp->d_name))
+				continue;
+			dir_entry& entry = entries[count++];
+			entry.name = entp->d_name;
+			entry.size = std::strlen(entp->d_name);
+			entry.inode = entp->d_ino;
+			entry.type = dtype_to_file_type(entp->d_type);
+		}
+	}
+	return count;
+}
+
+bool sys::dir::fill(void)
+{
+	long result = ::syscall(SYS_getdents64, fd_, buf_.get(), capacity_);
+	pos_ = 0;
+	end_ = result > 0 ? static_cast<std::size_t>(result) : 0;
+	if (result < 0)
+		error_ = errno;
+	return end_ != 0;
+}
+#else
+std::size_t sys::dir::read_batch(std::span<sys::dir_entry> entries)
+{
+	if (!is_open())
+		return 0;
+
+	std::size_t count = 0;
+	for (pos_ = 0; count < entries.size() && fill(); )
+	{
+		errno = 0;
+		const struct ::dirent* entp = ::readdir(dirp_);
+		if (entp == nullptr)
+		{
+			if (errno != 0)
+				error_ = errno;
+			break;
+		}
+		if (is_dot_or_dotdot(entp->d_name))
+			continue;
+		dir_entry& entry = entries[count++];
+		entry.size = std::strlen(entp->d_name);
+		entry.name = static_cast<const char*>(
+			std::memcpy(buf_.get() + pos_, entp->d_name, entry.size + 1));
+		pos_ += entry.size + 1;
+#if defined(SYS_WIN32)
+		entry.inode = 0;
+		const DWORD attr = dirp_->win32_find_data.dwFileAttributes;
+		entry.type = (attr & FILE_ATTRIBUTE_REPARSE_POINT) ? sys::type_unknown :
+			(attr & FILE_ATTRIBUTE_DIRECTORY) ? sys::directory_file : sys::regular_file;
+#else
+		entry.inode = entp->d_ino;
+#if defined(SYS_HAVE_DIRENT_D_TYPE)
+		entry.type = dtype_to_file_type(entp->d_type);
+#else
+		entry.type = sys::type_unknown;
+#endif
+#endif
+	}
+	return count;
+}
+
+bool sys::dir::fill(void)
+{
+	return capacity_ - pos_ >= sizeof(::dirent::d_name);
+}
+#endif
\ No newline at end of file
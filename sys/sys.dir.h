@@ -2,8 +2,14 @@
 #define __SYS_DIR__
 
 #include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
 
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 #if defined(SYS_WIN32)
 struct dirent
@@ -18,18 +24,88 @@ typedef struct
 	BOOL firsttime;
 	struct dirent fileinfo;
 } DIR;
+#else
+#include <dirent.h>
 #endif
 
 namespace sys
 {
-	class dir
+	typedef enum
 	{
+		list_unsorted, list_by_name, list_natural, list_by_mtime
+	} list_order_t;
+
+	struct dir_entry
+	{
+		const char* name;
+		std::size_t size;
+		std::uint64_t inode;
+		file_type_t type;
+	};
+
+	struct list_options
+	{
+		list_order_t order = list_by_name;
+		bool metadata = false;
+		bool follow_symlinks = false;
+	};
+
+	// mode, size and mtime are only valid when has_metadata is set
+	struct list_entry
+	{
+		std::string name;
+		std::uint64_t inode;
+		file_type_t type;
+		bool has_metadata;
+		std::uint32_t mode;
+		std::uint64_t size;
+		std::int64_t mtime;
+	};
+
+	class dir : public noncopyable
+	{
+#if defined(SYS_HAVE_GETDENTS64)
+		int fd_;
+#else
 		::DIR* dirp_;
+#endif
+		int error_;
+		std::size_t capacity_;
+		std::unique_ptr<char[]> buf_;
+		std::size_t pos_;
+		std::size_t end_;
+	public:
+		static const std::size_t default_buffer_size;
+		static const std::size_t large_buffer_size;
+	public:
+		static file_type_t file_type(std::uint32_t mode);
 	public:
 		dir(const char* name);
+		dir(const char* name, std::size_t buffer_size);
+#if !defined(SYS_WIN32)
+		dir(int dirfd, const char* name, bool follow_symlinks,
+			std::size_t buffer_size = default_buffer_size);
+#endif
 		virtual ~dir(void);
+	public:
+		bool is_open(void) const;
+		// 0, or the errno value of a failed open or read; a listing that
+		// stops on an error is incomplete
+		int error(void) const;
+#if !defined(SYS_WIN32)
+		int native_handle(void) const;
+		file_type_t status(const char* name, bool follow_symlinks) const;
+#endif
 	public:
 		bool advance(std::string& dname);
+		bool advance(dir_entry& entry);
+		// entry names point into the internal buffer and stay valid
+		// until the next call to advance() or read_batch()
+		std::size_t read_batch(std::span<dir_entry> entries);
+		std::vector<list_entry> list(void);
+		std::vector<list_entry> list(const list_options& options);
+	private:
+		bool fill(void);
 	};
 }
 
@@ -0,0 +1,512 @@
+#include "sys.config.h"
+#include "sys.dir_snapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char snapshot_magic[8] = { 'S', 'Y', 'S', 'S', 'N', 'A', 'P', '\0' };
+static const std::uint32_t snapshot_version = 1;
+static const std::uint64_t no_index = static_cast<std::uint64_t>(-1);
+
+namespace
+{
+	struct file_stat
+	{
+		std::uint64_t dev;
+		std::uint64_t inode;
+		std::uint64_t size;
+		std::int64_t mtime;
+		std::int64_t ctime;
+		sys::file_type_t type;
+	};
+
+#if defined(SYS_WIN32)
+	bool stat_path(const std::string& name, file_stat& fs)
+	{
+		struct ::_stat64 st;
+		if (::_stat64(name.c_str(), &st) != 0)
+			return false;
+		fs.dev = static_cast<std::uint64_t>(st.st_dev);
+		fs.inode = static_cast<std::uint64_t>(st.st_ino);
+		fs.size = static_cast<std::uint64_t>(st.st_size);
+		fs.mtime = static_cast<std::int64_t>(st.st_mtime) * 1000000000;
+		fs.ctime = static_cast<std::int64_t>(st.st_ctime) * 1000000000;
+		fs.type = sys::dir::file_type(st.st_mode);
+		return true;
+	}
+#else
+	void convert(const struct stat& st, file_stat& fs)
+	{
+		fs.dev = static_cast<std::uint64_t>(st.st_dev);
+		fs.inode = static_cast<std::uint64_t>(st.st_ino);
+		fs.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+		fs.mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+		fs.ctime = st.st_ctimespec.tv_sec * 1000000000LL + st.st_ctimespec.tv_nsec;
+#else
+		fs.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+		fs.ctime = st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+#endif
+		fs.type = sys::dir::file_type(st.st_mode);
+	}
+#endif
+}
+
+struct sys::dir_snapshot::builder
+{
+	const dir_snapshot* previous;
+	std::vector<dir_change>* changes;
+	std::vector<dir_record> dirs;
+	std::vector<entry_record> entries;
+	std::string names;
+	std::string root;
+	std::string rel;
+	std::vector<dir_entry> batch;
+	bool stat_entries;
+	// from the first listing that failed part way
+	int error;
+
+	std::string_view name(const entry_record& e) const
+	{
+		return std::string_view(names.data() + e.name_offset, e.name_size);
+	}
+
+	std::string_view old_name(const entry_record& e) const
+	{
+		return std::string_view(previous->names_ + e.name_offset, e.name_size);
+	}
+
+	void change(change_type_t kind, file_type_t type, std::string_view name)
+	{
+		if (changes == nullptr)
+			return;
+		dir_change c;
+		c.kind = kind;
+		c.type = type;
+		c.path.reserve(rel.size() + name.size() + 1);
+		c.path.assign(rel);
+		if (!c.path.empty())
+			c.path += path::preferred_separator;
+		c.path.append(name);
+		changes->push_back(std::move(c));
+	}
+
+	std::uint64_t build(dir& d, const file_stat& st, std::uint64_t old_index);
+	std::uint64_t keep(std::uint64_t old_index);
+	void list(dir& d, std::uint64_t first);
+	void restat(dir& d, entry_record& e);
+	void diff(const dir_record& old, std::uint64_t first,
+		std::vector<std::uint64_t>& matches);
+};
+
+std::uint64_t sys::dir_snapshot::builder::build(sys::dir& d,
+	const file_stat& st, std::uint64_t old_index)
+{
+	const std::uint64_t index = dirs.size();
+	const std::uint64_t first = entries.size();
+	dirs.push_back({ st.dev, st.inode, st.mtime, st.ctime, first, 0 });
+
+	const dir_record* old = old_index == no_index ?
+		nullptr : &previous->dirs_[old_index];
+	std::vector<std::uint64_t> matches;
+
+	if (old != nullptr && old->dev == st.dev && old->inode == st.inode &&
+		old->mtime == st.mtime && old->ctime == st.ctime)
+	{
+		matches.reserve(static_cast<std::size_t>(old->entry_count));
+		for (std::uint64_t i = 0; i < old->entry_count; ++i)
+		{
+			entry_record e = previous->entries_[old->first_entry + i];
+			const std::string_view n(old_name(e));
+			e.name_offset = names.size();
+			e.child = no_index;
+			names.append(n);
+			if (stat_entries)
+				restat(d, e);
+			entries.push_back(e);
+			matches.push_back(old->first_entry + i);
+		}
+	}
+	else
+	{
+		list(d, first);
+		if (old != nullptr)
+			diff(*old, first, matches);
+		else
+		{
+			matches.assign(static_cast<std::size_t>(entries.size() - first), no_index);
+			for (std::uint64_t i = first; i < entries.size(); ++i)
+				change(entry_added, static_cast<file_type_t>(entries[i].type),
+					name(entries[i]));
+		}
+	}
+	dirs[index].entry_count = entries.size() - first;
+
+	const std::size_t rel_size = rel.size();
+	for (std::uint64_t i = first; i < first + dirs[index].entry_count; ++i)
+	{
+		if (entries[i].type != directory_file)
+			continue;
+
+		std::uint64_t old_child = no_index;
+		const std::uint64_t match = matches[static_cast<std::size_t>(i - first)];
+		if (match != no_index &&
+			previous->entries_[match].type == directory_file)
+			old_child = previous->entries_[match].child;
+
+		const std::string n(name(entries[i]));
+		if (!rel.empty())
+			rel += path::preferred_separator;
+		rel += n;
+
+		file_stat child_st;
+#if defined(SYS_WIN32)
+		const std::string full(root + path::preferred_separator + rel);
+		dir child(full.c_str(), d.default_buffer_size);
+		bool opened = child.is_open() && stat_path(full, child_st);
+#else
+		dir child(d.native_handle(), n.c_str(), false);
+		struct stat sb;
+		bool opened = child.is_open() &&
+			::fstat(child.native_handle(), &sb) == 0;
+		if (opened)
+			convert(sb, child_st);
+#endif
+		// one that cannot be opened now (EACCES, EMFILE) keeps what it
+		// had, rather than reading as emptied at the next rescan
+		if (opened)
+			entries[i].child = build(child, child_st, old_child);
+		else if (old_child != no_index)
+			entries[i].child = keep(old_child);
+		rel.resize(rel_size);
+	}
+	return index;
+}
+
+std::uint64_t sys::dir_snapshot::builder::keep(std::uint64_t old_index)
+{
+	const dir_record& old = previous->dirs_[old_index];
+	const std::uint64_t index = dirs.size();
+	const std::uint64_t first = entries.size();
+	dirs.push_back(old);
+	dirs[index].first_entry = first;
+	for (std::uint64_t i = 0; i < old.entry_count; ++i)
+	{
+		entry_record e = previous->entries_[old.first_entry + i];
+		const std::string_view n(old_name(e));
+		e.name_offset = names.size();
+		names.append(n);
+		entries.push_back(e);
+	}
+	for (std::uint64_t i = first; i < first + old.entry_count; ++i)
+	{
+		if (entries[i].child != no_index)
+		{
+			const std::uint64_t child = keep(entries[i].child);
+			entries[i].child = child;
+		}
+	}
+	return index;
+}
+
+void sys::dir_snapshot::builder::list(sys::dir& d, std::uint64_t first)
+{
+	std::size_t count;
+	while ((count = d.read_batch(batch)) > 0)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const dir_entry& de = batch[i];
+			file_stat st;
+#if defined(SYS_WIN32)
+			std::string full(root);
+			full += path::preferred_separator;
+			if (!rel.empty())
+			{
+				full += rel;
+				full += path::preferred_separator;
+			}
+			full.append(de.name, de.size);
+			if (!stat_path(full, st))
+				continue;
+#else
+			struct stat sb;
+			if (::fstatat(d.native_handle(), de.name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+				continue;
+			convert(sb, st);
+#endif
+			entry_record e;
+			e.inode = st.inode;
+			e.size = st.size;
+			e.mtime = st.mtime;
+			e.name_offset = names.size();
+			e.name_size = static_cast<std::uint32_t>(de.size);
+			e.type = static_cast<std::uint32_t>(st.type);
+			e.child = no_index;
+			names.append(de.name, de.size);
+			entries.push_back(e);
+		}
+	}
+	if (d.error() != 0 && error == 0)
+		error = d.error();
+
+	std::sort(entries.begin() + static_cast<std::ptrdiff_t>(first), entries.end(),
+		[this](const entry_record& lhs, const entry_record& rhs) {
+			return name(lhs) < name(rhs);
+		});
+}
+
+void sys::dir_snapshot::builder::restat(sys::dir& d, entry_record& e)
+{
+	const std::string n(name(e));
+	file_stat st;
+#if defined(SYS_WIN32)
+	(void)d;
+	std::string full(root);
+	full += path::preferred_separator;
+	if (!rel.empty())
+	{
+		full += rel;
+		full += path::preferred_separator;
+	}
+	full += n;
+	if (!stat_path(full, st))
+		return;
+#else
+	struct stat sb;
+	if (::fstatat(d.native_handle(), n.c_str(), &sb, AT_SYMLINK_NOFOLLOW) != 0)
+		return;
+	convert(sb, st);
+#endif
+	if (st.type != directory_file &&
+		(st.inode != e.inode || st.size != e.size || st.mtime != e.mtime))
+	{
+		e.inode = st.inode;
+		e.size = st.size;
+		e.mtime = st.mtime;
+		e.type = static_cast<std::uint32_t>(st.type);
+		change(entry_modified, st.type, n);
+	}
+}
+
+void sys::dir_snapshot::builder::diff(const dir_record& old,
+	std::uint64_t first, std::vector<std::uint64_t>& matches)
+{
+	std::uint64_t i = first;
+	std::uint64_t j = old.first_entry;
+	const std::uint64_t last = entries.size();
+	const std::uint64_t old_last = old.first_entry + old.entry_count;
+
+	matches.reserve(static_cast<std::size_t>(last - first));
+	while (i < last || j < old_last)
+	{
+		const entry_record* e = i < last ? &entries[i] : nullptr;
+		const entry_record* o = j < old_last ? &previous->entries_[j] : nullptr;
+		const int cmp = e == nullptr ? 1 : o == nullptr ? -1 :
+			name(*e).compare(old_name(*o));
+
+		if (cmp < 0)
+		{
+			change(entry_added, static_cast<file_type_t>(e->type), name(*e));
+			matches.push_back(no_index);
+			++i;
+		}
+		else if (cmp > 0)
+		{
+			change(entry_removed, static_cast<file_type_t>(o->type), old_name(*o));
+			if (o->type == directory_file && o->child != no_index &&
+				changes != nullptr)
+			{
+				const std::size_t rel_size = rel.size();
+				if (!rel.empty())
+					rel += path::preferred_separator;
+				rel.append(old_name(*o));
+				previous->removed(o->child, rel, *changes);
+				rel.resize(rel_size);
+			}
+			++j;
+		}
+		else
+		{
+			if (e->type != o->type || e->inode != o->inode ||
+				(e->type != directory_file &&
+					(e->size != o->size || e->mtime != o->mtime)))
+				change(entry_modified, static_cast<file_type_t>(e->type), name(*e));
+			matches.push_back(j);
+			++i;
+			++j;
+		}
+	}
+}
+
+sys::dir_snapshot::dir_snapshot(void)
+	: header_(nullptr)
+	, dirs_(nullptr)
+	, entries_(nullptr)
+	, names_(nullptr)
+{
+}
+
+sys::dir_snapshot::~dir_snapshot(void)
+{
+}
+
+bool sys::dir_snapshot::scan(const sys::path& root)
+{
+	return build(root, nullptr, false);
+}
+
+bool sys::dir_snapshot::rescan(const sys::path& root,
+	std::vector<sys::dir_change>& changes, bool stat_entries)
+{
+	return build(root, &changes, stat_entries);
+}
+
+bool sys::dir_snapshot::build(const sys::path& root,
+	std::vector<sys::dir_change>* changes, bool stat_entries)
+{
+	builder b;
+	b.previous = this;
+	b.changes = changes;
+	b.stat_entries = stat_entries;
+	b.error = 0;
+	b.root.assign(root.native());
+	b.batch.resize(256);
+
+	file_stat st;
+#if defined(SYS_WIN32)
+	dir d(b.root.c_str());
+	if (!d.is_open() || !stat_path(b.root, st))
+		return false;
+#else
+	dir d(AT_FDCWD, b.root.c_str(), true);
+	struct stat sb;
+	if (!d.is_open() || ::fstat(d.native_handle(), &sb) != 0)
+		return false;
+	convert(sb, st);
+#endif
+
+	b.build(d, st, (changes != nullptr && !empty()) ? 0 : no_index);
+	// a truncated listing would read as deleted entries
+	if (b.error != 0)
+	{
+		errno = b.error;
+		return false;
+	}
+
+	std::vector<char> data(sizeof(header) +
+		b.dirs.size() * sizeof(dir_record) +
+		b.entries.size() * sizeof(entry_record) + b.names.size());
+	header h;
+	std::memcpy(h.magic, snapshot_magic, sizeof(h.magic));
+	h.version = snapshot_version;
+	h.reserved = 0;
+	h.dir_count = b.dirs.size();
+	h.entry_count = b.entries.size();
+	h.names_size = b.names.size();
+
+	char* p = data.data();
+	std::memcpy(p, &h, sizeof(h));
+	p += sizeof(h);
+	std::memcpy(p, b.dirs.data(), b.dirs.size() * sizeof(dir_record));
+	p += b.dirs.size() * sizeof(dir_record);
+	std::memcpy(p, b.entries.data(), b.entries.size() * sizeof(entry_record));
+	p += b.entries.size() * sizeof(entry_record);
+	std::memcpy(p, b.names.data(), b.names.size());
+
+	map_.close();
+	data_.swap(data);
+	return attach(data_.data(), data_.size());
+}
+
+bool sys::dir_snapshot::load(const sys::path& name)
+{
+	data_.clear();
+	map_.close();
+	if (!map_.open(name) || !attach(map_.data(), map_.size()))
+	{
+		map_.close();
+		return false;
+	}
+	return true;
+}
+
+bool sys::dir_snapshot::save(const sys::path& name) const
+{
+	if (empty())
+		return false;
+	const std::size_t size = sizeof(header) +
+		header_->dir_count * sizeof(dir_record) +
+		header_->entry_count * sizeof(entry_record) + header_->names_size;
+	std::ofstream ofs(name.c_str(), std::ios::binary | std::ios::trunc);
+	ofs.write(reinterpret_cast<const char*>(header_),
+		static_cast<std::streamsize>(size));
+	return ofs.good();
+}
+
+bool sys::dir_snapshot::empty(void) const
+{
+	return header_ == nullptr || header_->dir_count == 0;
+}
+
+std::size_t sys::dir_snapshot::directories(void) const
+{
+	return header_ ? static_cast<std::size_t>(header_->dir_count) : 0;
+}
+
+std::size_t sys::dir_snapshot::entries(void) const
+{
+	return header_ ? static_cast<std::size_t>(header_->entry_count) : 0;
+}
+
+bool sys::dir_snapshot::attach(const char* data, std::size_t size)
+{
+	header_ = nullptr;
+	dirs_ = nullptr;
+	entries_ = nullptr;
+	names_ = nullptr;
+	if (size < sizeof(header))
+		return false;
+
+	const header* h = reinterpret_cast<const header*>(data);
+	if (std::memcmp(h->magic, snapshot_magic, sizeof(h->magic)) != 0 ||
+		h->version != snapshot_version)
+		return false;
+	if (h->dir_count > size / sizeof(dir_record) ||
+		h->entry_count > size / sizeof(entry_record) ||
+		sizeof(header) + h->dir_count * sizeof(dir_record) +
+			h->entry_count * sizeof(entry_record) + h->names_size != size)
+		return false;
+
+	header_ = h;
+	dirs_ = reinterpret_cast<const dir_record*>(data + sizeof(header));
+	entries_ = reinterpret_cast<const entry_record*>(dirs_ + h->dir_count);
+	names_ = reinterpret_cast<const char*>(entries_ + h->entry_count);
+	return true;
+}
+
+void sys::dir_snapshot::removed(std::uint64_t index, std::string& rel,
+	std::vector<sys::dir_change>& changes) const
+{
+	const dir_record& d = dirs_[index];
+	const std::size_t rel_size = rel.size();
+	for (std::uint64_t i = d.first_entry; i < d.first_entry + d.entry_count; ++i)
+	{
+		const entry_record& e = entries_[i];
+		rel += path::preferred_separator;
+		rel.append(names_ + e.name_offset, e.name_size);
+		changes.push_back({ entry_removed, static_cast<file_type_t>(e.type), rel });
+		if (e.type == directory_file && e.child != no_index)
+			removed(e.child, rel, changes);
+		rel.resize(rel_size);
+	}
+}
\ No newline at end of file
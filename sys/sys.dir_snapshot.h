@@ -0,0 +1,93 @@
+#ifndef __SYS_DIR_SNAPSHOT__
+#define __SYS_DIR_SNAPSHOT__
+
+#include "sys.config.h"
+#include "sys.dir.h"
+#include "sys.mapped_file.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sys
+{
+	typedef enum
+	{
+		entry_added, entry_removed, entry_modified
+	} change_type_t;
+
+	struct dir_change
+	{
+		change_type_t kind;
+		file_type_t type;
+		std::string path;
+	};
+
+	class dir_snapshot : public noncopyable
+	{
+		struct header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t reserved;
+			std::uint64_t dir_count;
+			std::uint64_t entry_count;
+			std::uint64_t names_size;
+		};
+
+		struct dir_record
+		{
+			std::uint64_t dev;
+			std::uint64_t inode;
+			std::int64_t mtime;
+			std::int64_t ctime;
+			std::uint64_t first_entry;
+			std::uint64_t entry_count;
+		};
+
+		struct entry_record
+		{
+			std::uint64_t inode;
+			std::uint64_t size;
+			std::int64_t mtime;
+			std::uint64_t name_offset;
+			std::uint32_t name_size;
+			std::uint32_t type;
+			std::uint64_t child;
+		};
+
+		struct builder;
+	private:
+		std::vector<char> data_;
+		mapped_file map_;
+		const header* header_;
+		const dir_record* dirs_;
+		const entry_record* entries_;
+		const char* names_;
+	public:
+		dir_snapshot(void);
+		virtual ~dir_snapshot(void);
+	public:
+		bool scan(const path& root);
+		bool rescan(const path& root, std::vector<dir_change>& changes,
+			bool stat_entries = false);
+	public:
+		bool load(const path& name);
+		bool save(const path& name) const;
+	public:
+		bool empty(void) const;
+		std::size_t directories(void) const;
+		std::size_t entries(void) const;
+	private:
+		bool build(const path& root, std::vector<dir_change>* changes,
+			bool stat_entries);
+		bool attach(const char* data, std::size_t size);
+		void removed(std::uint64_t index, std::string& rel,
+			std::vector<dir_change>& changes) const;
+	};
+}
+
+#endif
+
@@ -0,0 +1,341 @@
+#include "sys.config.h"
+#include "sys.disk_usage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#endif
+
+static const std::size_t disk_usage_shards = 64;
+
+namespace
+{
+	struct usage
+	{
+		std::uintmax_t apparent_size = 0;
+		std::uintmax_t allocated_size = 0;
+		std::uintmax_t files = 0;
+		std::uintmax_t directories = 0;
+
+		void add(const usage& u)
+		{
+			apparent_size += u.apparent_size;
+			allocated_size += u.allocated_size;
+			files += u.files;
+			directories += u.directories;
+		}
+	};
+
+	struct file_info
+	{
+		std::uint64_t dev = 0;
+		std::uint64_t inode = 0;
+		std::uint64_t nlink = 1;
+		std::uint64_t size = 0;
+		std::uint64_t allocated = 0;
+	};
+
+	struct inode_key
+	{
+		std::uint64_t dev;
+		std::uint64_t inode;
+
+		bool operator==(const inode_key& other) const
+		{
+			return dev == other.dev && inode == other.inode;
+		}
+	};
+
+	struct inode_hash
+	{
+		std::size_t operator()(const inode_key& key) const
+		{
+			return static_cast<std::size_t>(
+				(key.inode ^ (key.dev * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull);
+		}
+	};
+
+	bool stat_file(int dirfd, const char* name, bool follow, file_info& info)
+	{
+#if defined(SYS_WIN32)
+		(void)dirfd;
+		(void)follow;
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!::GetFileAttributesExA(name, GetFileExInfoStandard, &data))
+		{
+			errno = ENOENT;
+			return false;
+		}
+		info.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) |
+			data.nFileSizeLow;
+		info.allocated = info.size;
+#elif defined(SYS_HAVE_STATX)
+		struct statx stx;
+		unsigned mask = STATX_SIZE | STATX_BLOCKS | STATX_NLINK;
+		if (follow)
+			mask |= STATX_INO;
+		const int flags = AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC |
+			(follow ? 0 : AT_SYMLINK_NOFOLLOW);
+		if (::statx(dirfd, name, flags, mask, &stx) != 0)
+			return false;
+		info.dev = (static_cast<std::uint64_t>(stx.stx_dev_major) << 32) |
+			stx.stx_dev_minor;
+		if (stx.stx_mask & STATX_INO)
+			info.inode = stx.stx_ino;
+		if (stx.stx_mask & STATX_NLINK)
+			info.nlink = stx.stx_nlink;
+		info.size = stx.stx_size;
+		info.allocated = stx.stx_blocks * 512;
+#else
+		struct stat st;
+		if (::fstatat(dirfd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+			return false;
+		info.dev = static_cast<std::uint64_t>(st.st_dev);
+		info.inode = static_cast<std::uint64_t>(st.st_ino);
+		info.nlink = static_cast<std::uint64_t>(st.st_nlink);
+		info.size = static_cast<std::uint64_t>(st.st_size);
+		info.allocated = static_cast<std::uint64_t>(st.st_blocks) * 512;
+#endif
+		return true;
+	}
+
+	class usage_visitor : public sys::walk_visitor
+	{
+		struct alignas(64) worker
+		{
+			std::unordered_map<std::string, usage> totals;
+			std::string key;
+			usage* last = nullptr;
+		};
+
+		struct alignas(64) shard
+		{
+			std::mutex mutex;
+			std::unordered_set<inode_key, inode_hash> inodes;
+		};
+
+		std::size_t root_size_;
+		std::size_t rollup_depth_;
+		bool follow_;
+		std::vector<worker> workers_;
+		std::vector<shard> shards_;
+		std::atomic<int> error_;
+	public:
+		usage_visitor(std::size_t root_size, const sys::disk_usage_options& options,
+			std::size_t workers)
+			: root_size_(root_size)
+			, rollup_depth_(options.rollup_depth)
+			, follow_(options.follow_symlinks)
+			, workers_(workers)
+			, shards_(disk_usage_shards)
+			, error_(0)
+		{
+		}
+
+		sys::walk_action_t visit(const sys::walk_entry& entry,
+			std::size_t index) override
+		{
+#if defined(SYS_WIN32)
+			const char* name = entry.path;
+#else
+			const char* name = entry.dirfd == AT_FDCWD ?
+				entry.path : entry.path + entry.name_pos;
+#endif
+			file_info info;
+			if (!follow_)
+				info.inode = entry.inode;
+			if (!stat_file(entry.dirfd, name, follow_, info))
+			{
+				set_error(errno);
+				return sys::walk_continue;
+			}
+
+			const bool directory = entry.type == sys::directory_file;
+			if (!directory && info.nlink > 1 && !first_link(info))
+				return sys::walk_continue;
+
+			const char* rel = entry.path + root_size_;
+			const char* end = entry.path + entry.size;
+			if (rel < end && std::strchr(sys::path::separators, *rel))
+				++rel;
+			std::size_t components = directory ? entry.depth : entry.depth - 1;
+			components = std::min(components, rollup_depth_);
+			const char* stop = rel;
+			for (std::size_t i = 0; i < components; ++i)
+			{
+				if (i != 0)
+					++stop;
+				while (stop < end && !std::strchr(sys::path::separators, *stop))
+					++stop;
+			}
+
+			worker& w = workers_[index];
+			const std::string_view key(rel, static_cast<std::size_t>(stop - rel));
+			if (w.last == nullptr || key != w.key)
+			{
+				w.key.assign(key);
+				w.last = &w.totals[w.key];
+			}
+			w.last->apparent_size += info.size;
+			w.last->allocated_size += info.allocated;
+			if (directory)
+				++w.last->directories;
+			else
+				++w.last->files;
+			return sys::walk_continue;
+		}
+
+		void add_root(const file_info& info)
+		{
+			usage& u = workers_.front().totals[std::string()];
+			u.apparent_size += info.size;
+			u.allocated_size += info.allocated;
+			++u.directories;
+		}
+
+		void merge(std::unordered_map<std::string, usage>& result)
+		{
+			for (worker& w : workers_)
+			{
+				for (auto& total : w.totals)
+					result[total.first].add(total.second);
+				w.totals.clear();
+				w.last = nullptr;
+			}
+		}
+
+		void set_error(int err)
+		{
+			int expected = 0;
+			error_.compare_exchange_strong(expected, err);
+		}
+
+		int error(void) const
+		{
+			return error_.load();
+		}
+	private:
+		bool first_link(const file_info& info)
+		{
+			const inode_key key = { info.dev, info.inode };
+			shard& s = shards_[inode_hash()(key) % shards_.size()];
+			std::lock_guard<std::mutex> guard(s.mutex);
+			return s.inodes.insert(key).second;
+		}
+	};
+
+	struct tree_node
+	{
+		std::string name;
+		std::size_t parent;
+		usage total;
+		std::vector<std::size_t> children;
+	};
+
+	std::size_t find_node(std::vector<tree_node>& nodes,
+		std::unordered_map<std::string, std::size_t>& index, const std::string& key)
+	{
+		const auto it = index.find(key);
+		if (it != index.end())
+			return it->second;
+
+		std::size_t pos = key.size();
+		while (pos > 0 && !std::strchr(sys::path::separators, key[pos - 1]))
+			--pos;
+		const std::size_t parent = find_node(nodes, index,
+			key.substr(0, pos > 0 ? pos - 1 : 0));
+
+		const std::size_t id = nodes.size();
+		nodes.push_back({ key.substr(pos), parent, usage(), {} });
+		nodes[parent].children.push_back(id);
+		index.emplace(key, id);
+		return id;
+	}
+
+	void build_tree(std::vector<tree_node>& nodes, std::size_t id,
+		sys::disk_usage_node& result)
+	{
+		tree_node& n = nodes[id];
+		result.name = std::move(n.name);
+		result.apparent_size = n.total.apparent_size;
+		result.allocated_size = n.total.allocated_size;
+		result.files = n.total.files;
+		result.directories = n.total.directories;
+		std::sort(n.children.begin(), n.children.end(),
+			[&nodes](std::size_t a, std::size_t b) {
+				return nodes[a].name < nodes[b].name;
+			});
+		result.children.resize(n.children.size());
+		for (std::size_t i = 0; i < n.children.size(); ++i)
+			build_tree(nodes, n.children[i], result.children[i]);
+	}
+}
+
+sys::disk_usage_node sys::disk_usage(const sys::path& root,
+	sys::thread_group& group, int& error)
+{
+	return disk_usage(root, group, disk_usage_options(), error);
+}
+
+sys::disk_usage_node sys::disk_usage(const sys::path& root,
+	sys::thread_group& group, const sys::disk_usage_options& options, int& error)
+{
+	error = 0;
+	disk_usage_node result;
+
+	std::string root_name(root.native());
+	while (root_name.size() > 1 &&
+			std::strchr(path::separators, root_name.back()))
+		root_name.pop_back();
+
+	file_info info;
+	if (!stat_file(AT_FDCWD, root_name.c_str(), true, info))
+	{
+		error = errno;
+		return result;
+	}
+	// info came from following a symlinked root, so the type must too
+	if (root.target_status() != directory_file)
+	{
+		result.name = root_name;
+		result.apparent_size = info.size;
+		result.allocated_size = info.allocated;
+		result.files = 1;
+		return result;
+	}
+
+	disk_usage_options walk_options(options);
+	walk_options.order = walk_pre_order;
+	if (walk_options.threads == 0)
+		walk_options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+	usage_visitor visitor(root_name.size(), walk_options, walk_options.threads);
+	visitor.add_root(info);
+	parallel_walker w(root_name, walk_options);
+	w.walk(group, visitor);
+	error = visitor.error() != 0 ? visitor.error() : w.error();
+
+	std::unordered_map<std::string, usage> totals;
+	visitor.merge(totals);
+
+	std::vector<tree_node> nodes;
+	std::unordered_map<std::string, std::size_t> index;
+	nodes.push_back({ root_name, 0, usage(), {} });
+	index.emplace(std::string(), 0);
+	for (const auto& total : totals)
+		nodes[find_node(nodes, index, total.first)].total.add(total.second);
+	for (std::size_t id = nodes.size() - 1; id > 0; --id)
+		nodes[nodes[id].parent].total.add(nodes[id].total);
+
+	build_tree(nodes, 0, result);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef __SYS_DISK_USAGE__
+#define __SYS_DISK_USAGE__
+
+#include "sys.config.h"
+#include "sys.parallel_walker.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sys
+{
+	// usage below rollup_depth is folded into the ancestor at that depth;
+	// the whole tree is still scanned unless max_depth says otherwise
+	struct disk_usage_options : public parallel_walk_options
+	{
+		std::size_t rollup_depth = static_cast<std::size_t>(-1);
+	};
+
+	struct disk_usage_node
+	{
+		std::string name;
+		std::uintmax_t apparent_size = 0;
+		std::uintmax_t allocated_size = 0;
+		std::uintmax_t files = 0;
+		std::uintmax_t directories = 0;
+		std::vector<disk_usage_node> children;
+	};
+
+	disk_usage_node disk_usage(const path& root, thread_group& group, int& error);
+	disk_usage_node disk_usage(const path& root, thread_group& group,
+		const disk_usage_options& options, int& error);
+}
+
+#endif
+
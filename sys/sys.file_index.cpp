@@ -0,0 +1,762 @@
+#include "sys.config.h"
+#include "sys.file_index.h"
+#include "sys.dir.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char index_magic[8] = { 'S', 'Y', 'S', 'F', 'I', 'D', 'X', '\0' };
+static const std::uint32_t index_version = 1;
+static const std::uint64_t no_index = static_cast<std::uint64_t>(-1);
+static const std::size_t index_block_entries = 16;
+
+namespace
+{
+	void put_varint(std::string& out, std::uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += static_cast<char>(value);
+	}
+
+	std::uint64_t get_varint(const unsigned char*& p)
+	{
+		std::uint64_t value = 0;
+		for (unsigned shift = 0;; shift += 7)
+		{
+			const unsigned char c = *p++;
+			value |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+			if ((c & 0x80) == 0)
+				return value;
+		}
+	}
+
+	std::uint32_t trigram(const char* s)
+	{
+		return (static_cast<std::uint32_t>(static_cast<unsigned char>(s[0])) << 16) |
+			(static_cast<std::uint32_t>(static_cast<unsigned char>(s[1])) << 8) |
+			static_cast<std::uint32_t>(static_cast<unsigned char>(s[2]));
+	}
+
+	bool match_char(const char*& p, const char* pe, char c)
+	{
+		const unsigned char uc = static_cast<unsigned char>(c);
+		if (*p == '?')
+		{
+			++p;
+			return true;
+		}
+		if (*p == '[')
+		{
+			const char* q = p + 1;
+			bool negate = false;
+			if (q < pe && (*q == '!' || *q == '^'))
+			{
+				negate = true;
+				++q;
+			}
+			bool matched = false;
+			for (bool first = true; q < pe && (first || *q != ']'); first = false)
+			{
+				const unsigned char lo = static_cast<unsigned char>(*q++);
+				unsigned char hi = lo;
+				if (q + 1 < pe && *q == '-' && q[1] != ']')
+				{
+					hi = static_cast<unsigned char>(q[1]);
+					q += 2;
+				}
+				if (uc >= lo && uc <= hi)
+					matched = true;
+			}
+			if (q < pe)
+			{
+				p = q + 1;
+				return matched != negate;
+			}
+		}
+		else if (*p == '\\' && p + 1 < pe)
+			++p;
+		if (*p != c)
+			return false;
+		++p;
+		return true;
+	}
+
+	bool glob_match(const std::string& pattern, std::string_view name)
+	{
+		const char* p = pattern.data();
+		const char* pe = p + pattern.size();
+		const char* s = name.data();
+		const char* se = s + name.size();
+		const char* star = nullptr;
+		const char* resume = nullptr;
+		while (s < se)
+		{
+			if (p < pe && *p == '*')
+			{
+				star = ++p;
+				resume = s;
+				continue;
+			}
+			if (p < pe && match_char(p, pe, *s))
+			{
+				++s;
+				continue;
+			}
+			if (star == nullptr)
+				return false;
+			p = star;
+			s = ++resume;
+		}
+		while (p < pe && *p == '*')
+			++p;
+		return p == pe;
+	}
+
+	void glob_literals(const std::string& pattern, std::vector<std::string>& literals)
+	{
+		std::string run;
+		for (std::size_t i = 0; i < pattern.size(); ++i)
+		{
+			char c = pattern[i];
+			if (c == '[')
+			{
+				std::size_t j = i + 1;
+				if (j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^'))
+					++j;
+				if (j < pattern.size() && pattern[j] == ']')
+					++j;
+				while (j < pattern.size() && pattern[j] != ']')
+					++j;
+				if (j < pattern.size())
+				{
+					literals.push_back(std::move(run));
+					run.clear();
+					i = j;
+					continue;
+				}
+			}
+			else if (c == '*' || c == '?')
+			{
+				literals.push_back(std::move(run));
+				run.clear();
+				continue;
+			}
+			else if (c == '\\' && i + 1 < pattern.size())
+				c = pattern[++i];
+			run += c;
+		}
+		literals.push_back(std::move(run));
+	}
+
+	bool stat_dir(sys::dir& d, const char* full, std::uint64_t& dev,
+		std::uint64_t& inode, std::int64_t& mtime)
+	{
+#if defined(SYS_WIN32)
+		(void)d;
+		struct ::_stat64 st;
+		if (::_stat64(full, &st) != 0)
+			return false;
+		dev = static_cast<std::uint64_t>(st.st_dev);
+		inode = static_cast<std::uint64_t>(st.st_ino);
+		mtime = static_cast<std::int64_t>(std::max(st.st_mtime, st.st_ctime)) * 1000000000;
+#else
+		(void)full;
+		struct stat st;
+		if (::fstat(d.native_handle(), &st) != 0)
+			return false;
+		dev = static_cast<std::uint64_t>(st.st_dev);
+		inode = static_cast<std::uint64_t>(st.st_ino);
+#if defined(__APPLE__)
+		mtime = std::max(
+			st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec,
+			st.st_ctimespec.tv_sec * 1000000000LL + st.st_ctimespec.tv_nsec);
+#else
+		mtime = std::max(st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec,
+			st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec);
+#endif
+#endif
+		return true;
+	}
+}
+
+template<class Function>
+void sys::file_index::decode(std::size_t block, Function f) const
+{
+	const std::size_t count = block_size(block);
+	const unsigned char* p = names_ + blocks_[block].offset;
+	std::string name;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const file_type_t type = static_cast<file_type_t>(*p++);
+		const std::size_t prefix = static_cast<std::size_t>(get_varint(p));
+		const std::size_t suffix = static_cast<std::size_t>(get_varint(p));
+		name.resize(prefix);
+		name.append(reinterpret_cast<const char*>(p), suffix);
+		p += suffix;
+		f(static_cast<std::uint32_t>(blocks_[block].first_entry + i),
+			std::string_view(name), type);
+	}
+}
+
+struct sys::file_index::builder : public walk_visitor
+{
+	struct scan_result
+	{
+		std::string rel;
+		std::uint64_t dev;
+		std::uint64_t inode;
+		std::int64_t mtime;
+		std::vector<std::string> names;
+		std::vector<std::uint8_t> types;
+	};
+
+	struct alignas(64) worker
+	{
+		std::vector<scan_result> results;
+		// names came from the previous index, so visit() has nothing to add
+		bool replayed = false;
+	};
+
+	const file_index* previous;
+	std::string root;
+	std::unordered_map<std::string, std::uint64_t> old_dirs;
+	std::vector<worker> workers;
+	// from the first listing that failed part way
+	std::atomic<int> error;
+
+	builder(void)
+		: previous(nullptr)
+		, error(0)
+	{
+	}
+
+	std::string_view relative(const walk_entry& entry) const
+	{
+		const char* rel = entry.path + std::min(root.size(), entry.size);
+		const char* end = entry.path + entry.size;
+		if (rel < end && std::strchr(path::separators, *rel))
+			++rel;
+		return std::string_view(rel, static_cast<std::size_t>(end - rel));
+	}
+
+	void enter(const walk_entry& entry, dir& d, std::vector<dir_entry>& listing,
+		std::size_t index) override;
+
+	void leave(const walk_entry&, int err, std::size_t index) override
+	{
+		// an incomplete directory would be kept as is by the next refresh
+		int expected = 0;
+		if (err != 0)
+			error.compare_exchange_strong(expected, err);
+		workers[index].replayed = false;
+	}
+
+	walk_action_t visit(const walk_entry& entry, std::size_t index) override
+	{
+		worker& w = workers[index];
+		if (w.results.empty() || w.replayed)
+			return walk_continue;
+		scan_result& r = w.results.back();
+		r.names.emplace_back(entry.path + entry.name_pos, entry.size - entry.name_pos);
+		r.types.push_back(static_cast<std::uint8_t>(entry.type));
+		return walk_continue;
+	}
+};
+
+void sys::file_index::builder::enter(const sys::walk_entry& entry, sys::dir& d,
+	std::vector<sys::dir_entry>& listing, std::size_t index)
+{
+	worker& w = workers[index];
+	scan_result r;
+	if (!stat_dir(d, entry.path, r.dev, r.inode, r.mtime))
+	{
+		// visit() still needs somewhere to put the names
+		r.dev = 0;
+		r.inode = 0;
+		r.mtime = 0;
+	}
+	r.rel.assign(relative(entry));
+	w.results.push_back(std::move(r));
+	scan_result& result = w.results.back();
+
+	const auto old = old_dirs.find(result.rel);
+	const dir_record* o = old == old_dirs.end() ?
+		nullptr : &previous->dirs_[old->second];
+	if (o == nullptr || result.mtime == 0 || o->dev != result.dev ||
+			o->inode != result.inode || o->mtime != result.mtime)
+		return;
+
+	// an unchanged directory is walked from the old names instead of read
+	result.names.reserve(o->entry_count);
+	result.types.reserve(o->entry_count);
+	for (std::uint32_t b = o->first_block; b < o->first_block + o->block_count; ++b)
+	{
+		previous->decode(b, [&result](std::uint32_t, std::string_view name,
+				file_type_t type) {
+			result.names.emplace_back(name);
+			result.types.push_back(static_cast<std::uint8_t>(type));
+		});
+	}
+	listing.reserve(result.names.size());
+	for (std::size_t i = 0; i < result.names.size(); ++i)
+		listing.push_back({ result.names[i].c_str(), result.names[i].size(), 0,
+			static_cast<file_type_t>(result.types[i]) });
+	w.replayed = true;
+}
+
+sys::file_index::file_index(void)
+	: header_(nullptr)
+	, dirs_(nullptr)
+	, blocks_(nullptr)
+	, grams_(nullptr)
+	, postings_(nullptr)
+	, dirnames_(nullptr)
+	, names_(nullptr)
+{
+}
+
+sys::file_index::~file_index(void)
+{
+}
+
+bool sys::file_index::build(const sys::path& root, sys::thread_group& group)
+{
+	return rebuild(root, group, parallel_walk_options(), false);
+}
+
+bool sys::file_index::build(const sys::path& root, sys::thread_group& group,
+	const sys::parallel_walk_options& options)
+{
+	return rebuild(root, group, options, false);
+}
+
+bool sys::file_index::update(const sys::path& root, sys::thread_group& group)
+{
+	return rebuild(root, group, parallel_walk_options(), true);
+}
+
+bool sys::file_index::update(const sys::path& root, sys::thread_group& group,
+	const sys::parallel_walk_options& options)
+{
+	return rebuild(root, group, options, true);
+}
+
+bool sys::file_index::rebuild(const sys::path& root, sys::thread_group& group,
+	const sys::parallel_walk_options& options, bool incremental)
+{
+	builder b;
+	b.previous = this;
+	b.root.assign(root.native());
+	while (b.root.size() > 1 && std::strchr(path::separators, b.root.back()))
+		b.root.pop_back();
+
+	if (incremental && !empty() &&
+		std::string_view(dirnames_ + dirs_[0].name_offset, dirs_[0].name_size) == b.root)
+	{
+		std::vector<std::string> rels(static_cast<std::size_t>(header_->dir_count));
+		for (std::size_t i = 1; i < rels.size(); ++i)
+		{
+			const dir_record& d = dirs_[i];
+			rels[i] = rels[static_cast<std::size_t>(d.parent)];
+			if (!rels[i].empty())
+				rels[i] += path::preferred_separator;
+			rels[i].append(dirnames_ + d.name_offset, d.name_size);
+			b.old_dirs.emplace(rels[i], i);
+		}
+		b.old_dirs.emplace(std::string(), 0);
+	}
+
+	parallel_walk_options walk_options(options);
+	walk_options.order = walk_pre_order;
+	if (walk_options.threads == 0)
+		walk_options.threads = std::max(1u, std::thread::hardware_concurrency());
+	b.workers.resize(walk_options.threads);
+	parallel_walker w(b.root, walk_options);
+	w.walk(group, b);
+	if (b.error.load() != 0)
+	{
+		errno = b.error.load();
+		return false;
+	}
+
+	std::vector<builder::scan_result*> scanned;
+	for (auto& worker : b.workers)
+		for (auto& r : worker.results)
+			scanned.push_back(&r);
+	if (scanned.empty())
+	{
+		errno = w.error() != 0 ? w.error() : ENOENT;
+		return false;
+	}
+	std::sort(scanned.begin(), scanned.end(),
+		[](const builder::scan_result* lhs, const builder::scan_result* rhs) {
+			return lhs->rel < rhs->rel;
+		});
+	if (!scanned.front()->rel.empty())
+		return false;
+
+	std::vector<dir_record> dirs;
+	std::vector<block_record> blocks;
+	std::vector<std::uint64_t> grams;
+	std::string dirnames;
+	std::string names;
+	std::unordered_map<std::string_view, std::uint64_t> ids;
+	std::vector<std::size_t> order;
+	std::uint32_t entry = 0;
+
+	for (builder::scan_result* r : scanned)
+	{
+		const std::uint64_t id = dirs.size();
+		ids.emplace(r->rel, id);
+
+		dir_record d;
+		std::string_view name(b.root);
+		d.parent = no_index;
+		if (id != 0)
+		{
+			std::size_t pos = r->rel.size();
+			while (pos > 0 && !std::strchr(path::separators, r->rel[pos - 1]))
+				--pos;
+			const auto parent = ids.find(std::string_view(r->rel.data(),
+				pos > 0 ? pos - 1 : 0));
+			d.parent = parent == ids.end() ? 0 : parent->second;
+			name = std::string_view(r->rel).substr(pos);
+		}
+		d.dev = r->dev;
+		d.inode = r->inode;
+		d.mtime = r->mtime;
+		d.name_offset = dirnames.size();
+		d.name_size = static_cast<std::uint32_t>(name.size());
+		d.first_block = static_cast<std::uint32_t>(blocks.size());
+		d.entry_count = static_cast<std::uint32_t>(r->names.size());
+		dirnames.append(name);
+
+		order.resize(r->names.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [r](std::size_t lhs, std::size_t rhs) {
+			return r->names[lhs] < r->names[rhs];
+		});
+
+		const std::string* prev = nullptr;
+		for (std::size_t i = 0; i < order.size(); ++i, ++entry)
+		{
+			const std::string& n = r->names[order[i]];
+			std::size_t prefix = 0;
+			if (i % index_block_entries == 0)
+				blocks.push_back({ names.size(), entry, static_cast<std::uint32_t>(id) });
+			else
+				while (prefix < n.size() && prefix < prev->size() &&
+						n[prefix] == (*prev)[prefix])
+					++prefix;
+			names += static_cast<char>(r->types[order[i]]);
+			put_varint(names, prefix);
+			put_varint(names, n.size() - prefix);
+			names.append(n, prefix, std::string::npos);
+			prev = &n;
+
+			for (std::size_t j = 0; j + 3 <= n.size(); ++j)
+				grams.push_back((static_cast<std::uint64_t>(trigram(n.data() + j)) << 32) |
+					entry);
+		}
+		d.block_count = static_cast<std::uint32_t>(blocks.size() - d.first_block);
+		dirs.push_back(d);
+	}
+
+	std::sort(grams.begin(), grams.end());
+	grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+	std::vector<gram_record> records;
+	std::string postings;
+	for (std::size_t i = 0; i < grams.size(); )
+	{
+		const std::uint32_t gram = static_cast<std::uint32_t>(grams[i] >> 32);
+		gram_record g = { gram, 0, postings.size() };
+		for (std::uint32_t last = 0; i < grams.size() &&
+				static_cast<std::uint32_t>(grams[i] >> 32) == gram; ++i, ++g.count)
+		{
+			const std::uint32_t id = static_cast<std::uint32_t>(grams[i]);
+			put_varint(postings, id - last);
+			last = id;
+		}
+		records.push_back(g);
+	}
+
+	std::vector<char> data(sizeof(header) +
+		dirs.size() * sizeof(dir_record) +
+		blocks.size() * sizeof(block_record) +
+		records.size() * sizeof(gram_record) +
+		postings.size() + dirnames.size() + names.size());
+	header h;
+	std::memcpy(h.magic, index_magic, sizeof(h.magic));
+	h.version = index_version;
+	h.reserved = 0;
+	h.dir_count = dirs.size();
+	h.entry_count = entry;
+	h.block_count = blocks.size();
+	h.gram_count = records.size();
+	h.postings_size = postings.size();
+	h.dirnames_size = dirnames.size();
+	h.names_size = names.size();
+
+	char* p = data.data();
+	std::memcpy(p, &h, sizeof(h));
+	p += sizeof(h);
+	std::memcpy(p, dirs.data(), dirs.size() * sizeof(dir_record));
+	p += dirs.size() * sizeof(dir_record);
+	std::memcpy(p, blocks.data(), blocks.size() * sizeof(block_record));
+	p += blocks.size() * sizeof(block_record);
+	std::memcpy(p, records.data(), records.size() * sizeof(gram_record));
+	p += records.size() * sizeof(gram_record);
+	std::memcpy(p, postings.data(), postings.size());
+	p += postings.size();
+	std::memcpy(p, dirnames.data(), dirnames.size());
+	p += dirnames.size();
+	std::memcpy(p, names.data(), names.size());
+
+	map_.close();
+	data_.swap(data);
+	return attach(data_.data(), data_.size());
+}
+
+bool sys::file_index::load(const sys::path& name)
+{
+	data_.clear();
+	map_.close();
+	if (!map_.open(name) || !attach(map_.data(), map_.size()))
+	{
+		map_.close();
+		return false;
+	}
+	return true;
+}
+
+bool sys::file_index::save(const sys::path& name) const
+{
+	if (empty())
+		return false;
+	const std::size_t size = sizeof(header) +
+		header_->dir_count * sizeof(dir_record) +
+		header_->block_count * sizeof(block_record) +
+		header_->gram_count * sizeof(gram_record) +
+		header_->postings_size + header_->dirnames_size + header_->names_size;
+	std::ofstream ofs(name.c_str(), std::ios::binary | std::ios::trunc);
+	ofs.write(reinterpret_cast<const char*>(header_),
+		static_cast<std::streamsize>(size));
+	return ofs.good();
+}
+
+bool sys::file_index::empty(void) const
+{
+	return header_ == nullptr || header_->dir_count == 0;
+}
+
+std::size_t sys::file_index::directories(void) const
+{
+	return header_ ? static_cast<std::size_t>(header_->dir_count) : 0;
+}
+
+std::size_t sys::file_index::entries(void) const
+{
+	return header_ ? static_cast<std::size_t>(header_->entry_count) : 0;
+}
+
+std::size_t sys::file_index::exact(const std::string& name,
+	std::vector<std::string>& results) const
+{
+	return search({ name }, [&name](std::string_view n) { return n == name; },
+		results);
+}
+
+std::size_t sys::file_index::substring(const std::string& text,
+	std::vector<std::string>& results) const
+{
+	return search({ text }, [&text](std::string_view n) {
+		return n.find(text) != std::string_view::npos;
+	}, results);
+}
+
+std::size_t sys::file_index::glob(const std::string& pattern,
+	std::vector<std::string>& results) const
+{
+	std::vector<std::string> literals;
+	glob_literals(pattern, literals);
+	return search(literals, [&pattern](std::string_view n) {
+		return glob_match(pattern, n);
+	}, results);
+}
+
+bool sys::file_index::attach(const char* data, std::size_t size)
+{
+	header_ = nullptr;
+	dirs_ = nullptr;
+	blocks_ = nullptr;
+	grams_ = nullptr;
+	postings_ = nullptr;
+	dirnames_ = nullptr;
+	names_ = nullptr;
+	if (size < sizeof(header))
+		return false;
+
+	const header* h = reinterpret_cast<const header*>(data);
+	if (std::memcmp(h->magic, index_magic, sizeof(h->magic)) != 0 ||
+		h->version != index_version)
+		return false;
+	if (h->dir_count > size / sizeof(dir_record) ||
+		h->block_count > size / sizeof(block_record) ||
+		h->gram_count > size / sizeof(gram_record) ||
+		h->postings_size > size || h->dirnames_size > size || h->names_size > size ||
+		sizeof(header) + h->dir_count * sizeof(dir_record) +
+			h->block_count * sizeof(block_record) +
+			h->gram_count * sizeof(gram_record) + h->postings_size +
+			h->dirnames_size + h->names_size != size)
+		return false;
+
+	header_ = h;
+	dirs_ = reinterpret_cast<const dir_record*>(data + sizeof(header));
+	blocks_ = reinterpret_cast<const block_record*>(dirs_ + h->dir_count);
+	grams_ = reinterpret_cast<const gram_record*>(blocks_ + h->block_count);
+	postings_ = reinterpret_cast<const unsigned char*>(grams_ + h->gram_count);
+	dirnames_ = reinterpret_cast<const char*>(postings_ + h->postings_size);
+	names_ = reinterpret_cast<const unsigned char*>(dirnames_ + h->dirnames_size);
+	return true;
+}
+
+std::size_t sys::file_index::search(const std::vector<std::string>& literals,
+	const match_type& match, std::vector<std::string>& results) const
+{
+	if (empty())
+		return 0;
+
+	std::vector<std::uint32_t> wanted;
+	for (const std::string& literal : literals)
+		for (std::size_t i = 0; i + 3 <= literal.size(); ++i)
+			wanted.push_back(trigram(literal.data() + i));
+	std::sort(wanted.begin(), wanted.end());
+	wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+	const gram_record* first = grams_;
+	const gram_record* last = grams_ + header_->gram_count;
+	std::vector<const gram_record*> records;
+	for (std::uint32_t gram : wanted)
+	{
+		const gram_record* g = std::lower_bound(first, last, gram,
+			[](const gram_record& lhs, std::uint32_t rhs) { return lhs.gram < rhs; });
+		if (g == last || g->gram != gram)
+			return 0;
+		records.push_back(g);
+	}
+	std::sort(records.begin(), records.end(),
+		[](const gram_record* lhs, const gram_record* rhs) {
+			return lhs->count < rhs->count;
+		});
+
+	std::vector<std::uint32_t> candidates;
+	std::vector<std::uint32_t> ids;
+	std::vector<std::uint32_t> merged;
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		const unsigned char* p = postings_ + records[i]->offset;
+		ids.resize(records[i]->count);
+		std::uint32_t id = 0;
+		for (std::uint32_t& out : ids)
+			out = id += static_cast<std::uint32_t>(get_varint(p));
+		if (i == 0)
+			candidates.swap(ids);
+		else
+		{
+			merged.clear();
+			std::set_intersection(candidates.begin(), candidates.end(),
+				ids.begin(), ids.end(), std::back_inserter(merged));
+			candidates.swap(merged);
+		}
+		if (candidates.empty())
+			return 0;
+	}
+
+	const std::size_t before = results.size();
+	std::string dirname;
+	std::uint64_t current = no_index;
+	auto emit = [&](std::uint64_t d, std::string_view name) {
+		if (d != current)
+		{
+			dir_path(d, dirname);
+			if (!std::strchr(path::separators, dirname.back()))
+				dirname += path::preferred_separator;
+			current = d;
+		}
+		std::string result;
+		result.reserve(dirname.size() + name.size());
+		result.assign(dirname);
+		result.append(name);
+		results.push_back(std::move(result));
+	};
+
+	if (records.empty())
+	{
+		for (std::size_t b = 0; b < header_->block_count; ++b)
+		{
+			decode(b, [&](std::uint32_t, std::string_view name, file_type_t) {
+				if (match(name))
+					emit(blocks_[b].dir, name);
+			});
+		}
+		return results.size() - before;
+	}
+
+	const block_record* blocks_end = blocks_ + header_->block_count;
+	for (std::size_t c = 0; c < candidates.size(); )
+	{
+		const block_record* block = std::upper_bound(blocks_, blocks_end,
+			candidates[c], [](std::uint32_t lhs, const block_record& rhs) {
+				return lhs < rhs.first_entry;
+			}) - 1;
+		decode(static_cast<std::size_t>(block - blocks_),
+			[&](std::uint32_t id, std::string_view name, file_type_t) {
+				if (c < candidates.size() && candidates[c] == id)
+				{
+					++c;
+					if (match(name))
+						emit(block->dir, name);
+				}
+			});
+	}
+	return results.size() - before;
+}
+
+std::size_t sys::file_index::block_size(std::size_t block) const
+{
+	const std::uint64_t end = block + 1 < header_->block_count ?
+		blocks_[block + 1].first_entry : header_->entry_count;
+	return static_cast<std::size_t>(end - blocks_[block].first_entry);
+}
+
+void sys::file_index::dir_path(std::uint64_t dir, std::string& result) const
+{
+	std::vector<std::uint64_t> chain;
+	for (std::uint64_t d = dir; d != no_index; d = dirs_[d].parent)
+		chain.push_back(d);
+
+	result.clear();
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+	{
+		if (!result.empty() && !std::strchr(path::separators, result.back()))
+			result += path::preferred_separator;
+		result.append(dirnames_ + dirs_[*it].name_offset, dirs_[*it].name_size);
+	}
+}
\ No newline at end of file
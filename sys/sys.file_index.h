@@ -0,0 +1,114 @@
+#ifndef __SYS_FILE_INDEX__
+#define __SYS_FILE_INDEX__
+
+#include "sys.config.h"
+#include "sys.mapped_file.h"
+#include "sys.noncopyable.h"
+#include "sys.parallel_walker.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sys
+{
+	class file_index : public noncopyable
+	{
+		struct header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t reserved;
+			std::uint64_t dir_count;
+			std::uint64_t entry_count;
+			std::uint64_t block_count;
+			std::uint64_t gram_count;
+			std::uint64_t postings_size;
+			std::uint64_t dirnames_size;
+			std::uint64_t names_size;
+		};
+
+		struct dir_record
+		{
+			std::uint64_t parent;
+			std::uint64_t dev;
+			std::uint64_t inode;
+			std::int64_t mtime;
+			std::uint64_t name_offset;
+			std::uint32_t name_size;
+			std::uint32_t first_block;
+			std::uint32_t block_count;
+			std::uint32_t entry_count;
+		};
+
+		// names are front-coded in blocks that never span two directories
+		struct block_record
+		{
+			std::uint64_t offset;
+			std::uint32_t first_entry;
+			std::uint32_t dir;
+		};
+
+		struct gram_record
+		{
+			std::uint32_t gram;
+			std::uint32_t count;
+			std::uint64_t offset;
+		};
+
+		struct builder;
+	public:
+		typedef std::function<bool(std::string_view)> match_type;
+	private:
+		std::vector<char> data_;
+		mapped_file map_;
+		const header* header_;
+		const dir_record* dirs_;
+		const block_record* blocks_;
+		const gram_record* grams_;
+		const unsigned char* postings_;
+		const char* dirnames_;
+		const unsigned char* names_;
+	public:
+		file_index(void);
+		virtual ~file_index(void);
+	public:
+		bool build(const path& root, thread_group& group);
+		bool build(const path& root, thread_group& group,
+			const parallel_walk_options& options);
+		bool update(const path& root, thread_group& group);
+		bool update(const path& root, thread_group& group,
+			const parallel_walk_options& options);
+	public:
+		bool load(const path& name);
+		bool save(const path& name) const;
+	public:
+		bool empty(void) const;
+		std::size_t directories(void) const;
+		std::size_t entries(void) const;
+	public:
+		std::size_t exact(const std::string& name,
+			std::vector<std::string>& results) const;
+		std::size_t substring(const std::string& text,
+			std::vector<std::string>& results) const;
+		std::size_t glob(const std::string& pattern,
+			std::vector<std::string>& results) const;
+	private:
+		bool rebuild(const path& root, thread_group& group,
+			const parallel_walk_options& options, bool incremental);
+		bool attach(const char* data, std::size_t size);
+		std::size_t search(const std::vector<std::string>& literals,
+			const match_type& match, std::vector<std::string>& results) const;
+		std::size_t block_size(std::size_t block) const;
+		template<class Function>
+		void decode(std::size_t block, Function f) const;
+		void dir_path(std::uint64_t dir, std::string& result) const;
+	};
+}
+
+#endif
+
@@ -0,0 +1,35 @@
+#include "sys.config.h"
+#include "sys.futex.h"
+
+#include <algorithm>
+#include <climits>
+
+#if defined(SYS_HAVE_FUTEX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void sys::futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected)
+{
+#if defined(SYS_HAVE_FUTEX)
+	::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+		FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+	word.wait(expected, std::memory_order_acquire);
+#endif
+}
+
+void sys::futex_wake(std::atomic<std::uint32_t>& word, std::uint32_t count)
+{
+#if defined(SYS_HAVE_FUTEX)
+	::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+		FUTEX_WAKE_PRIVATE, std::min<std::uint32_t>(count, INT_MAX),
+		nullptr, nullptr, 0);
+#else
+	if (count == 1)
+		word.notify_one();
+	else
+		word.notify_all();
+#endif
+}
\ No newline at end of file
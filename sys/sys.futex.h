@@ -0,0 +1,33 @@
+#ifndef __SYS_FUTEX__
+#define __SYS_FUTEX__
+
+#include "sys.config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(SYS_MSVC)
+#include <intrin.h>
+#endif
+
+namespace sys
+{
+	// blocks while word still holds expected; may return spuriously
+	void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected);
+	void futex_wake(std::atomic<std::uint32_t>& word, std::uint32_t count);
+
+	inline void cpu_relax(void)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(SYS_MSVC)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+}
+
+#endif
+
@@ -0,0 +1,111 @@
+#include "sys.config.h"
+#include "sys.mapped_file.h"
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+sys::mapped_file::mapped_file(void)
+	: data_(nullptr)
+	, size_(0)
+#if defined(SYS_WIN32)
+	, file_(INVALID_HANDLE_VALUE)
+	, mapping_(nullptr)
+#endif
+{
+}
+
+sys::mapped_file::~mapped_file(void)
+{
+	close();
+}
+
+bool sys::mapped_file::open(const sys::path& name)
+{
+	close();
+#if defined(SYS_WIN32)
+	file_ = ::CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_ == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	data_ = static_cast<const char*>(
+		::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == nullptr)
+	{
+		close();
+		return false;
+	}
+	size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+	int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+		PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+
+	data_ = static_cast<const char*>(addr);
+	size_ = static_cast<std::size_t>(st.st_size);
+#endif
+	return true;
+}
+
+void sys::mapped_file::close(void)
+{
+#if defined(SYS_WIN32)
+	if (data_ != nullptr)
+		::UnmapViewOfFile(data_);
+	if (mapping_ != nullptr)
+		::CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE)
+		::CloseHandle(file_);
+	mapping_ = nullptr;
+	file_ = INVALID_HANDLE_VALUE;
+#else
+	if (data_ != nullptr)
+		::munmap(const_cast<char*>(data_), size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+bool sys::mapped_file::is_open(void) const
+{
+	return data_ != nullptr;
+}
+
+const char* sys::mapped_file::data(void) const
+{
+	return data_;
+}
+
+std::size_t sys::mapped_file::size(void) const
+{
+	return size_;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef __SYS_MAPPED_FILE__
+#define __SYS_MAPPED_FILE__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+
+#include <cstddef>
+
+namespace sys
+{
+	class mapped_file : public noncopyable
+	{
+		const char* data_;
+		std::size_t size_;
+#if defined(SYS_WIN32)
+		HANDLE file_;
+		HANDLE mapping_;
+#endif
+	public:
+		mapped_file(void);
+		virtual ~mapped_file(void);
+	public:
+		bool open(const path& name);
+		void close(void);
+	public:
+		bool is_open(void) const;
+		const char* data(void) const;
+		std::size_t size(void) const;
+	};
+}
+
+#endif
+
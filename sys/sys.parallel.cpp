@@ -0,0 +1,9 @@
+#include "sys.config.h"
+#include "sys.parallel.h"
+
+sys::thread_pool& sys::default_pool(void)
+{
+	static thread_group group;
+	static thread_pool pool(group);
+	return pool;
+}
\ No newline at end of file
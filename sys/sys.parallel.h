@@ -0,0 +1,315 @@
+#ifndef __SYS_PARALLEL__
+#define __SYS_PARALLEL__
+
+#include "sys.config.h"
+#include "sys.thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sys
+{
+	struct parallel_options
+	{
+		thread_pool* pool = nullptr;
+		std::size_t grain = 0;
+	};
+
+	thread_pool& default_pool(void);
+
+	template<class First, class Second>
+	void parallel_invoke(thread_pool& pool, First&& first, Second&& second);
+
+	// ranges are halved until they are no bigger than the grain; the
+	// second half of every split can be stolen by an idle worker
+	template<class Function>
+	void parallel_for(std::size_t begin, std::size_t end, Function&& f);
+	template<class Function>
+	void parallel_for(std::size_t begin, std::size_t end, Function&& f,
+		const parallel_options& options);
+
+	template<class T, class Transform, class Reduce>
+	T parallel_reduce(std::size_t begin, std::size_t end, T identity,
+		Transform&& transform, Reduce&& reduce);
+	template<class T, class Transform, class Reduce>
+	T parallel_reduce(std::size_t begin, std::size_t end, T identity,
+		Transform&& transform, Reduce&& reduce, const parallel_options& options);
+
+	// both ranges are indexed, so both need random access iterators
+	template<class RandomIt, class RandomOutputIt, class Function>
+	RandomOutputIt parallel_transform(RandomIt first, RandomIt last,
+		RandomOutputIt out, Function&& f);
+	template<class RandomIt, class RandomOutputIt, class Function>
+	RandomOutputIt parallel_transform(RandomIt first, RandomIt last,
+		RandomOutputIt out, Function&& f, const parallel_options& options);
+
+	template<class RandomIt>
+	void parallel_sort(RandomIt first, RandomIt last);
+	template<class RandomIt, class Compare>
+	void parallel_sort(RandomIt first, RandomIt last, Compare compare);
+	template<class RandomIt, class Compare>
+	void parallel_sort(RandomIt first, RandomIt last, Compare compare,
+		const parallel_options& options);
+
+	inline thread_pool& parallel_pool(const parallel_options& options)
+	{
+		return options.pool != nullptr ? *options.pool : default_pool();
+	}
+
+	inline std::size_t parallel_grain(const parallel_options& options,
+		thread_pool& pool, std::size_t size, std::size_t minimum)
+	{
+		if (options.grain != 0)
+			return options.grain;
+		return std::max(minimum, size / (pool.size() * 8));
+	}
+
+	// the posted half refers to this frame, so it is waited for even when
+	// first() throws; an exception from either side is rethrown here
+	template<class First, class Second>
+	void parallel_invoke(thread_pool& pool, First&& first, Second&& second)
+	{
+		std::atomic<bool> done(false);
+		std::exception_ptr failed;
+		pool.post([&second, &done, &failed]() {
+			try
+			{
+				second();
+			}
+			catch (...)
+			{
+				failed = std::current_exception();
+			}
+			done.store(true, std::memory_order_release);
+		});
+		try
+		{
+			first();
+		}
+		catch (...)
+		{
+			pool.wait([&done]() { return done.load(std::memory_order_acquire); });
+			throw;
+		}
+		pool.wait([&done]() { return done.load(std::memory_order_acquire); });
+		if (failed)
+			std::rethrow_exception(failed);
+	}
+
+	template<class Function>
+	void parallel_for_split(thread_pool& pool, std::size_t begin, std::size_t end,
+		std::size_t grain, Function& f)
+	{
+		if (end - begin <= grain)
+		{
+			for (std::size_t i = begin; i < end; ++i)
+				f(i);
+			return;
+		}
+		const std::size_t middle = begin + (end - begin) / 2;
+		parallel_invoke(pool,
+			[&]() { parallel_for_split(pool, begin, middle, grain, f); },
+			[&]() { parallel_for_split(pool, middle, end, grain, f); });
+	}
+
+	template<class Function>
+	void parallel_for(std::size_t begin, std::size_t end, Function&& f)
+	{
+		parallel_for(begin, end, std::forward<Function>(f), parallel_options());
+	}
+
+	template<class Function>
+	void parallel_for(std::size_t begin, std::size_t end, Function&& f,
+		const parallel_options& options)
+	{
+		if (begin >= end)
+			return;
+		thread_pool& pool = parallel_pool(options);
+		parallel_for_split(pool, begin, end,
+			parallel_grain(options, pool, end - begin, 1), f);
+	}
+
+	template<class T, class Transform, class Reduce>
+	T parallel_reduce_split(thread_pool& pool, std::size_t begin, std::size_t end,
+		std::size_t grain, const T& identity, Transform& transform, Reduce& reduce)
+	{
+		if (end - begin <= grain)
+		{
+			T result = identity;
+			for (std::size_t i = begin; i < end; ++i)
+				result = reduce(std::move(result), transform(i));
+			return result;
+		}
+		const std::size_t middle = begin + (end - begin) / 2;
+		T left = identity;
+		T right = identity;
+		parallel_invoke(pool,
+			[&]() {
+				left = parallel_reduce_split(pool, begin, middle, grain,
+					identity, transform, reduce);
+			},
+			[&]() {
+				right = parallel_reduce_split(pool, middle, end, grain,
+					identity, transform, reduce);
+			});
+		return reduce(std::move(left), std::move(right));
+	}
+
+	template<class T, class Transform, class Reduce>
+	T parallel_reduce(std::size_t begin, std::size_t end, T identity,
+		Transform&& transform, Reduce&& reduce)
+	{
+		return parallel_reduce(begin, end, std::move(identity),
+			std::forward<Transform>(transform), std::forward<Reduce>(reduce),
+			parallel_options());
+	}
+
+	template<class T, class Transform, class Reduce>
+	T parallel_reduce(std::size_t begin, std::size_t end, T identity,
+		Transform&& transform, Reduce&& reduce, const parallel_options& options)
+	{
+		if (begin >= end)
+			return identity;
+		thread_pool& pool = parallel_pool(options);
+		return parallel_reduce_split(pool, begin, end,
+			parallel_grain(options, pool, end - begin, 1), identity, transform, reduce);
+	}
+
+	template<class RandomIt, class RandomOutputIt, class Function>
+	RandomOutputIt parallel_transform(RandomIt first, RandomIt last,
+		RandomOutputIt out, Function&& f)
+	{
+		return parallel_transform(first, last, out, std::forward<Function>(f),
+			parallel_options());
+	}
+
+	template<class RandomIt, class RandomOutputIt, class Function>
+	RandomOutputIt parallel_transform(RandomIt first, RandomIt last,
+		RandomOutputIt out, Function&& f, const parallel_options& options)
+	{
+		static_assert(std::random_access_iterator<RandomIt> &&
+			std::random_access_iterator<RandomOutputIt>,
+			"parallel_transform indexes both ranges");
+		const std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+		parallel_for(0, size, [&](std::size_t i) {
+			out[i] = f(first[i]);
+		}, options);
+		return out + size;
+	}
+
+	// moves both ranges into the uninitialized storage at out
+	template<class RandomIt, class Compare>
+	void parallel_merge(thread_pool& pool, RandomIt first1, RandomIt last1,
+		RandomIt first2, RandomIt last2,
+		typename std::iterator_traits<RandomIt>::value_type* out,
+		Compare& compare, std::size_t grain)
+	{
+		std::size_t size1 = static_cast<std::size_t>(last1 - first1);
+		std::size_t size2 = static_cast<std::size_t>(last2 - first2);
+		// two elements can split into one empty half and the same two
+		// again, so they are always merged here
+		if (size1 + size2 <= std::max<std::size_t>(grain, 2))
+		{
+			for (; first1 != last1 && first2 != last2; ++out)
+			{
+				if (compare(*first2, *first1))
+					std::construct_at(out, std::move(*first2++));
+				else
+					std::construct_at(out, std::move(*first1++));
+			}
+			out = std::uninitialized_move(first1, last1, out);
+			std::uninitialized_move(first2, last2, out);
+			return;
+		}
+		if (size1 < size2)
+		{
+			std::swap(first1, first2);
+			std::swap(last1, last2);
+			std::swap(size1, size2);
+		}
+		const RandomIt middle1 = first1 + size1 / 2;
+		const RandomIt middle2 = std::lower_bound(first2, last2, *middle1, compare);
+		typename std::iterator_traits<RandomIt>::value_type* const middle =
+			out + (middle1 - first1) + (middle2 - first2);
+		parallel_invoke(pool,
+			[&]() {
+				parallel_merge(pool, first1, middle1, first2, middle2, out, compare, grain);
+			},
+			[&]() {
+				parallel_merge(pool, middle1, last1, middle2, last2, middle, compare, grain);
+			});
+	}
+
+	template<class RandomIt, class Compare>
+	void parallel_sort_split(thread_pool& pool, RandomIt first, RandomIt last,
+		typename std::iterator_traits<RandomIt>::value_type* buffer,
+		Compare& compare, std::size_t grain)
+	{
+		const std::size_t size = static_cast<std::size_t>(last - first);
+		if (size <= grain)
+		{
+			std::sort(first, last, compare);
+			return;
+		}
+		const RandomIt middle = first + size / 2;
+		parallel_invoke(pool,
+			[&]() { parallel_sort_split(pool, first, middle, buffer, compare, grain); },
+			[&]() {
+				parallel_sort_split(pool, middle, last, buffer + size / 2, compare, grain);
+			});
+		parallel_merge(pool, first, middle, middle, last, buffer, compare, grain);
+
+		auto move_back = [&](std::size_t chunk) {
+			const std::size_t begin = chunk * grain;
+			const std::size_t end = std::min(size, begin + grain);
+			std::move(buffer + begin, buffer + end, first + begin);
+			std::destroy(buffer + begin, buffer + end);
+		};
+		parallel_for_split(pool, 0, (size + grain - 1) / grain, 1, move_back);
+	}
+
+	template<class RandomIt>
+	void parallel_sort(RandomIt first, RandomIt last)
+	{
+		parallel_sort(first, last, std::less<>(), parallel_options());
+	}
+
+	template<class RandomIt, class Compare>
+	void parallel_sort(RandomIt first, RandomIt last, Compare compare)
+	{
+		parallel_sort(first, last, compare, parallel_options());
+	}
+
+	template<class RandomIt, class Compare>
+	void parallel_sort(RandomIt first, RandomIt last, Compare compare,
+		const parallel_options& options)
+	{
+		typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+		const std::size_t size = static_cast<std::size_t>(last - first);
+		if (size < 2)
+			return;
+		thread_pool& pool = parallel_pool(options);
+		const std::size_t grain = parallel_grain(options, pool, size, 2048);
+		if (size <= grain)
+		{
+			std::sort(first, last, compare);
+			return;
+		}
+		// raw storage, so value_type needs no default constructor; every
+		// merge moves into it and the elements are destroyed on the way back
+		std::allocator<value_type> allocator;
+		value_type* buffer = allocator.allocate(size);
+		parallel_sort_split(pool, first, last, buffer, compare, grain);
+		allocator.deallocate(buffer, size);
+	}
+}
+
+#endif
+
@@ -0,0 +1,473 @@
+#include "sys.config.h"
+#include "sys.parallel_walker.h"
+
+#include "sys.futex.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#endif
+
+static const std::size_t parallel_walker_batch_size = 256;
+static const int parallel_walker_spin_count = 64;
+
+sys::walk_visitor::~walk_visitor(void)
+{
+}
+
+sys::walk_action_t sys::walk_visitor::filter(const sys::walk_entry&,
+	std::size_t)
+{
+	return walk_continue;
+}
+
+void sys::walk_visitor::enter(const sys::walk_entry&, sys::dir&,
+	std::vector<sys::dir_entry>&, std::size_t)
+{
+}
+
+void sys::walk_visitor::leave(const sys::walk_entry&, int, std::size_t)
+{
+}
+
+sys::parallel_walker::parallel_walker(const sys::path& root)
+	: parallel_walker(root, parallel_walk_options())
+{
+}
+
+sys::parallel_walker::parallel_walker(const sys::path& root,
+	const sys::parallel_walk_options& options)
+	: root_(root)
+	, options_(options)
+	, visitor_(nullptr)
+	, outstanding_(0)
+	, stop_(false)
+	, error_(0)
+	, epoch_(0)
+	, sleepers_(0)
+{
+}
+
+sys::parallel_walker::~parallel_walker(void)
+{
+}
+
+int sys::parallel_walker::error(void) const
+{
+	return error_.load(std::memory_order_acquire);
+}
+
+bool sys::parallel_walker::walk(sys::thread_group& group,
+	sys::walk_visitor& visitor)
+{
+	std::size_t threads = options_.threads;
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	auto root = std::make_shared<node>();
+	root->path.assign(root_.native());
+	while (root->path.size() > 1 &&
+			std::strchr(path::separators, root->path.back()))
+		root->path.pop_back();
+	root->name_pos = 0;
+	root->depth = 0;
+	root->inode = 0;
+	root->dev = 0;
+	root->dir_inode = 0;
+	root->owner = static_cast<std::size_t>(-1);
+	root->keep = true;
+	root->pending.store(1, std::memory_order_relaxed);
+
+	visitor_ = &visitor;
+	stop_.store(false, std::memory_order_relaxed);
+	error_.store(0, std::memory_order_relaxed);
+	if (!open(*root))
+		return false;
+
+	workers_.clear();
+	for (std::size_t i = 0; i < threads; ++i)
+	{
+		workers_.push_back(std::make_unique<worker>());
+		workers_.back()->open.store(0, std::memory_order_relaxed);
+		workers_.back()->batch.resize(parallel_walker_batch_size);
+		workers_.back()->seed = static_cast<std::uint32_t>(i * 2654435761u + 1);
+	}
+
+	outstanding_.store(1, std::memory_order_relaxed);
+	workers_.front()->tasks.push_back(root);
+	root.reset();
+
+	group.run(threads, [this](std::size_t index) { run(index); });
+
+	workers_.clear();
+	visitor_ = nullptr;
+	return !stop_.load(std::memory_order_acquire);
+}
+
+void sys::parallel_walker::run(std::size_t index)
+{
+	std::shared_ptr<node> n;
+	int idle = 0;
+	while (!stop_.load(std::memory_order_relaxed))
+	{
+		if (pop(index, n) || steal(index, n))
+		{
+			process(index, n);
+			n.reset();
+			// the last node out, or a stop, lets every parked worker go
+			if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1 ||
+					stop_.load(std::memory_order_relaxed))
+				wake(UINT32_MAX);
+			idle = 0;
+			continue;
+		}
+		if (outstanding_.load(std::memory_order_acquire) == 0)
+			break;
+		if (++idle < parallel_walker_spin_count)
+		{
+			cpu_relax();
+			continue;
+		}
+
+		const std::uint32_t epoch = epoch_.load(std::memory_order_acquire);
+		sleepers_.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!queued() && outstanding_.load(std::memory_order_acquire) != 0 &&
+				!stop_.load(std::memory_order_acquire))
+			futex_wait(epoch_, epoch);
+		sleepers_.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+
+bool sys::parallel_walker::pop(std::size_t index, std::shared_ptr<node>& n)
+{
+	worker& self = *workers_[index];
+	std::lock_guard<std::mutex> guard(self.mutex);
+	if (self.tasks.empty())
+		return false;
+	n = std::move(self.tasks.back());
+	self.tasks.pop_back();
+	return true;
+}
+
+bool sys::parallel_walker::steal(std::size_t index, std::shared_ptr<node>& n)
+{
+	worker& self = *workers_[index];
+	self.seed ^= self.seed << 13;
+	self.seed ^= self.seed >> 17;
+	self.seed ^= self.seed << 5;
+
+	const std::size_t count = workers_.size();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		worker& victim = *workers_[(self.seed + i) % count];
+		if (&victim == &self)
+			continue;
+		std::lock_guard<std::mutex> guard(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			n = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void sys::parallel_walker::push(std::size_t index, std::shared_ptr<node> n)
+{
+	worker& self = *workers_[index];
+	outstanding_.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> guard(self.mutex);
+		self.tasks.push_back(std::move(n));
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers_.load(std::memory_order_relaxed) != 0)
+		wake(1);
+}
+
+bool sys::parallel_walker::queued(void)
+{
+	for (auto& w : workers_)
+	{
+		std::lock_guard<std::mutex> guard(w->mutex);
+		if (!w->tasks.empty())
+			return true;
+	}
+	return false;
+}
+
+void sys::parallel_walker::wake(std::uint32_t count)
+{
+	epoch_.fetch_add(1, std::memory_order_release);
+	futex_wake(epoch_, count);
+}
+
+void sys::parallel_walker::process(std::size_t index,
+	const std::shared_ptr<node>& n)
+{
+	if (!n->handle && !open(*n))
+	{
+		if (!(options_.order & walk_post_order))
+			release(index, n->parent.get());
+		release(index, n.get());
+		return;
+	}
+
+	if (!(options_.order & walk_post_order))
+		release(index, n->parent.get());
+
+	worker& self = *workers_[index];
+	if (n->parent)
+	{
+		n->owner = index;
+		n->keep = self.open.load(std::memory_order_relaxed) < options_.max_open;
+		if (n->keep)
+			self.open.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	walk_entry entry;
+	describe(*n, entry);
+	self.listing.clear();
+	visitor_->enter(entry, *n->handle, self.listing, index);
+	list(index, n);
+	self.listing.clear();
+	if (!stop_.load(std::memory_order_relaxed))
+		visitor_->leave(entry, n->handle->error(), index);
+	if (!n->keep)
+		n->handle.reset();
+	release(index, n.get());
+}
+
+bool sys::parallel_walker::open(sys::parallel_walker::node& n)
+{
+#if defined(SYS_WIN32)
+	n.handle = std::make_unique<dir>(n.path.c_str(), options_.buffer_size);
+	if (!n.handle->is_open())
+	{
+		n.handle.reset();
+		set_error(ENOENT);
+		return false;
+	}
+	return true;
+#else
+	const node* parent = n.parent.get();
+	if (parent != nullptr && parent->keep && parent->handle)
+		n.handle = std::make_unique<dir>(parent->handle->native_handle(),
+			n.path.c_str() + n.name_pos, options_.follow_symlinks,
+			options_.buffer_size);
+	else
+		n.handle = std::make_unique<dir>(AT_FDCWD, n.path.c_str(),
+			parent == nullptr || options_.follow_symlinks, options_.buffer_size);
+
+	struct stat st;
+	if (!n.handle->is_open() || ::fstat(n.handle->native_handle(), &st) != 0)
+	{
+		n.handle.reset();
+		set_error(errno);
+		return false;
+	}
+
+	n.dev = static_cast<std::uint64_t>(st.st_dev);
+	n.dir_inode = static_cast<std::uint64_t>(st.st_ino);
+	if (parent == nullptr)
+		return true;
+
+	if (options_.same_filesystem)
+	{
+		const node* root = parent;
+		while (root->parent != nullptr)
+			root = root->parent.get();
+		if (root->dev != n.dev)
+		{
+			n.handle.reset();
+			return false;
+		}
+	}
+	if (options_.follow_symlinks)
+	{
+		for (const node* a = parent; a != nullptr; a = a->parent.get())
+		{
+			if (a->dev == n.dev && a->dir_inode == n.dir_inode)
+			{
+				n.handle.reset();
+				return false;
+			}
+		}
+	}
+	return true;
+#endif
+}
+
+void sys::parallel_walker::list(std::size_t index,
+	const std::shared_ptr<node>& n)
+{
+	worker& self = *workers_[index];
+	dir& d = *n->handle;
+	const bool need_separator = !n->path.empty() &&
+		!std::strchr(path::separators, n->path.back());
+	const std::size_t depth = n->depth + 1;
+
+	std::size_t replayed = 0;
+	std::size_t count;
+	while (!stop_.load(std::memory_order_relaxed) &&
+		(count = read(self, d, replayed)) > 0)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const dir_entry& de = self.batch[i];
+			self.buf.assign(n->path);
+			if (need_separator)
+				self.buf += path::preferred_separator;
+			self.buf.append(de.name, de.size);
+
+			walk_entry entry;
+			entry.path = self.buf.c_str();
+			entry.size = self.buf.size();
+			entry.name_pos = self.buf.size() - de.size;
+			entry.depth = depth;
+			entry.inode = de.inode;
+			entry.type = de.type;
+			entry.order = walk_pre_order;
+#if defined(SYS_WIN32)
+			entry.dirfd = AT_FDCWD;
+			if (entry.type == type_unknown)
+				entry.type = path(entry.path).status();
+#else
+			entry.dirfd = d.native_handle();
+			if (entry.type == type_unknown ||
+				(entry.type == symlink_file && options_.follow_symlinks))
+			{
+				const file_type_t type = d.status(de.name, options_.follow_symlinks);
+				if (type != status_error || entry.type == type_unknown)
+					entry.type = type;
+			}
+#endif
+			const walk_action_t action = visitor_->filter(entry, index);
+			if (action == walk_stop)
+			{
+				stop_.store(true, std::memory_order_release);
+				return;
+			}
+			if (action == walk_skip)
+				continue;
+
+			bool descend = entry.type == directory_file &&
+				depth < options_.max_depth;
+			if (options_.order & walk_pre_order)
+			{
+				const walk_action_t action = visitor_->visit(entry, index);
+				if (action == walk_stop)
+				{
+					stop_.store(true, std::memory_order_release);
+					return;
+				}
+				if (action == walk_skip)
+					descend = false;
+			}
+
+			if (descend)
+			{
+				auto child = std::make_shared<node>();
+				child->parent = n;
+				child->path = self.buf;
+				child->name_pos = entry.name_pos;
+				child->depth = depth;
+				child->inode = entry.inode;
+				child->dev = 0;
+				child->dir_inode = 0;
+				child->owner = index;
+				child->keep = false;
+				child->pending.store(1, std::memory_order_relaxed);
+				n->pending.fetch_add(1, std::memory_order_relaxed);
+				push(index, std::move(child));
+			}
+			else if (options_.order & walk_post_order)
+			{
+				entry.order = walk_post_order;
+				if (!visit(entry, index))
+					return;
+			}
+		}
+	}
+	if (d.error() != 0)
+		set_error(d.error());
+}
+
+std::size_t sys::parallel_walker::read(sys::parallel_walker::worker& self,
+	sys::dir& d, std::size_t& replayed)
+{
+	if (self.listing.empty())
+		return d.read_batch(self.batch);
+	const std::size_t count = std::min(self.batch.size(),
+		self.listing.size() - replayed);
+	std::copy(self.listing.begin() + replayed,
+		self.listing.begin() + replayed + count, self.batch.begin());
+	replayed += count;
+	return count;
+}
+
+void sys::parallel_walker::describe(const sys::parallel_walker::node& n,
+	sys::walk_entry& entry) const
+{
+	entry.path = n.path.c_str();
+	entry.size = n.path.size();
+	entry.name_pos = n.name_pos;
+	entry.depth = n.depth;
+	entry.inode = n.inode;
+	entry.type = directory_file;
+	entry.order = walk_pre_order;
+	entry.dirfd = AT_FDCWD;
+}
+
+void sys::parallel_walker::release(std::size_t index, node* n)
+{
+	while (n != nullptr &&
+		n->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		if (n->handle)
+		{
+			if (n->keep && n->owner < workers_.size())
+				workers_[n->owner]->open.fetch_sub(1, std::memory_order_relaxed);
+			n->handle.reset();
+		}
+		if (!(options_.order & walk_post_order) || n->parent == nullptr)
+			return;
+
+		const node* parent = n->parent.get();
+		walk_entry entry;
+		describe(*n, entry);
+		entry.order = walk_post_order;
+#if !defined(SYS_WIN32)
+		entry.dirfd = (parent->keep && parent->handle) ?
+			parent->handle->native_handle() : AT_FDCWD;
+#endif
+		if (!visit(entry, index))
+			return;
+		n = n->parent.get();
+	}
+}
+
+bool sys::parallel_walker::visit(sys::walk_entry& entry, std::size_t index)
+{
+	if (stop_.load(std::memory_order_relaxed))
+		return false;
+	if (visitor_->visit(entry, index) == walk_stop)
+	{
+		stop_.store(true, std::memory_order_release);
+		return false;
+	}
+	return true;
+}
+
+void sys::parallel_walker::set_error(int err)
+{
+	int expected = 0;
+	error_.compare_exchange_strong(expected, err, std::memory_order_acq_rel);
+}
\ No newline at end of file
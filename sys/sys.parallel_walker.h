@@ -0,0 +1,110 @@
+#ifndef __SYS_PARALLEL_WALKER__
+#define __SYS_PARALLEL_WALKER__
+
+#include "sys.config.h"
+#include "sys.dir.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+#include "sys.walker.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sys
+{
+	class walk_visitor
+	{
+	public:
+		virtual ~walk_visitor(void);
+	public:
+		virtual walk_action_t filter(const walk_entry& entry, std::size_t worker);
+		virtual walk_action_t visit(const walk_entry& entry, std::size_t worker) = 0;
+	public:
+		// enter() sees each directory once it is open and before it is read;
+		// entries it leaves in listing are walked instead of reading it, and
+		// must stay valid until leave(), which gets the read error if any.
+		// Both see the full path with AT_FDCWD as dirfd
+		virtual void enter(const walk_entry& entry, dir& d,
+			std::vector<dir_entry>& listing, std::size_t worker);
+		virtual void leave(const walk_entry& entry, int error, std::size_t worker);
+	};
+
+	// directories whose parent exceeded max_open are reopened by full path and
+	// their post-order entries carry AT_FDCWD as dirfd
+	struct parallel_walk_options : public walk_options
+	{
+		std::size_t threads = 0;
+		std::size_t max_open = 32;
+	};
+
+	class parallel_walker : public noncopyable
+	{
+		struct node
+		{
+			std::shared_ptr<node> parent;
+			std::string path;
+			std::size_t name_pos;
+			std::size_t depth;
+			std::uint64_t inode;
+			std::uint64_t dev;
+			std::uint64_t dir_inode;
+			std::unique_ptr<dir> handle;
+			std::size_t owner;
+			bool keep;
+			std::atomic<std::size_t> pending;
+		};
+
+		struct alignas(64) worker
+		{
+			std::mutex mutex;
+			std::deque<std::shared_ptr<node>> tasks;
+			std::atomic<std::size_t> open;
+			std::vector<dir_entry> batch;
+			std::vector<dir_entry> listing;
+			std::string buf;
+			std::uint32_t seed;
+		};
+	private:
+		path root_;
+		parallel_walk_options options_;
+		std::vector<std::unique_ptr<worker>> workers_;
+		walk_visitor* visitor_;
+		std::atomic<std::size_t> outstanding_;
+		std::atomic<bool> stop_;
+		std::atomic<int> error_;
+		// idle workers park on epoch_ until push() or the end of the walk
+		std::atomic<std::uint32_t> epoch_;
+		std::atomic<std::uint32_t> sleepers_;
+	public:
+		parallel_walker(const path& root);
+		parallel_walker(const path& root, const parallel_walk_options& options);
+		virtual ~parallel_walker(void);
+	public:
+		bool walk(thread_group& group, walk_visitor& visitor);
+		int error(void) const;
+	private:
+		void run(std::size_t index);
+		bool pop(std::size_t index, std::shared_ptr<node>& n);
+		bool steal(std::size_t index, std::shared_ptr<node>& n);
+		void push(std::size_t index, std::shared_ptr<node> n);
+		bool queued(void);
+		void wake(std::uint32_t count);
+		void process(std::size_t index, const std::shared_ptr<node>& n);
+		bool open(node& n);
+		void list(std::size_t index, const std::shared_ptr<node>& n);
+		std::size_t read(worker& self, dir& d, std::size_t& replayed);
+		void describe(const node& n, walk_entry& entry) const;
+		void release(std::size_t index, node* n);
+		bool visit(walk_entry& entry, std::size_t index);
+		void set_error(int err);
+	};
+}
+
+#endif
+
@@ -165,6 +165,98 @@ bool sys::path::equal(const sys::path& rhs) const
 	return pathname_.compare(rhs.pathname_) == 0;
 }
 
+// reads a path one character at a time as 0 at the end, 1 for a
+// separator and the byte plus 2 otherwise. A leading "//" before a name
+// is kept as the root name, any other run of separators reads as one,
+// and "." components and trailing separators are skipped.
+class sys::path::key_reader
+{
+	const char* pos_;
+	const char* end_;
+	const char* component_;
+	std::string::size_type left_;
+	int root_;
+	bool first_;
+public:
+	key_reader(const char* str, std::string::size_type size)
+		: pos_(str)
+		, end_(str + size)
+		, component_(nullptr)
+		, left_(0)
+		, root_(0)
+		, first_(true)
+	{
+		std::string::size_type n(0);
+		while (n < size && is_separator(str[n]))
+			++n;
+		if (n != 0)
+			root_ = n == 2 && n < size ? 2 : 1;
+		pos_ += n;
+	}
+
+	int next(void)
+	{
+		if (root_ > 0)
+		{
+			--root_;
+			return 1;
+		}
+		if (left_ != 0)
+		{
+			--left_;
+			return static_cast<unsigned char>(*component_++) + 2;
+		}
+		while (pos_ != end_)
+		{
+			const char* start(pos_);
+			while (pos_ != end_ && !is_separator(*pos_))
+				++pos_;
+			const std::string::size_type size(pos_ - start);
+			while (pos_ != end_ && is_separator(*pos_))
+				++pos_;
+			if (size == 1 && *start == '.')
+				continue;
+
+			component_ = start;
+			left_ = size;
+			if (!first_)
+				return 1;
+			first_ = false;
+			--left_;
+			return static_cast<unsigned char>(*component_++) + 2;
+		}
+		return 0;
+	}
+};
+
+int sys::path::compare(const sys::path& rhs) const
+{
+	key_reader lhs(pathname_.data(), pathname_.size());
+	key_reader other(rhs.pathname_.data(), rhs.pathname_.size());
+	for (;;)
+	{
+		const int l(lhs.next());
+		const int r(other.next());
+		if (l != r)
+			return l < r ? -1 : 1;
+		if (l == 0)
+			return 0;
+	}
+}
+
+void sys::path::append_key(std::string& key, const char* str,
+	std::string::size_type size)
+{
+	key_reader reader(str, size);
+	for (int c(reader.next()); c != 0; c = reader.next())
+		key += c == 1 ? separator : static_cast<char>(c - 2);
+}
+
+void sys::path::swap(sys::path& other)
+{
+	pathname_.swap(other.pathname_);
+}
+
 sys::path& sys::path::operator=(const char* str)
 {
 	return assign(str);
@@ -225,6 +317,26 @@ bool sys::path::operator!=(const sys::path& rhs) const
 	return !equal(rhs);
 }
 
+bool sys::path::operator<(const sys::path& rhs) const
+{
+	return compare(rhs) < 0;
+}
+
+bool sys::path::operator<=(const sys::path& rhs) const
+{
+	return compare(rhs) <= 0;
+}
+
+bool sys::path::operator>(const sys::path& rhs) const
+{
+	return compare(rhs) > 0;
+}
+
+bool sys::path::operator>=(const sys::path& rhs) const
+{
+	return compare(rhs) >= 0;
+}
+
 sys::path sys::path::root_path(void) const
 {
 	path temp(root_name());
@@ -480,9 +592,9 @@ sys::path sys::path::absolute(const path& base) const
 	if (empty())
 		return abs_base;
 	
-	path root_name(root_name());
+	path root_name(this->root_name());
 	path base_root_name(abs_base.root_name());
-	path root_directory(root_directory());
+	path root_directory(this->root_directory());
 
 	if (!root_name.empty())
 	{
@@ -687,7 +799,7 @@ bool sys::path::create(void) const
 
 bool sys::path::create_all(void) const
 {
-	path filename(filename());
+	path filename(this->filename());
 
 	if (filename.native().size() == 1 && filename.native()[0] == '.')
 		return parent_path().create_all();
@@ -994,4 +1106,4 @@ void sys::path::iterator::decrement(void)
 	element_.pathname_ = path_ptr_->pathname_.substr(pos_, end_pos - pos_);
 	if (element_.pathname_ == preferred_separator_string)
 		element_.pathname_ = separator_string;
-}
+}
\ No newline at end of file
@@ -1,11 +1,14 @@
 #ifndef __SYS_PATH__
 #define __SYS_PATH__
 
+#include <cstdint>
 #include <iterator>
 #include <string>
 
 namespace sys
 {
+	class thread_group;
+
 	typedef enum
 	{
 		status_error, file_not_found, regular_file, directory_file,
@@ -49,6 +52,15 @@ namespace sys
 		bool equal(const char* rhs) const;
 		bool equal(const std::string& rhs) const;
 		bool equal(const path& rhs) const;
+		// compares components the way the iterator splits them: repeated
+		// separators, "." and trailing separators are ignored, and a
+		// separator orders before any other character, so "/a/b" < "/a-b"
+		int compare(const path& rhs) const;
+		void swap(path& other);
+		// appends the form compare() orders by, with separator as the only
+		// separator; plain byte order on it is compare() order
+		static void append_key(std::string& key, const char* str,
+			std::string::size_type size);
 	public:
 		path& operator=(const char* str);
 		path& operator=(const std::string& str);
@@ -63,6 +75,10 @@ namespace sys
 		bool operator!=(const char* rhs) const;
 		bool operator!=(const std::string& rhs) const;
 		bool operator!=(const path& rhs) const;
+		bool operator<(const path& rhs) const;
+		bool operator<=(const path& rhs) const;
+		bool operator>(const path& rhs) const;
+		bool operator>=(const path& rhs) const;
 	public:
 		path root_path(void) const;
 		path root_name(void) const;
@@ -95,7 +111,9 @@ namespace sys
 		const std::string& native(void) const;
 		const char* c_str(void) const;
 		std::string::size_type size(void) const;
+		// status() does not follow a final symlink, target_status() does
 		file_type_t status(void) const;
+		file_type_t target_status(void) const;
 	public:
 		class iterator;
 		iterator begin() const;
@@ -105,6 +123,8 @@ namespace sys
 		bool create(void) const;
 		bool create_all(void) const;
 		bool remove(void) const;
+		std::uintmax_t remove_all(int& error) const;
+		std::uintmax_t remove_all(thread_group& group, int& error) const;
 	private:
 		std::string::size_type parent_path_end(void) const;
 		std::string::size_type append_separator_if_needed(void);
@@ -122,6 +142,8 @@ namespace sys
 		static bool is_symlink(const file_type_t& f);
 		static path read_symlink(const path& p, bool& err);
 		static file_type_t symlink_status(const path& p, bool& err);
+	private:
+		class key_reader;
 	private:
 		static const path initial_path;
 	};
@@ -0,0 +1,71 @@
+#include "sys.config.h"
+#include "sys.pipeline.h"
+
+#include <algorithm>
+#include <thread>
+
+static const std::size_t default_capacity = 1024;
+
+sys::pipeline::pipeline(sys::thread_group& group)
+	: pipeline(group, default_capacity)
+{
+}
+
+sys::pipeline::pipeline(sys::thread_group& group, std::size_t capacity)
+	: group_(group)
+	, capacity_(std::max<std::size_t>(2, capacity))
+	, cancelled_(false)
+{
+}
+
+sys::pipeline::~pipeline(void)
+{
+}
+
+void sys::pipeline::add(std::size_t threads, std::function<void(void)>&& work,
+	sys::channel_base* output)
+{
+	stages_.push_back(std::make_unique<stage_state>());
+	stages_.back()->threads = std::max<std::size_t>(1, threads);
+	stages_.back()->work = std::move(work);
+	stages_.back()->output = output;
+}
+
+void sys::pipeline::run(void)
+{
+	std::vector<std::thread::id> threads;
+	for (auto& s : stages_)
+		s->running.store(s->threads, std::memory_order_relaxed);
+	for (auto& s : stages_)
+	{
+		stage_state* state = s.get();
+		for (std::size_t i = 0; i < state->threads; ++i)
+		{
+			threads.push_back(group_.create([state]() {
+				state->work();
+				if (state->running.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+						state->output != nullptr)
+					state->output->close();
+			}));
+		}
+	}
+	for (std::thread::id id : threads)
+	{
+		if (std::jthread t = group_.remove(id); t.joinable())
+			t.join();
+	}
+}
+
+// closing every channel unblocks all stages; items still queued are
+// dropped by the readers
+void sys::pipeline::cancel(void)
+{
+	cancelled_.store(true, std::memory_order_release);
+	for (auto& c : channels_)
+		c->close();
+}
+
+bool sys::pipeline::cancelled(void) const
+{
+	return cancelled_.load(std::memory_order_acquire);
+}
\ No newline at end of file
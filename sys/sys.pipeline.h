@@ -0,0 +1,113 @@
+#ifndef __SYS_PIPELINE__
+#define __SYS_PIPELINE__
+
+#include "sys.config.h"
+#include "sys.channel.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_group.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace sys
+{
+	// stages are joined by bounded channels, so a slow stage holds back the
+	// ones before it; when every thread of a stage has returned its output
+	// is closed, which ends the next stage in turn
+	class pipeline : public noncopyable
+	{
+		struct stage_state
+		{
+			std::size_t threads = 1;
+			std::function<void(void)> work;
+			channel_base* output = nullptr;
+			std::atomic<std::size_t> running{ 0 };
+		};
+	private:
+		thread_group& group_;
+		std::size_t capacity_;
+		std::vector<std::unique_ptr<channel_base>> channels_;
+		std::vector<std::unique_ptr<stage_state>> stages_;
+		std::atomic<bool> cancelled_;
+	private:
+		static const std::size_t batch_size = 16;
+	public:
+		pipeline(thread_group& group);
+		pipeline(thread_group& group, std::size_t capacity);
+		virtual ~pipeline(void);
+	public:
+		// f(channel<Out>&) produces items until it returns
+		template<class Out, class Function>
+		channel<Out>& source(std::size_t threads, Function f);
+		// f(In&, channel<Out>&) may push any number of items per input
+		template<class In, class Out, class Function>
+		channel<Out>& stage(channel<In>& input, std::size_t threads, Function f);
+		// f(In&)
+		template<class In, class Function>
+		void sink(channel<In>& input, std::size_t threads, Function f);
+	public:
+		// runs every stage to the end of its input; a pipeline runs once
+		void run(void);
+		void cancel(void);
+		bool cancelled(void) const;
+	private:
+		void add(std::size_t threads, std::function<void(void)>&& work,
+			channel_base* output);
+		template<class T>
+		channel<T>& make_channel(void);
+		template<class In, class Function>
+		void drain(channel<In>& input, Function& f);
+	};
+
+	template<class T>
+	channel<T>& pipeline::make_channel(void)
+	{
+		channels_.push_back(std::make_unique<channel<T>>(capacity_));
+		return static_cast<channel<T>&>(*channels_.back());
+	}
+
+	template<class In, class Function>
+	void pipeline::drain(channel<In>& input, Function& f)
+	{
+		std::vector<In> items(batch_size);
+		for (;;)
+		{
+			const std::size_t count = input.pop(std::span<In>(items));
+			if (count == 0)
+				break;
+			for (std::size_t i = 0; i < count && !cancelled(); ++i)
+				f(items[i]);
+		}
+	}
+
+	template<class Out, class Function>
+	channel<Out>& pipeline::source(std::size_t threads, Function f)
+	{
+		channel<Out>& output = make_channel<Out>();
+		add(threads, [f, &output]() mutable { f(output); }, &output);
+		return output;
+	}
+
+	template<class In, class Out, class Function>
+	channel<Out>& pipeline::stage(channel<In>& input, std::size_t threads, Function f)
+	{
+		channel<Out>& output = make_channel<Out>();
+		add(threads, [this, f, &input, &output]() mutable {
+			auto forward = [&f, &output](In& item) { f(item, output); };
+			drain(input, forward);
+		}, &output);
+		return output;
+	}
+
+	template<class In, class Function>
+	void pipeline::sink(channel<In>& input, std::size_t threads, Function f)
+	{
+		add(threads, [this, f, &input]() mutable { drain(input, f); }, nullptr);
+	}
+}
+
+#endif
+
@@ -0,0 +1,179 @@
+#include "sys.config.h"
+#include "sys.path.h"
+#include "sys.parallel_walker.h"
+#include "sys.thread_group.h"
+#include "sys.walker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <thread>
+#include <vector>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#endif
+
+static bool remove_entry(const sys::walk_entry& entry, int& error)
+{
+	const bool is_dir = entry.type == sys::directory_file;
+#if defined(SYS_WIN32)
+	const BOOL removed = is_dir ?
+		::RemoveDirectoryA(entry.path) : ::DeleteFileA(entry.path);
+	if (!removed)
+		error = static_cast<int>(::GetLastError());
+	return removed != FALSE;
+#else
+	const char* name = entry.dirfd == AT_FDCWD ?
+		entry.path : entry.path + entry.name_pos;
+	if (::unlinkat(entry.dirfd, name, is_dir ? AT_REMOVEDIR : 0) != 0)
+	{
+		error = errno;
+		return false;
+	}
+	return true;
+#endif
+}
+
+static bool remove_root(const sys::path& p, sys::file_type_t type, int& error)
+{
+#if defined(SYS_WIN32)
+	const BOOL removed = type == sys::directory_file ?
+		::RemoveDirectoryA(p.c_str()) : ::DeleteFileA(p.c_str());
+	if (!removed)
+		error = static_cast<int>(::GetLastError());
+	return removed != FALSE;
+#else
+	if ((type == sys::directory_file ?
+			::rmdir(p.c_str()) : ::unlink(p.c_str())) != 0)
+	{
+		error = errno;
+		return false;
+	}
+	return true;
+#endif
+}
+
+namespace
+{
+	class remove_visitor : public sys::walk_visitor
+	{
+		struct alignas(64) counter
+		{
+			std::uintmax_t removed = 0;
+		};
+
+		std::vector<counter> counters_;
+		std::atomic<int> error_;
+	public:
+		remove_visitor(std::size_t workers)
+			: counters_(workers)
+			, error_(0)
+		{
+		}
+
+		sys::walk_action_t visit(const sys::walk_entry& entry,
+			std::size_t worker) override
+		{
+			int err = 0;
+			if (remove_entry(entry, err))
+				++counters_[worker].removed;
+			else
+				set_error(err);
+			return sys::walk_continue;
+		}
+
+		void set_error(int err)
+		{
+			int expected = 0;
+			error_.compare_exchange_strong(expected, err);
+		}
+
+		std::uintmax_t removed(void) const
+		{
+			std::uintmax_t count = 0;
+			for (const counter& c : counters_)
+				count += c.removed;
+			return count;
+		}
+
+		int error(void) const
+		{
+			return error_.load();
+		}
+	};
+}
+
+std::uintmax_t sys::path::remove_all(int& error) const
+{
+	error = 0;
+	bool err(false);
+	const file_type_t type = symlink_status(*this, err);
+	if (type == file_not_found)
+		return 0;
+	if (err)
+	{
+		error = errno;
+		return 0;
+	}
+
+	std::uintmax_t count = 0;
+	if (type == directory_file)
+	{
+		walk_options options;
+		options.order = walk_post_order;
+		walker w(*this, options);
+		w.walk([&count, &error](const walk_entry& entry) {
+			int err = 0;
+			if (remove_entry(entry, err))
+				++count;
+			else if (error == 0)
+				error = err;
+			return walk_continue;
+		});
+		if (error == 0)
+			error = w.error();
+	}
+
+	int err_root = 0;
+	if (remove_root(*this, type, err_root))
+		++count;
+	else if (error == 0)
+		error = err_root;
+	return count;
+}
+
+std::uintmax_t sys::path::remove_all(sys::thread_group& group, int& error) const
+{
+	error = 0;
+	bool err(false);
+	const file_type_t type = symlink_status(*this, err);
+	if (type == file_not_found)
+		return 0;
+	if (err)
+	{
+		error = errno;
+		return 0;
+	}
+
+	std::uintmax_t count = 0;
+	if (type == directory_file)
+	{
+		parallel_walk_options options;
+		options.order = walk_post_order;
+		if (options.threads == 0)
+			options.threads = std::max(1u, std::thread::hardware_concurrency());
+		parallel_walker w(*this, options);
+		remove_visitor visitor(options.threads);
+		w.walk(group, visitor);
+		count = visitor.removed();
+		error = visitor.error() != 0 ? visitor.error() : w.error();
+	}
+
+	int err_root = 0;
+	if (remove_root(*this, type, err_root))
+		++count;
+	else if (error == 0)
+		error = err_root;
+	return count;
+}
\ No newline at end of file
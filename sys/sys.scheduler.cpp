@@ -0,0 +1,299 @@
+#include "sys.config.h"
+#include "sys.scheduler.h"
+
+#include <algorithm>
+
+// fair shares are kept in virtual nanoseconds scaled by this over weight
+static const std::uint64_t fair_scale = 1024;
+
+struct sys::scheduler::class_state
+{
+	class_options options;
+	std::deque<entry> fifo;
+	std::vector<entry> heap;
+	std::map<tenant_id, tenant> tenants;
+	std::set<std::pair<std::uint64_t, tenant_id>> active;
+	std::uint64_t vtime = 0;
+	std::size_t queued = 0;
+	std::size_t running = 0;
+	std::uint64_t completed = 0;
+	latency_histogram wait;
+};
+
+namespace
+{
+	// std heaps keep the largest on top, so the order is reversed to get
+	// the earliest deadline there
+	template<class Entry>
+	bool later(const Entry& a, const Entry& b)
+	{
+		if (a.deadline != b.deadline)
+			return a.deadline > b.deadline;
+		return a.sequence > b.sequence;
+	}
+}
+
+sys::scheduler::scheduler(sys::thread_pool& pool)
+	: scheduler(pool, scheduler_options())
+{
+}
+
+sys::scheduler::scheduler(sys::thread_pool& pool, const sys::scheduler_options& options)
+	: pool_(pool)
+	, options_(options)
+	, tokens_(0)
+	, running_(0)
+	, queued_(0)
+	, sequence_(0)
+{
+}
+
+sys::scheduler::~scheduler(void)
+{
+	auto idle = [this]() { return tokens_ == 0 && running_ == 0 && queued_ == 0; };
+	if (pool_.in_worker())
+	{
+		pool_.wait([this, &idle]() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return idle();
+		});
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		idle_.wait(lock, idle);
+	}
+}
+
+sys::scheduler::class_id sys::scheduler::add_class(const sys::class_options& options)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	classes_.push_back(std::make_unique<class_state>());
+	classes_.back()->options = options;
+	return classes_.size() - 1;
+}
+
+void sys::scheduler::set_weight(class_id c, tenant_id t, unsigned weight)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	classes_[c]->tenants[t].weight = std::max(1u, weight);
+}
+
+void sys::scheduler::post(class_id c, function_type f)
+{
+	entry e;
+	e.f = std::move(f);
+	e.queued = std::chrono::steady_clock::now();
+	e.deadline = e.queued + classes_[c]->options.default_deadline;
+	push(c, std::move(e));
+}
+
+void sys::scheduler::post(class_id c, time_point deadline, function_type f)
+{
+	entry e;
+	e.f = std::move(f);
+	e.queued = std::chrono::steady_clock::now();
+	e.deadline = deadline;
+	push(c, std::move(e));
+}
+
+void sys::scheduler::post(class_id c, tenant_id t, function_type f)
+{
+	entry e;
+	e.f = std::move(f);
+	e.queued = std::chrono::steady_clock::now();
+	e.deadline = e.queued + classes_[c]->options.default_deadline;
+	e.tenant = t;
+	push(c, std::move(e));
+}
+
+std::size_t sys::scheduler::queued(class_id c) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return classes_[c]->queued;
+}
+
+std::vector<sys::scheduler_class_stats> sys::scheduler::statistics(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<scheduler_class_stats> result(classes_.size());
+	for (std::size_t i = 0; i < classes_.size(); ++i)
+	{
+		result[i].queued = classes_[i]->queued;
+		result[i].running = classes_[i]->running;
+		result[i].completed = classes_[i]->completed;
+		result[i].wait = classes_[i]->wait.snapshot();
+	}
+	return result;
+}
+
+void sys::scheduler::push(class_id id, entry&& e)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	class_state& c = *classes_[id];
+	e.sequence = sequence_++;
+	switch (c.options.policy)
+	{
+	case policy_fifo:
+		c.fifo.push_back(std::move(e));
+		break;
+	case policy_deadline:
+		c.heap.push_back(std::move(e));
+		std::push_heap(c.heap.begin(), c.heap.end(), later<entry>);
+		break;
+	case policy_fair:
+	{
+		// a tenant coming back from idle starts at the current virtual
+		// time instead of cashing in the time it was away
+		tenant& t = c.tenants[e.tenant];
+		if (t.tasks.empty())
+		{
+			t.vtime = std::max(t.vtime, c.vtime);
+			c.active.emplace(t.vtime, e.tenant);
+		}
+		t.tasks.push_back(std::move(e));
+		break;
+	}
+	}
+	++c.queued;
+	++queued_;
+	dispatch(lock);
+}
+
+// keeps one dispatch task in the pool per task that could start now, up
+// to the number of workers
+void sys::scheduler::dispatch(std::unique_lock<std::mutex>& lock)
+{
+	std::size_t runnable = 0;
+	for (auto& c : classes_)
+	{
+		std::size_t n = c->queued;
+		if (c->options.max_running != 0)
+			n = std::min(n, c->options.max_running > c->running ?
+				c->options.max_running - c->running : 0);
+		runnable += n;
+	}
+	const std::size_t wanted = std::min(runnable, pool_.size());
+	if (wanted <= tokens_)
+		return;
+	const std::size_t count = wanted - tokens_;
+	tokens_ += count;
+	lock.unlock();
+	for (std::size_t i = 0; i < count; ++i)
+		pool_.post([this]() { run_one(); });
+	lock.lock();
+}
+
+sys::scheduler::class_state* sys::scheduler::pick(time_point now)
+{
+	class_state* best = nullptr;
+	std::int64_t best_rank = 0;
+	time_point best_head;
+	for (auto& c : classes_)
+	{
+		if (c->queued == 0 ||
+				(c->options.max_running != 0 && c->running >= c->options.max_running))
+			continue;
+
+		time_point head;
+		switch (c->options.policy)
+		{
+		case policy_fifo:
+			head = c->fifo.front().queued;
+			break;
+		case policy_deadline:
+			head = c->heap.front().queued;
+			break;
+		case policy_fair:
+			head = c->tenants[c->active.begin()->second].tasks.front().queued;
+			break;
+		}
+
+		std::int64_t rank = c->options.priority;
+		if (options_.aging.count() > 0)
+			rank += static_cast<std::int64_t>((now - head) / options_.aging);
+		if (best == nullptr || rank > best_rank || (rank == best_rank && head < best_head))
+		{
+			best = c.get();
+			best_rank = rank;
+			best_head = head;
+		}
+	}
+	return best;
+}
+
+sys::scheduler::entry sys::scheduler::pop(class_state& c)
+{
+	entry e;
+	switch (c.options.policy)
+	{
+	case policy_fifo:
+		e = std::move(c.fifo.front());
+		c.fifo.pop_front();
+		break;
+	case policy_deadline:
+		std::pop_heap(c.heap.begin(), c.heap.end(), later<entry>);
+		e = std::move(c.heap.back());
+		c.heap.pop_back();
+		break;
+	case policy_fair:
+	{
+		// charged its usual run time up front, so that several workers
+		// picking at once spread over the tenants
+		const tenant_id id = c.active.begin()->second;
+		c.active.erase(c.active.begin());
+		tenant& t = c.tenants[id];
+		e = std::move(t.tasks.front());
+		t.tasks.pop_front();
+		c.vtime = t.vtime;
+		t.vtime += t.cost * fair_scale / t.weight;
+		if (!t.tasks.empty())
+			c.active.emplace(t.vtime, id);
+		break;
+	}
+	}
+	--c.queued;
+	--queued_;
+	return e;
+}
+
+void sys::scheduler::run_one(void)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	--tokens_;
+	const time_point now = std::chrono::steady_clock::now();
+	class_state* c = pick(now);
+	if (c == nullptr)
+	{
+		if (running_ == 0 && queued_ == 0 && tokens_ == 0)
+			idle_.notify_all();
+		return;
+	}
+
+	entry e = pop(*c);
+	++c->running;
+	++running_;
+	c->wait.record(static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(now - e.queued).count()));
+	lock.unlock();
+
+	const time_point start = std::chrono::steady_clock::now();
+	e.f();
+	e.f = nullptr;
+	const std::uint64_t elapsed = static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count());
+
+	lock.lock();
+	--c->running;
+	--running_;
+	++c->completed;
+	if (c->options.policy == policy_fair)
+	{
+		tenant& t = c->tenants[e.tenant];
+		t.cost = std::max<std::uint64_t>(1, (t.cost * 7 + elapsed) / 8);
+	}
+	dispatch(lock);
+	if (running_ == 0 && queued_ == 0 && tokens_ == 0)
+		idle_.notify_all();
+}
\ No newline at end of file
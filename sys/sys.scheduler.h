@@ -0,0 +1,121 @@
+#ifndef __SYS_SCHEDULER__
+#define __SYS_SCHEDULER__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_pool.h"
+#include "sys.thread_stats.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace sys
+{
+	typedef enum
+	{
+		policy_fifo, policy_deadline, policy_fair
+	} scheduling_policy_t;
+
+	struct class_options
+	{
+		// higher runs first
+		int priority = 0;
+		scheduling_policy_t policy = policy_fifo;
+		// workers the class may hold at once, 0 for all of them
+		std::size_t max_running = 0;
+		// for tasks posted to a deadline class without one
+		std::chrono::nanoseconds default_deadline = std::chrono::seconds(1);
+	};
+
+	struct scheduler_options
+	{
+		// a class whose next task has waited this long ranks one level
+		// higher, and one more for every further step; 0 turns it off
+		std::chrono::nanoseconds aging = std::chrono::seconds(1);
+	};
+
+	struct scheduler_class_stats
+	{
+		std::size_t queued = 0;
+		std::size_t running = 0;
+		std::uint64_t completed = 0;
+		// nanoseconds from post to start
+		histogram_snapshot wait;
+	};
+
+	// puts tasks in classes in front of a thread_pool. The pool only ever
+	// holds one dispatch task per idle worker, and each picks the best
+	// task when it starts: classes by priority, and inside a class first
+	// in first out, earliest deadline first, or weighted fair between
+	// tenants by their measured run time.
+	class scheduler : public noncopyable
+	{
+	public:
+		typedef std::size_t class_id;
+		typedef std::uint32_t tenant_id;
+		typedef std::function<void(void)> function_type;
+		typedef std::chrono::steady_clock::time_point time_point;
+	private:
+		struct entry
+		{
+			function_type f;
+			time_point queued;
+			time_point deadline;
+			tenant_id tenant = 0;
+			std::uint64_t sequence = 0;
+		};
+
+		struct tenant
+		{
+			std::deque<entry> tasks;
+			unsigned weight = 1;
+			std::uint64_t vtime = 0;
+			std::uint64_t cost = 1000;
+		};
+
+		struct class_state;
+	private:
+		thread_pool& pool_;
+		scheduler_options options_;
+		std::vector<std::unique_ptr<class_state>> classes_;
+		mutable std::mutex mutex_;
+		std::condition_variable idle_;
+		std::size_t tokens_;
+		std::size_t running_;
+		std::size_t queued_;
+		std::uint64_t sequence_;
+	public:
+		scheduler(thread_pool& pool);
+		scheduler(thread_pool& pool, const scheduler_options& options);
+		// runs everything still queued first
+		virtual ~scheduler(void);
+	public:
+		class_id add_class(const class_options& options);
+		void set_weight(class_id c, tenant_id t, unsigned weight);
+	public:
+		void post(class_id c, function_type f);
+		void post(class_id c, time_point deadline, function_type f);
+		void post(class_id c, tenant_id t, function_type f);
+	public:
+		std::size_t queued(class_id c) const;
+		std::vector<scheduler_class_stats> statistics(void) const;
+	private:
+		void push(class_id c, entry&& e);
+		void dispatch(std::unique_lock<std::mutex>& lock);
+		class_state* pick(time_point now);
+		entry pop(class_state& c);
+		void run_one(void);
+	};
+}
+
+#endif
+
@@ -0,0 +1,364 @@
+#include "sys.config.h"
+#include "sys.sort_paths.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const std::size_t radix_buckets = 258;
+static const std::size_t insertion_threshold = 32;
+static const std::size_t parallel_threshold = 1 << 18;
+static const std::size_t duplicate = static_cast<std::size_t>(-1);
+
+namespace
+{
+	// 0 ends the string, 1 is any separator, other bytes follow in order
+	struct rank_table
+	{
+		std::uint16_t rank[256];
+
+		rank_table(void)
+		{
+			for (int c = 0; c < 256; ++c)
+				rank[c] = static_cast<std::uint16_t>(c + 2);
+			for (const char* s = sys::path::separators; *s != '\0'; ++s)
+				rank[static_cast<unsigned char>(*s)] = 1;
+		}
+	};
+
+	const rank_table ranks;
+
+	struct sort_item
+	{
+		const char* data;
+		std::size_t size;
+		std::size_t index;
+	};
+
+	struct sort_range
+	{
+		std::size_t begin;
+		std::size_t size;
+		std::size_t depth;
+	};
+
+	inline std::size_t key(const sort_item& item, std::size_t depth)
+	{
+		return depth < item.size ?
+			ranks.rank[static_cast<unsigned char>(item.data[depth])] : 0;
+	}
+
+	int compare(const sort_item& lhs, const sort_item& rhs, std::size_t depth)
+	{
+		const std::size_t size = std::min(lhs.size, rhs.size);
+		for (std::size_t i = depth; i < size; ++i)
+		{
+			const std::size_t l = ranks.rank[static_cast<unsigned char>(lhs.data[i])];
+			const std::size_t r = ranks.rank[static_cast<unsigned char>(rhs.data[i])];
+			if (l != r)
+				return l < r ? -1 : 1;
+		}
+		if (lhs.size == rhs.size)
+			return 0;
+		return lhs.size < rhs.size ? -1 : 1;
+	}
+
+	void insertion_sort(sort_item* a, std::size_t n, std::size_t depth)
+	{
+		for (std::size_t i = 1; i < n; ++i)
+		{
+			const sort_item item = a[i];
+			std::size_t j = i;
+			for (; j > 0 && compare(item, a[j - 1], depth) < 0; --j)
+				a[j] = a[j - 1];
+			a[j] = item;
+		}
+		for (std::size_t i = n; i > 1; --i)
+			if (compare(a[i - 1], a[i - 2], depth) == 0)
+				a[i - 1].index = duplicate;
+	}
+
+	void msd_sort(sort_item* a, sort_item* tmp, std::size_t n, std::size_t depth)
+	{
+		for (;;)
+		{
+			if (n <= insertion_threshold)
+			{
+				insertion_sort(a, n, depth);
+				return;
+			}
+
+			std::size_t count[radix_buckets] = {};
+			for (std::size_t i = 0; i < n; ++i)
+				++count[key(a[i], depth)];
+
+			const std::size_t only = key(a[0], depth);
+			if (count[only] == n)
+			{
+				if (only == 0)
+				{
+					for (std::size_t i = 1; i < n; ++i)
+						a[i].index = duplicate;
+					return;
+				}
+				++depth;
+				continue;
+			}
+
+			std::size_t offset[radix_buckets];
+			for (std::size_t b = 0, sum = 0; b < radix_buckets; ++b)
+			{
+				offset[b] = sum;
+				sum += count[b];
+			}
+			for (std::size_t i = 0; i < n; ++i)
+				tmp[offset[key(a[i], depth)]++] = a[i];
+			std::copy(tmp, tmp + n, a);
+
+			for (std::size_t i = 1; i < count[0]; ++i)
+				a[i].index = duplicate;
+
+			// only buckets smaller than the largest recurse, so the stack
+			// grows with log n rather than with the path length
+			std::size_t largest = 1;
+			std::size_t largest_pos = count[0];
+			for (std::size_t b = 1, pos = count[0]; b < radix_buckets; pos += count[b++])
+			{
+				if (count[b] > count[largest])
+				{
+					largest = b;
+					largest_pos = pos;
+				}
+			}
+			for (std::size_t b = 1, pos = count[0]; b < radix_buckets; pos += count[b++])
+				if (b != largest && count[b] > 1)
+					msd_sort(a + pos, tmp + pos, count[b], depth + 1);
+			if (count[largest] < 2)
+				return;
+			a += largest_pos;
+			tmp += largest_pos;
+			n = count[largest];
+			++depth;
+		}
+	}
+
+	template<class Function>
+	void parallel_chunks(sys::thread_group& group, std::size_t threads,
+		std::size_t n, Function f)
+	{
+		const std::size_t chunk = (n + threads - 1) / threads;
+		group.run(threads, [&](std::size_t i) {
+			const std::size_t begin = std::min(n, i * chunk);
+			f(i, begin, std::min(n, begin + chunk));
+		});
+	}
+
+	std::size_t common_prefix(sys::thread_group& group, std::size_t threads,
+		const sort_item* a, std::size_t n, std::size_t depth)
+	{
+		std::vector<std::size_t> lengths(threads, static_cast<std::size_t>(-1));
+		parallel_chunks(group, threads, n,
+			[&](std::size_t t, std::size_t begin, std::size_t end) {
+				std::size_t length = a[0].size - std::min(a[0].size, depth);
+				for (std::size_t i = begin; i < end && length > 0; ++i)
+				{
+					std::size_t j = 0;
+					const std::size_t limit = std::min(length,
+						a[i].size - std::min(a[i].size, depth));
+					while (j < limit && key(a[i], depth + j) == key(a[0], depth + j))
+						++j;
+					length = j;
+				}
+				lengths[t] = length;
+			});
+		return *std::min_element(lengths.begin(), lengths.end());
+	}
+
+	void parallel_partition(sys::thread_group& group, std::size_t threads,
+		sort_item* a, sort_item* tmp, std::size_t n, std::size_t depth,
+		std::size_t* total)
+	{
+		std::vector<std::array<std::size_t, radix_buckets>> counts(threads);
+		parallel_chunks(group, threads, n,
+			[&](std::size_t t, std::size_t begin, std::size_t end) {
+				counts[t].fill(0);
+				for (std::size_t i = begin; i < end; ++i)
+					++counts[t][key(a[i], depth)];
+			});
+
+		std::size_t sum = 0;
+		for (std::size_t b = 0; b < radix_buckets; ++b)
+		{
+			total[b] = 0;
+			for (std::size_t t = 0; t < threads; ++t)
+			{
+				const std::size_t c = counts[t][b];
+				counts[t][b] = sum;
+				sum += c;
+				total[b] += c;
+			}
+		}
+
+		parallel_chunks(group, threads, n,
+			[&](std::size_t t, std::size_t begin, std::size_t end) {
+				for (std::size_t i = begin; i < end; ++i)
+					tmp[counts[t][key(a[i], depth)]++] = a[i];
+			});
+		parallel_chunks(group, threads, n,
+			[&](std::size_t, std::size_t begin, std::size_t end) {
+				std::copy(tmp + begin, tmp + end, a + begin);
+			});
+	}
+
+	// items point at the path::append_key() form of each path, so the sort
+	// and the dedupe see components the way path::compare() does
+	template<class Source>
+	void make_items(sys::thread_group& group, std::size_t n, Source source,
+		std::vector<std::string>& keys, std::vector<sort_item>& items)
+	{
+		const std::size_t threads = std::max<std::size_t>(1,
+			std::min<std::size_t>(std::thread::hardware_concurrency(), n / 4096));
+		keys.resize(threads);
+		items.resize(n);
+		auto build = [&](std::size_t t, std::size_t begin, std::size_t end) {
+			std::string& key = keys[t];
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				const std::string_view s(source(i));
+				const std::size_t start = key.size();
+				sys::path::append_key(key, s.data(), s.size());
+				items[i] = { nullptr, key.size() - start, start };
+			}
+			// the string is done growing, so the offsets can become pointers
+			for (std::size_t i = begin; i < end; ++i)
+				items[i] = { key.data() + items[i].index, items[i].size, i };
+		};
+		if (threads > 1)
+			parallel_chunks(group, threads, n, build);
+		else
+			build(0, 0, n);
+	}
+
+	void sort_items(std::vector<sort_item>& items, sys::thread_group& group)
+	{
+		const std::size_t n = items.size();
+		if (n < 2)
+			return;
+
+		const std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+		const std::size_t large = std::max(parallel_threshold, n / threads);
+		std::vector<sort_item> tmp(n);
+		std::vector<sort_range> pending(1, { 0, n, 0 });
+		std::vector<sort_range> ready;
+
+		// split the big ranges with all threads, then hand out the rest
+		while (!pending.empty())
+		{
+			sort_range r = pending.back();
+			pending.pop_back();
+			if (threads == 1 || r.size < large)
+			{
+				ready.push_back(r);
+				continue;
+			}
+
+			sort_item* a = items.data() + r.begin;
+			r.depth += common_prefix(group, threads, a, r.size, r.depth);
+			std::size_t total[radix_buckets];
+			parallel_partition(group, threads, a, tmp.data() + r.begin,
+				r.size, r.depth, total);
+
+			for (std::size_t i = 1; i < total[0]; ++i)
+				a[i].index = duplicate;
+			for (std::size_t b = 1, pos = total[0]; b < radix_buckets; pos += total[b++])
+				if (total[b] > 1)
+					pending.push_back({ r.begin + pos, total[b], r.depth + 1 });
+		}
+
+		std::sort(ready.begin(), ready.end(),
+			[](const sort_range& lhs, const sort_range& rhs) {
+				return lhs.size > rhs.size;
+			});
+		std::atomic<std::size_t> next(0);
+		auto sort_ready = [&](std::size_t) {
+			for (std::size_t i = next++; i < ready.size(); i = next++)
+				msd_sort(items.data() + ready[i].begin, tmp.data() + ready[i].begin,
+					ready[i].size, ready[i].depth);
+		};
+		if (threads == 1 || ready.size() == 1)
+			sort_ready(0);
+		else
+			group.run(std::min(threads, ready.size()), sort_ready);
+
+		items.erase(std::remove_if(items.begin(), items.end(),
+			[](const sort_item& item) { return item.index == duplicate; }), items.end());
+	}
+}
+
+std::size_t sys::sort_paths(std::span<sys::path> paths, sys::thread_group& group)
+{
+	std::vector<std::string> keys;
+	std::vector<sort_item> items;
+	make_items(group, paths.size(), [&paths](std::size_t i) {
+		return std::string_view(paths[i].c_str(), paths[i].size());
+	}, keys, items);
+	sort_items(items, group);
+
+	const std::size_t n = items.size();
+	const std::size_t threads = std::max<std::size_t>(1,
+		std::min<std::size_t>(std::thread::hardware_concurrency(), n / 4096));
+	std::vector<path> sorted(n);
+	auto gather = [&](std::size_t, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			sorted[i].swap(paths[items[i].index]);
+	};
+	auto scatter = [&](std::size_t, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			paths[i].swap(sorted[i]);
+	};
+	if (threads > 1)
+	{
+		parallel_chunks(group, threads, n, gather);
+		parallel_chunks(group, threads, n, scatter);
+	}
+	else
+	{
+		gather(0, 0, n);
+		scatter(0, 0, n);
+	}
+	return n;
+}
+
+std::size_t sys::sort_paths(std::span<std::string_view> paths,
+	sys::thread_group& group)
+{
+	std::vector<std::string> keys;
+	std::vector<sort_item> items;
+	make_items(group, paths.size(), [&paths](std::size_t i) { return paths[i]; },
+		keys, items);
+	sort_items(items, group);
+
+	// the duplicates' slots complete the permutation, which is then
+	// applied cycle by cycle without a second copy of the views
+	const std::size_t n = items.size();
+	std::vector<std::size_t> order(paths.size(), duplicate);
+	for (std::size_t i = 0; i < n; ++i)
+		order[items[i].index] = i;
+	for (std::size_t i = 0, next = n; i < order.size(); ++i)
+		if (order[i] == duplicate)
+			order[i] = next++;
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		while (order[i] != i)
+		{
+			const std::size_t j = order[i];
+			std::swap(paths[i], paths[j]);
+			std::swap(order[i], order[j]);
+		}
+	}
+	return n;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef __SYS_SORT_PATHS__
+#define __SYS_SORT_PATHS__
+
+#include "sys.config.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <span>
+#include <string_view>
+
+namespace sys
+{
+	// sorts in path::compare order and moves the unique paths to the
+	// front; returns how many there are. Spellings compare() treats as
+	// equal, such as "/a//b" and "/a/b/", count as one path. The
+	// string_view form reorders the views in place, so it also serves
+	// columnar or front-coded stores that hand out views into them.
+	std::size_t sort_paths(std::span<path> paths, thread_group& group);
+	std::size_t sort_paths(std::span<std::string_view> paths, thread_group& group);
+}
+
+#endif
+
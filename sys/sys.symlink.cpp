@@ -195,4 +195,41 @@ sys::file_type_t sys::path::symlink_status(const sys::path& p, bool& err)
 		return sys::socket_file;
 	return sys::type_unknown;
 #endif
+}
+
+sys::file_type_t sys::path::target_status(void) const
+{
+#if defined(SYS_WIN32)
+	HANDLE h(::CreateFileA(c_str(), 0,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0,
+		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0));
+	if (h == INVALID_HANDLE_VALUE)
+		return not_found_error(::GetLastError()) ?
+			sys::file_not_found : sys::status_error;
+	BY_HANDLE_FILE_INFORMATION info;
+	const BOOL ok(::GetFileInformationByHandle(h, &info));
+	::CloseHandle(h);
+	if (!ok)
+		return sys::status_error;
+	return info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ?
+		sys::directory_file : sys::regular_file;
+#else
+	struct stat path_stat;
+	if (::stat(c_str(), &path_stat) != 0)
+		return errno == ENOENT || errno == ENOTDIR ?
+			sys::file_not_found : sys::status_error;
+	if (S_ISREG(path_stat.st_mode))
+		return sys::regular_file;
+	if (S_ISDIR(path_stat.st_mode))
+		return sys::directory_file;
+	if (S_ISBLK(path_stat.st_mode))
+		return sys::block_file;
+	if (S_ISCHR(path_stat.st_mode))
+		return sys::character_file;
+	if (S_ISFIFO(path_stat.st_mode))
+		return sys::fifo_file;
+	if (S_ISSOCK(path_stat.st_mode))
+		return sys::socket_file;
+	return sys::type_unknown;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "sys.config.h"
+#include "sys.task.h"
+
+namespace
+{
+	// owns itself; the frame goes away as soon as the body returns
+	struct detached
+	{
+		struct promise_type : public sys::task_promise_base
+		{
+			detached get_return_object(void)
+			{
+				return detached{ std::coroutine_handle<promise_type>::from_promise(*this) };
+			}
+
+			std::suspend_never final_suspend(void) const noexcept
+			{
+				return {};
+			}
+
+			void return_void(void) const noexcept
+			{
+			}
+		};
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	detached run_detached(sys::task<void> t)
+	{
+		co_await t;
+	}
+}
+
+sys::executor::executor(sys::thread_pool& pool, sys::async_io& io)
+	: pool_(pool)
+	, io_(io)
+{
+}
+
+sys::executor::~executor(void)
+{
+}
+
+sys::thread_pool& sys::executor::pool(void) const
+{
+	return pool_;
+}
+
+sys::async_io& sys::executor::io(void) const
+{
+	return io_;
+}
+
+sys::executor::schedule_awaiter sys::executor::schedule(void)
+{
+	return schedule_awaiter(pool_);
+}
+
+void sys::executor::spawn(task<void> t)
+{
+	detached d = run_detached(std::move(t));
+	d.handle.promise().exec = this;
+	pool_.post([h = d.handle]() { h.resume(); });
+}
\ No newline at end of file
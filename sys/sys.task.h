@@ -0,0 +1,273 @@
+#ifndef __SYS_TASK__
+#define __SYS_TASK__
+
+#include "sys.config.h"
+#include "sys.async_file.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_pool.h"
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace sys
+{
+	class executor;
+	template<class T>
+	class task;
+
+	class task_promise_base
+	{
+		struct final_awaiter
+		{
+			bool await_ready(void) const noexcept
+			{
+				return false;
+			}
+
+			template<class Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				std::coroutine_handle<> next = h.promise().continuation;
+				return next ? next : std::noop_coroutine();
+			}
+
+			void await_resume(void) const noexcept
+			{
+			}
+		};
+	public:
+		// handed from each awaiting task to the one it awaits
+		executor* exec = nullptr;
+		std::coroutine_handle<> continuation;
+	public:
+		std::suspend_always initial_suspend(void) const noexcept
+		{
+			return {};
+		}
+
+		final_awaiter final_suspend(void) const noexcept
+		{
+			return {};
+		}
+
+		// the library does not use exceptions
+		void unhandled_exception(void) const noexcept
+		{
+			std::terminate();
+		}
+	};
+
+	template<class T>
+	class task_promise : public task_promise_base
+	{
+	public:
+		std::optional<T> value;
+	public:
+		task<T> get_return_object(void);
+
+		template<class U>
+		void return_value(U&& v)
+		{
+			value.emplace(std::forward<U>(v));
+		}
+	};
+
+	template<>
+	class task_promise<void> : public task_promise_base
+	{
+	public:
+		task<void> get_return_object(void);
+
+		void return_void(void) const noexcept
+		{
+		}
+	};
+
+	// lazy; the body starts when the task is awaited, and whoever awaits
+	// it carries on where it finished. Start the outermost one with
+	// executor::spawn() or executor::sync_wait().
+	template<class T>
+	class task
+	{
+	public:
+		typedef task_promise<T> promise_type;
+		typedef std::coroutine_handle<promise_type> handle_type;
+	private:
+		class awaiter
+		{
+			handle_type handle_;
+		public:
+			awaiter(handle_type h)
+				: handle_(h)
+			{
+			}
+		public:
+			bool await_ready(void) const noexcept
+			{
+				return !handle_ || handle_.done();
+			}
+
+			template<class Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) noexcept
+			{
+				handle_.promise().continuation = caller;
+				handle_.promise().exec = caller.promise().exec;
+				return handle_;
+			}
+
+			T await_resume(void)
+			{
+				if constexpr (!std::is_void_v<T>)
+					return std::move(*handle_.promise().value);
+			}
+		};
+	private:
+		handle_type handle_;
+	public:
+		task(void)
+			: handle_(nullptr)
+		{
+		}
+
+		explicit task(handle_type h)
+			: handle_(h)
+		{
+		}
+
+		task(task&& other) noexcept
+			: handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		task& operator=(task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle_)
+					handle_.destroy();
+				handle_ = std::exchange(other.handle_, nullptr);
+			}
+			return *this;
+		}
+
+		task(const task&) = delete;
+		task& operator=(const task&) = delete;
+
+		~task(void)
+		{
+			if (handle_)
+				handle_.destroy();
+		}
+	public:
+		bool valid(void) const
+		{
+			return static_cast<bool>(handle_);
+		}
+
+		handle_type handle(void) const
+		{
+			return handle_;
+		}
+
+		awaiter operator co_await(void) const noexcept
+		{
+			return awaiter(handle_);
+		}
+	};
+
+	template<class T>
+	task<T> task_promise<T>::get_return_object(void)
+	{
+		return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+	}
+
+	inline task<void> task_promise<void>::get_return_object(void)
+	{
+		return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+	}
+
+	// runs coroutines on the workers of a thread_pool, and through them
+	// on its thread_group; the awaitables in sys.async_fs.h find it from
+	// the task that awaits them
+	class executor : public noncopyable
+	{
+		class schedule_awaiter
+		{
+			thread_pool& pool_;
+		public:
+			schedule_awaiter(thread_pool& pool)
+				: pool_(pool)
+			{
+			}
+		public:
+			bool await_ready(void) const noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				pool_.post([h]() { h.resume(); });
+			}
+
+			void await_resume(void) const noexcept
+			{
+			}
+		};
+	private:
+		thread_pool& pool_;
+		async_io& io_;
+	public:
+		executor(thread_pool& pool, async_io& io);
+		virtual ~executor(void);
+	public:
+		thread_pool& pool(void) const;
+		async_io& io(void) const;
+	public:
+		// co_await schedule() continues on a pool worker
+		schedule_awaiter schedule(void);
+		// starts t on a worker; it runs to the end on its own
+		void spawn(task<void> t);
+		// starts t and blocks until it is done; a worker helps meanwhile
+		template<class T>
+		T sync_wait(task<T> t);
+	private:
+		template<class T>
+		static task<void> deliver(task<T> t, std::promise<T> result);
+	};
+
+	template<class T>
+	task<void> executor::deliver(task<T> t, std::promise<T> result)
+	{
+		if constexpr (std::is_void_v<T>)
+		{
+			co_await t;
+			result.set_value();
+		}
+		else
+			result.set_value(co_await t);
+	}
+
+	template<class T>
+	T executor::sync_wait(task<T> t)
+	{
+		std::promise<T> result;
+		std::future<T> future = result.get_future();
+		spawn(deliver(std::move(t), std::move(result)));
+		if (pool_.in_worker())
+		{
+			pool_.wait([&future]() {
+				return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			});
+		}
+		return future.get();
+	}
+}
+
+#endif
+
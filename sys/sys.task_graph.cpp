@@ -0,0 +1,180 @@
+#include "sys.config.h"
+#include "sys.task_graph.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+sys::task_graph::task_graph(void)
+	: prepared_(false)
+{
+}
+
+sys::task_graph::~task_graph(void)
+{
+}
+
+sys::task_graph::task_id sys::task_graph::add(const function_type& f)
+{
+	return add(f, 1);
+}
+
+sys::task_graph::task_id sys::task_graph::add(const function_type& f, std::uint64_t cost)
+{
+	nodes_.push_back(std::make_unique<node>());
+	nodes_.back()->function = f;
+	nodes_.back()->cost = std::max<std::uint64_t>(1, cost);
+	prepared_ = false;
+	return nodes_.size() - 1;
+}
+
+bool sys::task_graph::precede(task_id before, task_id after)
+{
+	if (before >= nodes_.size() || after >= nodes_.size() || before == after)
+		return false;
+	nodes_[before]->successors.push_back(after);
+	++nodes_[after]->predecessors;
+	prepared_ = false;
+	return true;
+}
+
+void sys::task_graph::clear(void)
+{
+	nodes_.clear();
+	order_.clear();
+	prepared_ = false;
+}
+
+std::size_t sys::task_graph::size(void) const
+{
+	return nodes_.size();
+}
+
+const sys::task_timing& sys::task_graph::timing(task_id task) const
+{
+	return nodes_[task]->timing;
+}
+
+bool sys::task_graph::prepare(void)
+{
+	if (!prepared_)
+	{
+		std::vector<std::size_t> degree(nodes_.size());
+		order_.clear();
+		order_.reserve(nodes_.size());
+		for (task_id i = 0; i < nodes_.size(); ++i)
+		{
+			degree[i] = nodes_[i]->predecessors;
+			if (degree[i] == 0)
+				order_.push_back(i);
+		}
+		for (std::size_t i = 0; i < order_.size(); ++i)
+		{
+			for (task_id next : nodes_[order_[i]]->successors)
+				if (--degree[next] == 0)
+					order_.push_back(next);
+		}
+		if (order_.size() != nodes_.size())
+		{
+			order_.clear();
+			return false;
+		}
+		prepared_ = true;
+	}
+
+	// costs change after every run, so the priorities are always redone
+	for (auto it = order_.rbegin(); it != order_.rend(); ++it)
+	{
+		node& n = *nodes_[*it];
+		std::uint64_t longest = 0;
+		for (task_id next : n.successors)
+			longest = std::max(longest, nodes_[next]->priority);
+		n.priority = n.cost + longest;
+	}
+	return true;
+}
+
+bool sys::task_graph::run(sys::thread_group& group)
+{
+	return run(group, 0);
+}
+
+bool sys::task_graph::run(sys::thread_group& group, std::size_t threads)
+{
+	if (!prepare())
+		return false;
+	if (nodes_.empty())
+		return true;
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, nodes_.size());
+
+	auto higher = [this](task_id lhs, task_id rhs) {
+		return nodes_[lhs]->priority < nodes_[rhs]->priority;
+	};
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<task_id> ready;
+	std::size_t remaining = nodes_.size();
+	for (task_id i = 0; i < nodes_.size(); ++i)
+	{
+		nodes_[i]->pending.store(nodes_[i]->predecessors, std::memory_order_relaxed);
+		if (nodes_[i]->predecessors == 0)
+			ready.push_back(i);
+	}
+	std::make_heap(ready.begin(), ready.end(), higher);
+
+	auto work = [&](std::size_t worker) {
+		std::vector<task_id> released;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			cv.wait(lock, [&]() { return !ready.empty() || remaining == 0; });
+			if (ready.empty())
+				return;
+			std::pop_heap(ready.begin(), ready.end(), higher);
+			node& n = *nodes_[ready.back()];
+			ready.pop_back();
+			lock.unlock();
+
+			n.timing.worker = worker;
+			n.timing.start = std::chrono::steady_clock::now();
+			if (n.function)
+				n.function();
+			n.timing.finish = std::chrono::steady_clock::now();
+
+			released.clear();
+			for (task_id next : n.successors)
+				if (nodes_[next]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					released.push_back(next);
+
+			lock.lock();
+			for (task_id next : released)
+			{
+				ready.push_back(next);
+				std::push_heap(ready.begin(), ready.end(), higher);
+			}
+			if (--remaining == 0)
+				cv.notify_all();
+			else
+			{
+				// this worker takes one of them itself
+				for (std::size_t i = 1; i < released.size(); ++i)
+					cv.notify_one();
+			}
+		}
+	};
+	if (threads == 1)
+		work(0);
+	else
+		group.run(threads, work);
+
+	for (auto& n : nodes_)
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			n->timing.finish - n->timing.start).count();
+		n->cost = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(elapsed));
+	}
+	return true;
+}
\ No newline at end of file
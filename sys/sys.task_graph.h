@@ -0,0 +1,67 @@
+#ifndef __SYS_TASK_GRAPH__
+#define __SYS_TASK_GRAPH__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_group.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sys
+{
+	struct task_timing
+	{
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point finish;
+		std::size_t worker = 0;
+	};
+
+	// tasks start as soon as their predecessors are done, longest remaining
+	// path first; cost is only a hint until a run has measured the tasks
+	class task_graph : public noncopyable
+	{
+	public:
+		typedef std::size_t task_id;
+		typedef std::function<void(void)> function_type;
+	private:
+		struct node
+		{
+			function_type function;
+			std::vector<task_id> successors;
+			std::size_t predecessors = 0;
+			std::uint64_t cost = 1;
+			std::uint64_t priority = 0;
+			std::atomic<std::size_t> pending{ 0 };
+			task_timing timing;
+		};
+	private:
+		std::vector<std::unique_ptr<node>> nodes_;
+		std::vector<task_id> order_;
+		bool prepared_;
+	public:
+		task_graph(void);
+		virtual ~task_graph(void);
+	public:
+		task_id add(const function_type& f);
+		task_id add(const function_type& f, std::uint64_t cost);
+		bool precede(task_id before, task_id after);
+		void clear(void);
+	public:
+		std::size_t size(void) const;
+		const task_timing& timing(task_id task) const;
+	public:
+		// false when the graph has a cycle
+		bool run(thread_group& group);
+		bool run(thread_group& group, std::size_t threads);
+	private:
+		bool prepare(void);
+	};
+}
+
+#endif
+
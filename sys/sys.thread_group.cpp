@@ -1,57 +1,343 @@
+#include "sys.config.h"
 #include "sys.thread_group.h"
+#include "sys.cpu_topology.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#if defined(SYS_HAVE_SCHED_AFFINITY)
+#include <sched.h>
+#endif
+
+#if defined(SYS_HAVE_SET_MEMPOLICY)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+struct sys::thread_group::exit_state
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::uint64_t generation = 0;
+	exit_callback callback;
+	std::atomic<std::size_t> misplaced{ 0 };
+};
+
+thread_local const sys::thread_group::membership* sys::thread_group::current_ = nullptr;
 
 sys::thread_group::thread_group()
+	: size_(0)
+	, added_(0)
+	, exit_(std::make_shared<exit_state>())
 {
 }
 
 sys::thread_group::~thread_group()
 {
 	for (auto it = threads_.begin(); it != threads_.end(); ++it)
-		delete *it;
+	{
+		if (it->thread.joinable())
+			it->thread.join();
+		if (it->owner)
+			it->owner->store(nullptr, std::memory_order_release);
+	}
 }
 
 bool sys::thread_group::contains(const std::thread* t) const
 {
-	std::thread::id id = (t == nullptr) ? 
-		std::this_thread::get_id() : t->get_id();
+	if (t != nullptr)
+		return contains(t->get_id());
+	// threads started by create() carry a tag, so no lookup is needed,
+	// and without add()ed threads an untagged one is no member either
+	if (current_ != nullptr && current_->load(std::memory_order_acquire) == this)
+		return true;
+	if (added_.load(std::memory_order_acquire) == 0)
+		return false;
+	return contains(std::this_thread::get_id());
+}
+
+bool sys::thread_group::contains(std::thread::id id) const
+{
 	std::shared_lock<std::shared_mutex> guard(mutex_);
-	for (auto it = threads_.begin(); it != threads_.end(); ++it)
-	{
-		if ((*it)->get_id() == id)
-			return true;
-	}
-	return false;
+	return index_.find(id) != index_.end();
 }
 
 std::size_t sys::thread_group::size() const
 {
-	std::shared_lock<std::shared_mutex> guard(mutex_);
-	return threads_.size();
+	return size_.load(std::memory_order_acquire);
 }
 
-void sys::thread_group::add(std::thread* t)
+std::size_t sys::thread_group::misplaced(void) const
 {
-	if (t != nullptr)
+	return exit_->misplaced.load(std::memory_order_relaxed);
+}
+
+std::thread::id sys::thread_group::add(std::jthread&& t)
+{
+	if (!t.joinable())
+		return std::thread::id();
+	slot s;
+	s.thread = std::move(t);
+	return insert(std::move(s));
+}
+
+std::thread::id sys::thread_group::insert(slot&& s)
+{
+	const std::thread::id id = s.id = s.thread.get_id();
+	std::lock_guard<std::shared_mutex> guard(mutex_);
+	index_.emplace(id, threads_.size());
+	if (!s.owner)
+		added_.fetch_add(1, std::memory_order_release);
+	threads_.push_back(std::move(s));
+	size_.store(threads_.size(), std::memory_order_release);
+	return id;
+}
+
+std::jthread sys::thread_group::remove(std::thread::id id)
+{
+	std::lock_guard<std::shared_mutex> guard(mutex_);
+	const auto it = index_.find(id);
+	if (it == index_.end())
+		return std::jthread();
+	slot s = take(it->second);
+	if (s.owner)
+		s.owner->store(nullptr, std::memory_order_release);
+	return std::move(s.thread);
+}
+
+// with mutex_ held; a create()d thread keeps its tag, so one on its way
+// to being joined still counts itself a member
+sys::thread_group::slot sys::thread_group::take(std::size_t i)
+{
+	index_.erase(threads_[i].id);
+	slot s = std::move(threads_[i]);
+	if (i + 1 != threads_.size())
 	{
-		std::lock_guard<std::shared_mutex> guard(mutex_);
-		threads_.push_back(t);
+		threads_[i] = std::move(threads_.back());
+		index_[threads_[i].id] = i;
 	}
+	threads_.pop_back();
+	size_.store(threads_.size(), std::memory_order_release);
+
+	if (!s.owner)
+		added_.fetch_sub(1, std::memory_order_release);
+	return s;
+}
+
+std::shared_future<void> sys::thread_group::completion(std::thread::id id) const
+{
+	std::shared_lock<std::shared_mutex> guard(mutex_);
+	const auto it = index_.find(id);
+	return it != index_.end() ? threads_[it->second].done : std::shared_future<void>();
+}
+
+void sys::thread_group::on_exit(const exit_callback& callback)
+{
+	std::lock_guard<std::mutex> guard(exit_->mutex);
+	exit_->callback = callback;
+}
+
+bool sys::thread_group::request_stop(std::thread::id id)
+{
+	std::shared_lock<std::shared_mutex> guard(mutex_);
+	const auto it = index_.find(id);
+	return it != index_.end() && threads_[it->second].thread.request_stop();
+}
+
+void sys::thread_group::request_stop(void)
+{
+	std::shared_lock<std::shared_mutex> guard(mutex_);
+	for (auto it = threads_.begin(); it != threads_.end(); ++it)
+		it->thread.request_stop();
 }
 
-void sys::thread_group::remove(std::thread* t)
+// takes the threads out of the group, as remove() does, so that their
+// ids can be reused by new threads once they are joined
+std::vector<std::jthread> sys::thread_group::joinable(bool finished)
 {
+	const std::thread::id self = std::this_thread::get_id();
+	std::vector<std::jthread> result;
 	std::lock_guard<std::shared_mutex> guard(mutex_);
-	const auto it = std::find(threads_.begin(), threads_.end(), t);
-	if (it != threads_.end())
-		threads_.erase(it);
+	for (std::size_t i = threads_.size(); i-- > 0;)
+	{
+		const slot& s = threads_[i];
+		if (s.id == self || !s.thread.joinable())
+			continue;
+		if (finished && !(s.done.valid() &&
+				s.done.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+			continue;
+		result.push_back(std::move(take(i).thread));
+	}
+	return result;
 }
 
-void sys::thread_group::join_all(void)
+std::vector<std::shared_future<void>> sys::thread_group::pending(void) const
 {
+	const std::thread::id self = std::this_thread::get_id();
+	std::vector<std::shared_future<void>> result;
 	std::shared_lock<std::shared_mutex> guard(mutex_);
 	for (auto it = threads_.begin(); it != threads_.end(); ++it)
 	{
-		if ((*it)->joinable())
-			(*it)->join();
+		if (it->done.valid() && it->id != self && it->thread.joinable())
+			result.push_back(it->done);
+	}
+	return result;
+}
+
+void sys::thread_group::join_all(void)
+{
+	// the threads are taken out under the lock and joined without it, so
+	// add(), remove() and exit callbacks that use the group go on meanwhile
+	for (std::jthread& t : joinable(false))
+		t.join();
+}
+
+bool sys::thread_group::join_until(std::chrono::steady_clock::time_point deadline)
+{
+	for (const auto& done : pending())
+	{
+		if (done.wait_until(deadline) != std::future_status::ready)
+			return false;
+	}
+	for (std::jthread& t : joinable(true))
+		t.join();
+	return true;
+}
+
+// removes and joins the first create()d thread to finish; returns an
+// empty id when none is left running
+std::thread::id sys::thread_group::join_any(void)
+{
+	const std::thread::id self = std::this_thread::get_id();
+	std::unique_lock<std::mutex> lock(exit_->mutex);
+	for (;;)
+	{
+		std::thread::id found;
+		bool running = false;
+		{
+			std::shared_lock<std::shared_mutex> guard(mutex_);
+			for (auto it = threads_.begin(); it != threads_.end(); ++it)
+			{
+				if (!it->done.valid() || it->id == self)
+					continue;
+				if (it->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				{
+					found = it->id;
+					break;
+				}
+				running = true;
+			}
+		}
+
+		if (found != std::thread::id())
+		{
+			std::jthread t = remove(found);
+			lock.unlock();
+			if (t.joinable())
+				t.join();
+			return found;
+		}
+		if (!running)
+			return std::thread::id();
+
+		const std::uint64_t generation = exit_->generation;
+		exit_->cv.wait(lock, [&]() { return exit_->generation != generation; });
+	}
+}
+
+// the callback runs before done is set, so a join never returns while
+// a thread is still inside it
+void sys::thread_group::place(exit_state& state, const sys::placement& where)
+{
+	if (!bind(where))
+		state.misplaced.fetch_add(1, std::memory_order_relaxed);
+}
+
+void sys::thread_group::finish(exit_state& state, std::promise<void>& done)
+{
+	exit_callback callback;
+	{
+		std::lock_guard<std::mutex> guard(state.mutex);
+		callback = state.callback;
+	}
+	if (callback)
+		callback(std::this_thread::get_id());
+	done.set_value();
+	{
+		std::lock_guard<std::mutex> guard(state.mutex);
+		++state.generation;
+	}
+	state.cv.notify_all();
+}
+
+// runs on the new thread before its function, so that memory it touches
+// first is allocated on its own node; false with errno set if the cpu is
+// not one this process may use or either call fails
+bool sys::thread_group::bind(const sys::placement& where)
+{
+	const cpu_topology& topology = cpu_topology::system();
+	std::vector<int> cpus;
+	int node = -1;
+	switch (where.policy)
+	{
+	case placement_pinned:
+		cpus.push_back(static_cast<int>(where.index));
+		break;
+	case placement_compact:
+		cpus.push_back(topology.compact_cpu(where.index));
+		break;
+	case placement_scatter:
+		cpus.push_back(topology.scatter_cpu(where.index));
+		break;
+	case placement_numa_node:
+		cpus = topology.node(where.index).cpus;
+		node = topology.node(where.index).id;
+		break;
+	default:
+		return true;
+	}
+	if (node == -1)
+		node = topology.node_of(cpus[0]);
+	if (node == -1)
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+#if defined(SYS_HAVE_SCHED_AFFINITY)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : cpus)
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	if (::sched_setaffinity(0, sizeof(set), &set) != 0)
+		return false;
+#elif defined(SYS_WIN32)
+	DWORD_PTR mask = 0;
+	for (int cpu : cpus)
+		if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+			mask |= static_cast<DWORD_PTR>(1) << cpu;
+	if (mask == 0 || ::SetThreadAffinityMask(::GetCurrentThread(), mask) == 0)
+		return false;
+#else
+	(void)cpus;
+#endif
+
+#if defined(SYS_HAVE_SET_MEMPOLICY)
+	if (node >= 0)
+	{
+		static const int mask_bits = 8 * sizeof(unsigned long);
+		std::vector<unsigned long> mask(node / mask_bits + 1, 0);
+		mask[node / mask_bits] |= 1ul << (node % mask_bits);
+		// a kernel built without NUMA has only the one node anyway
+		if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+				mask.size() * mask_bits + 1) != 0 && errno != ENOSYS)
+			return false;
 	}
+#else
+	(void)node;
+#endif
+	return true;
 }
\ No newline at end of file
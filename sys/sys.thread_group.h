@@ -1,43 +1,172 @@
 #ifndef __SYS_THREAD_GROUP__
 #define __SYS_THREAD_GROUP__
 
-#include <list>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
+#include <stop_token>
 #include <thread>
 #include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "sys.noncopyable.h"
+#include "sys.thread_stats.h"
 
 namespace sys
 {
+	typedef enum
+	{
+		placement_any,
+		placement_pinned,
+		placement_compact,
+		placement_scatter,
+		placement_numa_node
+	} placement_t;
+
+	// index is the cpu for placement_pinned and the worker number otherwise
+	struct placement
+	{
+		placement_t policy = placement_any;
+		std::size_t index = 0;
+	};
+
 	class thread_group : public noncopyable
 	{
-		std::list<std::thread*> threads_;
+	public:
+		typedef std::function<void(std::thread::id)> exit_callback;
+	private:
+		typedef std::atomic<const thread_group*> membership;
+
+		struct slot
+		{
+			std::thread::id id;
+			std::jthread thread;
+			std::shared_ptr<membership> owner;
+			std::shared_future<void> done;
+		};
+
+		struct exit_state;
+	private:
+		std::vector<slot> threads_;
+		std::unordered_map<std::thread::id, std::size_t> index_;
+		std::atomic<std::size_t> size_;
+		// slots from add(), whose threads carry no membership tag
+		std::atomic<std::size_t> added_;
 		mutable std::shared_mutex mutex_;
+		std::shared_ptr<exit_state> exit_;
+	private:
+		static thread_local const membership* current_;
 	public:
 		thread_group();
 		virtual ~thread_group();
 	public:
-		bool contains(const std::thread* t) const;
+		// nullptr asks about the calling thread, which is lock-free unless
+		// threads were add()ed to the group
+		bool contains(const std::thread* t = nullptr) const;
+		bool contains(std::thread::id id) const;
 		std::size_t size() const;
+		// threads started by create() whose placement could not be
+		// applied; they run wherever the scheduler puts them
+		std::size_t misplaced(void) const;
 	public:
 		template<class Function>
-		std::thread* create(Function&& f);
+		std::thread::id create(Function&& f);
+		template<class Function>
+		std::thread::id create(const placement& where, Function&& f);
+		template<class Function>
+		void run(std::size_t count, Function&& f);
+		template<class Function>
+		void run(std::size_t count, placement_t policy, Function&& f);
 	public:
-		void add(std::thread* t);
-		void remove(std::thread* t);
+		std::thread::id add(std::jthread&& t);
+		std::jthread remove(std::thread::id id);
 	public:
+		std::shared_future<void> completion(std::thread::id id) const;
+		void on_exit(const exit_callback& callback);
+		bool request_stop(std::thread::id id);
+		void request_stop(void);
+	public:
+		// joined threads leave the group; the timed joins only wait for
+		// threads started by create()
 		void join_all(void);
+		template<class Rep, class Period>
+		bool join_for(const std::chrono::duration<Rep, Period>& timeout);
+		bool join_until(std::chrono::steady_clock::time_point deadline);
+		std::thread::id join_any(void);
+	private:
+		std::thread::id insert(slot&& s);
+		slot take(std::size_t i);
+		std::vector<std::jthread> joinable(bool finished);
+		std::vector<std::shared_future<void>> pending(void) const;
+	private:
+		static bool bind(const placement& where);
+		static void place(exit_state& state, const placement& where);
+		static void finish(exit_state& state, std::promise<void>& done);
 	};
 
 	template<class Function>
-	std::thread* thread_group::create(Function&& f)
+	std::thread::id thread_group::create(Function&& f)
+	{
+		return create(placement(), std::forward<Function>(f));
+	}
+
+	template<class Function>
+	std::thread::id thread_group::create(const placement& where, Function&& f)
+	{
+		typedef std::decay_t<Function> function_type;
+		std::promise<void> done;
+		slot s;
+		s.owner = std::make_shared<membership>(this);
+		s.done = done.get_future().share();
+		s.thread = std::jthread(
+			[owner = s.owner, where, exit = exit_, done = std::move(done),
+					f = function_type(std::forward<Function>(f))](std::stop_token token) mutable {
+				current_ = owner.get();
+				if (thread_stats::enabled())
+					thread_stats::current();
+				if (where.policy != placement_any)
+					place(*exit, where);
+				if constexpr (std::is_invocable_v<function_type&, std::stop_token>)
+					f(std::move(token));
+				else
+					f();
+				finish(*exit, done);
+			});
+		return insert(std::move(s));
+	}
+
+	template<class Rep, class Period>
+	bool thread_group::join_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return join_until(std::chrono::steady_clock::now() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+	}
+
+	template<class Function>
+	void thread_group::run(std::size_t count, Function&& f)
 	{
-		std::lock_guard<std::shared_mutex> guard(mutex_);
-		std::unique_ptr<std::thread> t(new std::thread(f));
-		threads_.push_back(t.get());
-		return t.release();
+		run(count, placement_any, std::forward<Function>(f));
+	}
+
+	template<class Function>
+	void thread_group::run(std::size_t count, placement_t policy, Function&& f)
+	{
+		std::vector<std::thread::id> threads;
+		threads.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+			threads.push_back(create({ policy, i }, [&f, i]() { f(i); }));
+		for (std::thread::id id : threads)
+		{
+			if (std::jthread t = remove(id); t.joinable())
+				t.join();
+		}
 	}
 }
 
 #endif
+
@@ -0,0 +1,462 @@
+#include "sys.config.h"
+#include "sys.thread_pool.h"
+#include "sys.arena.h"
+#include "sys.futex.h"
+#include "sys.thread_stats.h"
+
+#include <algorithm>
+#include <climits>
+#include <thread>
+
+static const std::int64_t deque_initial_capacity = 256;
+static const int pool_spin_count = 64;
+
+// Chase-Lev deque; the owner pushes and pops at the bottom, thieves take
+// from the top. Retired rings are kept until the deque goes away.
+class sys::thread_pool::work_deque
+{
+	struct ring
+	{
+		std::int64_t capacity;
+		std::unique_ptr<std::atomic<task_base*>[]> items;
+
+		ring(std::int64_t size)
+			: capacity(size)
+			, items(new std::atomic<task_base*>[static_cast<std::size_t>(size)])
+		{
+		}
+
+		task_base* get(std::int64_t i) const
+		{
+			return items[static_cast<std::size_t>(i & (capacity - 1))].load(
+				std::memory_order_acquire);
+		}
+
+		void put(std::int64_t i, task_base* t)
+		{
+			items[static_cast<std::size_t>(i & (capacity - 1))].store(t,
+				std::memory_order_release);
+		}
+	};
+
+	alignas(64) std::atomic<std::int64_t> top_;
+	alignas(64) std::atomic<std::int64_t> bottom_;
+	std::atomic<ring*> ring_;
+	std::vector<std::unique_ptr<ring>> rings_;
+public:
+	work_deque(void)
+		: top_(0)
+		, bottom_(0)
+	{
+		rings_.push_back(std::make_unique<ring>(deque_initial_capacity));
+		ring_.store(rings_.back().get(), std::memory_order_relaxed);
+	}
+
+	void push(task_base* t)
+	{
+		const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+		const std::int64_t top = top_.load(std::memory_order_acquire);
+		ring* r = ring_.load(std::memory_order_relaxed);
+		if (b - top > r->capacity - 1)
+		{
+			auto bigger = std::make_unique<ring>(r->capacity * 2);
+			for (std::int64_t i = top; i < b; ++i)
+				bigger->put(i, r->get(i));
+			r = bigger.get();
+			rings_.push_back(std::move(bigger));
+			ring_.store(r, std::memory_order_release);
+		}
+		r->put(b, t);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+	}
+
+	task_base* pop(void)
+	{
+		const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+		ring* r = ring_.load(std::memory_order_relaxed);
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = top_.load(std::memory_order_relaxed);
+		if (top > b)
+		{
+			bottom_.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		task_base* t = r->get(b);
+		if (top == b)
+		{
+			if (!top_.compare_exchange_strong(top, top + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+				t = nullptr;
+			bottom_.store(b + 1, std::memory_order_relaxed);
+		}
+		return t;
+	}
+
+	task_base* steal(void)
+	{
+		std::int64_t top = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t b = bottom_.load(std::memory_order_acquire);
+		if (top >= b)
+			return nullptr;
+		ring* r = ring_.load(std::memory_order_acquire);
+		task_base* t = r->get(top);
+		if (!top_.compare_exchange_strong(top, top + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return t;
+	}
+
+	bool empty(void) const
+	{
+		return top_.load(std::memory_order_relaxed) >=
+			bottom_.load(std::memory_order_relaxed);
+	}
+};
+
+struct sys::thread_pool::worker
+{
+	thread_pool* pool;
+	std::size_t index;
+	std::uint32_t seed;
+	std::thread::id thread;
+	thread_stats* stats;
+	work_deque deque;
+};
+
+thread_local sys::thread_pool::worker* sys::thread_pool::current_ = nullptr;
+
+sys::thread_pool::event_source::~event_source(void)
+{
+}
+
+sys::thread_pool::task_base::~task_base(void)
+{
+}
+
+sys::thread_pool::thread_pool(sys::thread_group& group)
+	: thread_pool(group, 0)
+{
+}
+
+sys::thread_pool::thread_pool(sys::thread_group& group, std::size_t threads)
+	: group_(group)
+	, injected_size_(0)
+	, epoch_(0)
+	, sleepers_(0)
+	, finished_(0)
+	, waiters_(0)
+	, stop_(false)
+	, source_(nullptr)
+	, source_users_(0)
+	, source_waiter_(false)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (std::size_t i = 0; i < threads; ++i)
+	{
+		workers_.push_back(std::make_unique<worker>());
+		workers_.back()->pool = this;
+		workers_.back()->index = i;
+		workers_.back()->seed = static_cast<std::uint32_t>(i * 2654435761u + 1);
+		workers_.back()->stats = nullptr;
+	}
+	for (std::size_t i = 0; i < threads; ++i)
+		workers_[i]->thread = group_.create([this, i]() { run(i); });
+}
+
+sys::thread_pool::~thread_pool(void)
+{
+	stop_.store(true, std::memory_order_seq_cst);
+	epoch_.fetch_add(1, std::memory_order_release);
+	futex_wake(epoch_, UINT32_MAX);
+	for (auto& w : workers_)
+	{
+		if (std::jthread t = group_.remove(w->thread); t.joinable())
+			t.join();
+	}
+}
+
+std::size_t sys::thread_pool::size(void) const
+{
+	return workers_.size();
+}
+
+void sys::thread_pool::push(task_base* t)
+{
+	if (thread_stats::enabled())
+		t->queued = std::chrono::steady_clock::now();
+	worker* self = current_;
+	if (self != nullptr && self->pool == this)
+		self->deque.push(t);
+	else
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		injected_.push_back(t);
+		injected_size_.store(injected_.size(), std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers_.load(std::memory_order_relaxed) != 0)
+		wake(1);
+}
+
+void sys::thread_pool::push(std::vector<task_base*>& tasks)
+{
+	if (tasks.empty())
+		return;
+	if (thread_stats::enabled())
+	{
+		const auto now = std::chrono::steady_clock::now();
+		for (task_base* t : tasks)
+			t->queued = now;
+	}
+	worker* self = current_;
+	if (self != nullptr && self->pool == this)
+	{
+		for (task_base* t : tasks)
+			self->deque.push(t);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		injected_.insert(injected_.end(), tasks.begin(), tasks.end());
+		injected_size_.store(injected_.size(), std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const std::uint32_t sleepers = sleepers_.load(std::memory_order_relaxed);
+	if (sleepers != 0)
+		wake(static_cast<std::uint32_t>(std::min<std::size_t>(sleepers, tasks.size())));
+}
+
+void sys::thread_pool::wake(std::uint32_t count)
+{
+	epoch_.fetch_add(1, std::memory_order_release);
+	futex_wake(epoch_, count);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (source_waiter_.load(std::memory_order_relaxed))
+		interrupt_source();
+}
+
+// lets threads sleeping in wait() look at their predicate again
+void sys::thread_pool::finish(void)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters_.load(std::memory_order_relaxed) != 0)
+	{
+		finished_.fetch_add(1, std::memory_order_release);
+		futex_wake(finished_, UINT32_MAX);
+	}
+}
+
+std::uint32_t sys::thread_pool::watch(void)
+{
+	const std::uint32_t epoch = finished_.load(std::memory_order_acquire);
+	waiters_.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return epoch;
+}
+
+void sys::thread_pool::unwatch(std::uint32_t epoch, bool block)
+{
+	if (block)
+		futex_wait(finished_, epoch);
+	waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool sys::thread_pool::attach(event_source* source)
+{
+	event_source* expected = nullptr;
+	if (!source_.compare_exchange_strong(expected, source, std::memory_order_acq_rel))
+		return false;
+	notify();
+	return true;
+}
+
+// waits out any worker still inside the source
+void sys::thread_pool::detach(event_source* source)
+{
+	event_source* expected = source;
+	if (!source_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+		return;
+	if (source_waiter_.load(std::memory_order_seq_cst))
+		source->interrupt();
+	while (source_users_.load(std::memory_order_acquire) != 0)
+	{
+		if (source_waiter_.load(std::memory_order_relaxed))
+			source->interrupt();
+		std::this_thread::yield();
+	}
+}
+
+void sys::thread_pool::notify(void)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!source_waiter_.load(std::memory_order_relaxed) &&
+			sleepers_.load(std::memory_order_relaxed) != 0)
+		wake(1);
+}
+
+bool sys::thread_pool::poll_source(void)
+{
+	if (source_.load(std::memory_order_relaxed) == nullptr)
+		return false;
+	source_users_.fetch_add(1, std::memory_order_seq_cst);
+	bool found = false;
+	if (event_source* source = source_.load(std::memory_order_seq_cst))
+		found = source->poll();
+	source_users_.fetch_sub(1, std::memory_order_release);
+	return found;
+}
+
+// only one worker at a time blocks in the source; wake() interrupts it
+// the same way it bumps the futex epoch for the others
+bool sys::thread_pool::wait_source(std::uint32_t epoch)
+{
+	if (source_.load(std::memory_order_relaxed) == nullptr)
+		return false;
+	source_users_.fetch_add(1, std::memory_order_seq_cst);
+	bool waited = false;
+	event_source* source = source_.load(std::memory_order_seq_cst);
+	if (source != nullptr && source->pending() &&
+			!source_waiter_.exchange(true, std::memory_order_seq_cst))
+	{
+		if (epoch_.load(std::memory_order_seq_cst) == epoch)
+			source->wait();
+		source_waiter_.store(false, std::memory_order_release);
+		waited = true;
+	}
+	source_users_.fetch_sub(1, std::memory_order_release);
+	return waited;
+}
+
+void sys::thread_pool::interrupt_source(void)
+{
+	source_users_.fetch_add(1, std::memory_order_seq_cst);
+	if (event_source* source = source_.load(std::memory_order_seq_cst))
+		source->interrupt();
+	source_users_.fetch_sub(1, std::memory_order_release);
+}
+
+bool sys::thread_pool::in_worker(void) const
+{
+	return current_ != nullptr && current_->pool == this;
+}
+
+bool sys::thread_pool::help(void)
+{
+	task_base* t = find_work(in_worker() ? current_ : nullptr);
+	if (t == nullptr)
+		return false;
+	t->run();
+	delete t;
+	finish();
+	return true;
+}
+
+sys::thread_pool::task_base* sys::thread_pool::find_work(worker* self)
+{
+	poll_source();
+	if (self != nullptr)
+	{
+		if (task_base* t = self->deque.pop())
+			return t;
+	}
+
+	if (injected_size_.load(std::memory_order_relaxed) != 0)
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		if (!injected_.empty())
+		{
+			task_base* t = injected_.front();
+			injected_.pop_front();
+			injected_size_.store(injected_.size(), std::memory_order_relaxed);
+			return t;
+		}
+	}
+
+	const std::size_t count = workers_.size();
+	std::size_t start = 0;
+	if (self != nullptr)
+	{
+		self->seed = self->seed * 1664525u + 1013904223u;
+		start = self->seed % count;
+	}
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		worker& victim = *workers_[(start + i) % count];
+		if (&victim == self)
+			continue;
+		if (task_base* t = victim.deque.steal())
+		{
+			if (self != nullptr && thread_stats::enabled())
+				self->stats->steal();
+			return t;
+		}
+	}
+	return nullptr;
+}
+
+void sys::thread_pool::run(std::size_t index)
+{
+	worker& self = *workers_[index];
+	arena& scratch = worker_memory::current().scratch();
+	self.stats = &thread_stats::current();
+	current_ = &self;
+	for (;;)
+	{
+		task_base* t = nullptr;
+		for (int spin = 0; spin < pool_spin_count && t == nullptr; ++spin)
+		{
+			t = find_work(&self);
+			if (t == nullptr)
+				cpu_relax();
+		}
+
+		if (t == nullptr)
+		{
+			const std::uint32_t epoch = epoch_.load(std::memory_order_acquire);
+			sleepers_.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			t = find_work(&self);
+			if (t == nullptr)
+			{
+				if (stop_.load(std::memory_order_acquire))
+				{
+					sleepers_.fetch_sub(1, std::memory_order_relaxed);
+					break;
+				}
+				if (thread_stats::enabled())
+					self.stats->park();
+				if (!wait_source(epoch))
+					futex_wait(epoch_, epoch);
+			}
+			sleepers_.fetch_sub(1, std::memory_order_relaxed);
+			if (t == nullptr)
+				continue;
+		}
+
+		if (thread_stats::enabled())
+			run_measured(self, t);
+		else
+			t->run();
+		delete t;
+		finish();
+		scratch.reset();
+	}
+	current_ = nullptr;
+}
+
+void sys::thread_pool::run_measured(worker& self, task_base* t)
+{
+	typedef std::chrono::nanoseconds ns;
+	const auto start = std::chrono::steady_clock::now();
+	t->run();
+	const auto finish = std::chrono::steady_clock::now();
+	const std::uint64_t wait = t->queued.time_since_epoch().count() == 0 ? 0 :
+		static_cast<std::uint64_t>(std::max<std::int64_t>(0,
+			std::chrono::duration_cast<ns>(start - t->queued).count()));
+	self.stats->task(wait, static_cast<std::uint64_t>(
+		std::chrono::duration_cast<ns>(finish - start).count()));
+}
\ No newline at end of file
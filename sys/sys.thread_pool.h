@@ -0,0 +1,196 @@
+#ifndef __SYS_THREAD_POOL__
+#define __SYS_THREAD_POOL__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_group.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sys
+{
+	class thread_pool : public noncopyable
+	{
+	public:
+		// something other than the queues that produces work, such as an
+		// io_uring completion queue; workers poll it between tasks and
+		// one idle worker may block in wait() instead of parking
+		class event_source
+		{
+		public:
+			virtual ~event_source(void);
+		public:
+			// handles whatever is ready without blocking and posts the
+			// resulting tasks; true if there was anything
+			virtual bool poll(void) = 0;
+			// true while wait() has something to wait for
+			virtual bool pending(void) const = 0;
+			virtual void wait(void) = 0;
+			// makes a wait() in progress return
+			virtual void interrupt(void) = 0;
+		};
+	private:
+		class task_base
+		{
+		public:
+			std::chrono::steady_clock::time_point queued;
+		public:
+			virtual ~task_base(void);
+		public:
+			virtual void run(void) = 0;
+		};
+
+		template<class Function>
+		class task : public task_base
+		{
+			Function f_;
+		public:
+			task(Function&& f)
+				: f_(std::move(f))
+			{
+			}
+		public:
+			void run(void) override
+			{
+				f_();
+			}
+		};
+
+		class work_deque;
+		struct worker;
+	private:
+		thread_group& group_;
+		std::vector<std::unique_ptr<worker>> workers_;
+		std::mutex mutex_;
+		std::deque<task_base*> injected_;
+		std::atomic<std::size_t> injected_size_;
+		alignas(64) std::atomic<std::uint32_t> epoch_;
+		alignas(64) std::atomic<std::uint32_t> sleepers_;
+		// bumped after a task when a thread outside the pool sleeps in wait()
+		alignas(64) std::atomic<std::uint32_t> finished_;
+		std::atomic<std::uint32_t> waiters_;
+		std::atomic<bool> stop_;
+		std::atomic<event_source*> source_;
+		std::atomic<std::uint32_t> source_users_;
+		std::atomic<bool> source_waiter_;
+	private:
+		static const int wait_spin_count = 64;
+		static thread_local worker* current_;
+	public:
+		thread_pool(thread_group& group);
+		thread_pool(thread_group& group, std::size_t threads);
+		virtual ~thread_pool(void);
+	public:
+		std::size_t size(void) const;
+		bool in_worker(void) const;
+	public:
+		// runs one queued task on the calling thread, if there is one
+		bool help(void);
+		// a thread outside the pool sleeps once there is nothing to help
+		// with, so done must turn true from inside one of the pool's tasks
+		template<class Predicate>
+		void wait(Predicate done);
+	public:
+		// one source per pool; it must be detached before it goes away
+		bool attach(event_source* source);
+		void detach(event_source* source);
+		// the attached source has new pending work, so see that an idle
+		// worker watches it
+		void notify(void);
+	public:
+		template<class Function>
+		void post(Function&& f);
+		template<class Function>
+		auto submit(Function&& f)
+			-> std::future<std::invoke_result_t<std::decay_t<Function>>>;
+		template<class Function>
+		auto bulk_submit(std::size_t count, Function&& f)
+			-> std::vector<std::future<std::invoke_result_t<std::decay_t<Function>, std::size_t>>>;
+	private:
+		void push(task_base* t);
+		void push(std::vector<task_base*>& tasks);
+		void run(std::size_t index);
+		task_base* find_work(worker* self);
+		void run_measured(worker& self, task_base* t);
+		void wake(std::uint32_t count);
+		void finish(void);
+		std::uint32_t watch(void);
+		void unwatch(std::uint32_t epoch, bool block);
+		bool poll_source(void);
+		bool wait_source(std::uint32_t epoch);
+		void interrupt_source(void);
+	};
+
+	template<class Predicate>
+	void thread_pool::wait(Predicate done)
+	{
+		// keep running tasks meanwhile, a blocked worker could hold the
+		// very tasks it waits for in its own deque
+		int spin = 0;
+		while (!done())
+		{
+			if (help())
+				spin = 0;
+			else if (in_worker() || ++spin < wait_spin_count)
+				std::this_thread::yield();
+			else
+			{
+				const std::uint32_t epoch = watch();
+				unwatch(epoch, !done() && !help());
+				spin = 0;
+			}
+		}
+	}
+
+	template<class Function>
+	void thread_pool::post(Function&& f)
+	{
+		typedef std::decay_t<Function> function_type;
+		push(new task<function_type>(function_type(std::forward<Function>(f))));
+	}
+
+	template<class Function>
+	auto thread_pool::submit(Function&& f)
+		-> std::future<std::invoke_result_t<std::decay_t<Function>>>
+	{
+		typedef std::invoke_result_t<std::decay_t<Function>> result_type;
+		typedef std::packaged_task<result_type()> task_type;
+		task_type t(std::forward<Function>(f));
+		std::future<result_type> future = t.get_future();
+		push(new task<task_type>(std::move(t)));
+		return future;
+	}
+
+	template<class Function>
+	auto thread_pool::bulk_submit(std::size_t count, Function&& f)
+		-> std::vector<std::future<std::invoke_result_t<std::decay_t<Function>, std::size_t>>>
+	{
+		typedef std::invoke_result_t<std::decay_t<Function>, std::size_t> result_type;
+		typedef std::packaged_task<result_type()> task_type;
+		std::vector<std::future<result_type>> futures;
+		std::vector<task_base*> tasks;
+		futures.reserve(count);
+		tasks.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			task_type t([f, i]() mutable { return f(i); });
+			futures.push_back(t.get_future());
+			tasks.push_back(new task<task_type>(std::move(t)));
+		}
+		push(tasks);
+		return futures;
+	}
+}
+
+#endif
+
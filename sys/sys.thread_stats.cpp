@@ -0,0 +1,335 @@
+#include "sys.config.h"
+#include "sys.thread_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <mutex>
+
+#if !defined(SYS_WIN32)
+#include <pthread.h>
+#endif
+
+#if defined(SYS_HAVE_RUSAGE_THREAD)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+static const std::uint64_t prometheus_bounds[] = {
+	1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000, 10000000000ull
+};
+
+namespace
+{
+	std::atomic<bool> recording(false);
+
+	struct registry
+	{
+		std::mutex mutex;
+		std::vector<sys::thread_stats*> threads;
+	};
+
+	// never destroyed, as pool threads can still exit after static
+	// destructors have run
+	registry& threads(void)
+	{
+		static registry* r = new registry;
+		return *r;
+	}
+
+	std::uint64_t os_thread_id(void)
+	{
+#if defined(SYS_HAVE_RUSAGE_THREAD)
+		return static_cast<std::uint64_t>(::syscall(SYS_gettid));
+#elif defined(SYS_WIN32)
+		return ::GetCurrentThreadId();
+#else
+		return 0;
+#endif
+	}
+
+	void max_store(std::atomic<std::uint64_t>& target, std::uint64_t value)
+	{
+		if (value > target.load(std::memory_order_relaxed))
+			target.store(value, std::memory_order_relaxed);
+	}
+
+	void write_counter(std::string& out, const char* name, const char* help,
+		const std::vector<sys::thread_stats_snapshot>& stats,
+		std::uint64_t sys::thread_stats_snapshot::* field, double scale)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n",
+			name, help, name);
+		out += line;
+		for (const auto& s : stats)
+		{
+			std::snprintf(line, sizeof(line), "%s{thread=\"%llu\"} %.9g\n", name,
+				static_cast<unsigned long long>(s.os_id),
+				static_cast<double>(s.*field) * scale);
+			out += line;
+		}
+	}
+
+	void write_histogram(std::string& out, const char* name, const char* help,
+		const std::vector<sys::thread_stats_snapshot>& stats,
+		sys::histogram_snapshot sys::thread_stats_snapshot::* field)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n",
+			name, help, name);
+		out += line;
+		for (const auto& s : stats)
+		{
+			const sys::histogram_snapshot& h = s.*field;
+			const unsigned long long id = static_cast<unsigned long long>(s.os_id);
+			std::uint64_t cumulative = 0;
+			std::size_t b = 0;
+			for (std::uint64_t bound : prometheus_bounds)
+			{
+				for (; b < h.counts.size() && sys::latency_histogram::upper_bound(b) <= bound; ++b)
+					cumulative += h.counts[b];
+				std::snprintf(line, sizeof(line), "%s_bucket{thread=\"%llu\",le=\"%.9g\"} %llu\n",
+					name, id, static_cast<double>(bound) / 1e9,
+					static_cast<unsigned long long>(cumulative));
+				out += line;
+			}
+			std::snprintf(line, sizeof(line),
+				"%s_bucket{thread=\"%llu\",le=\"+Inf\"} %llu\n"
+				"%s_sum{thread=\"%llu\"} %.9g\n"
+				"%s_count{thread=\"%llu\"} %llu\n",
+				name, id, static_cast<unsigned long long>(h.count),
+				name, id, static_cast<double>(h.sum) / 1e9,
+				name, id, static_cast<unsigned long long>(h.count));
+			out += line;
+		}
+	}
+}
+
+std::uint64_t sys::histogram_snapshot::percentile(double p) const
+{
+	if (count == 0)
+		return 0;
+	const std::uint64_t rank = static_cast<std::uint64_t>(
+		std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(count - 1)) + 1;
+	std::uint64_t seen = 0;
+	for (std::size_t b = 0; b < counts.size(); ++b)
+	{
+		seen += counts[b];
+		if (seen >= rank)
+			return std::min(max, latency_histogram::upper_bound(b));
+	}
+	return max;
+}
+
+void sys::histogram_snapshot::merge(const sys::histogram_snapshot& other)
+{
+	if (counts.size() < other.counts.size())
+		counts.resize(other.counts.size());
+	for (std::size_t b = 0; b < other.counts.size(); ++b)
+		counts[b] += other.counts[b];
+	count += other.count;
+	sum += other.sum;
+	max = std::max(max, other.max);
+}
+
+sys::latency_histogram::latency_histogram(void)
+	: count_(0)
+	, sum_(0)
+	, max_(0)
+{
+	for (auto& c : counts_)
+		c.store(0, std::memory_order_relaxed);
+}
+
+sys::latency_histogram::~latency_histogram(void)
+{
+}
+
+std::size_t sys::latency_histogram::bucket(std::uint64_t value)
+{
+	if (value < sub_buckets)
+		return static_cast<std::size_t>(value);
+	const std::size_t exponent = std::bit_width(value) - 1;
+	const std::size_t sub = static_cast<std::size_t>(value >> (exponent - 4)) & (sub_buckets - 1);
+	return (exponent - 3) * sub_buckets + sub;
+}
+
+std::uint64_t sys::latency_histogram::upper_bound(std::size_t bucket)
+{
+	if (bucket < sub_buckets)
+		return bucket;
+	const std::size_t exponent = bucket / sub_buckets + 3;
+	const std::uint64_t sub = bucket % sub_buckets;
+	return ((sub_buckets + sub + 1) << (exponent - 4)) - 1;
+}
+
+// single writer, so plain loads and stores are enough
+void sys::latency_histogram::record(std::uint64_t value)
+{
+	std::atomic<std::uint64_t>& c = counts_[bucket(value)];
+	c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	max_store(max_, value);
+}
+
+sys::histogram_snapshot sys::latency_histogram::snapshot(void) const
+{
+	histogram_snapshot result;
+	result.counts.resize(buckets);
+	for (std::size_t b = 0; b < buckets; ++b)
+		result.counts[b] = counts_[b].load(std::memory_order_relaxed);
+	result.count = count_.load(std::memory_order_relaxed);
+	result.sum = sum_.load(std::memory_order_relaxed);
+	result.max = max_.load(std::memory_order_relaxed);
+	return result;
+}
+
+sys::thread_stats::thread_stats(void)
+	: thread_(std::this_thread::get_id())
+	, os_id_(os_thread_id())
+#if !defined(SYS_WIN32)
+	, clock_(CLOCK_THREAD_CPUTIME_ID)
+#endif
+	, tasks_(0)
+	, steals_(0)
+	, parks_(0)
+	, cpu_time_(0)
+	, voluntary_(0)
+	, involuntary_(0)
+{
+#if !defined(SYS_WIN32)
+	if (::pthread_getcpuclockid(::pthread_self(), &clock_) != 0)
+		clock_ = CLOCK_THREAD_CPUTIME_ID;
+#endif
+	registry& r = threads();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	r.threads.push_back(this);
+}
+
+sys::thread_stats::~thread_stats(void)
+{
+	registry& r = threads();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+void sys::thread_stats::enable(bool on)
+{
+	recording.store(on, std::memory_order_relaxed);
+}
+
+bool sys::thread_stats::enabled(void)
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+sys::thread_stats& sys::thread_stats::current(void)
+{
+	thread_local thread_stats stats;
+	return stats;
+}
+
+std::vector<sys::thread_stats_snapshot> sys::thread_stats::snapshot(void)
+{
+	current().refresh();
+	std::vector<thread_stats_snapshot> result;
+	registry& r = threads();
+	std::lock_guard<std::mutex> guard(r.mutex);
+	for (const thread_stats* t : r.threads)
+	{
+		thread_stats_snapshot s;
+		s.thread = t->thread_;
+		s.os_id = t->os_id_;
+		s.cpu_time = t->cpu_time_.load(std::memory_order_relaxed);
+#if !defined(SYS_WIN32)
+		// the thread is still registered, so its clock is still valid
+		struct timespec ts;
+		if (t->clock_ != CLOCK_THREAD_CPUTIME_ID && ::clock_gettime(t->clock_, &ts) == 0)
+			s.cpu_time = static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull +
+				static_cast<std::uint64_t>(ts.tv_nsec);
+#endif
+		s.voluntary_switches = t->voluntary_.load(std::memory_order_relaxed);
+		s.involuntary_switches = t->involuntary_.load(std::memory_order_relaxed);
+		s.tasks = t->tasks_.load(std::memory_order_relaxed);
+		s.steals = t->steals_.load(std::memory_order_relaxed);
+		s.parks = t->parks_.load(std::memory_order_relaxed);
+		s.queue_wait = t->queue_wait_.snapshot();
+		s.run_time = t->run_time_.snapshot();
+		result.push_back(std::move(s));
+	}
+	return result;
+}
+
+std::string sys::thread_stats::prometheus(void)
+{
+	const std::vector<thread_stats_snapshot> stats = snapshot();
+	std::string out;
+	write_counter(out, "sys_thread_cpu_seconds_total", "CPU time used by the thread.",
+		stats, &thread_stats_snapshot::cpu_time, 1e-9);
+	write_counter(out, "sys_thread_voluntary_switches_total",
+		"Voluntary context switches.", stats, &thread_stats_snapshot::voluntary_switches, 1);
+	write_counter(out, "sys_thread_involuntary_switches_total",
+		"Involuntary context switches.", stats, &thread_stats_snapshot::involuntary_switches, 1);
+	write_counter(out, "sys_thread_tasks_total", "Tasks run by the thread.",
+		stats, &thread_stats_snapshot::tasks, 1);
+	write_counter(out, "sys_thread_steals_total", "Tasks taken from other workers.",
+		stats, &thread_stats_snapshot::steals, 1);
+	write_counter(out, "sys_thread_parks_total", "Times the thread went to sleep idle.",
+		stats, &thread_stats_snapshot::parks, 1);
+	write_histogram(out, "sys_task_queue_wait_seconds", "Time from submit to start.",
+		stats, &thread_stats_snapshot::queue_wait);
+	write_histogram(out, "sys_task_run_seconds", "Time spent running a task.",
+		stats, &thread_stats_snapshot::run_time);
+	return out;
+}
+
+void sys::thread_stats::task(std::uint64_t queue_wait, std::uint64_t run_time)
+{
+	const std::uint64_t tasks = tasks_.load(std::memory_order_relaxed) + 1;
+	tasks_.store(tasks, std::memory_order_relaxed);
+	queue_wait_.record(queue_wait);
+	run_time_.record(run_time);
+	if (tasks % 64 == 0)
+		refresh();
+}
+
+void sys::thread_stats::steal(void)
+{
+	steals_.store(steals_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void sys::thread_stats::park(void)
+{
+	parks_.store(parks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	refresh();
+}
+
+void sys::thread_stats::refresh(void)
+{
+#if defined(SYS_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user))
+	{
+		const std::uint64_t k = (static_cast<std::uint64_t>(kernel.dwHighDateTime) << 32) |
+			kernel.dwLowDateTime;
+		const std::uint64_t u = (static_cast<std::uint64_t>(user.dwHighDateTime) << 32) |
+			user.dwLowDateTime;
+		cpu_time_.store((k + u) * 100, std::memory_order_relaxed);
+	}
+#else
+	struct timespec ts;
+	if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		cpu_time_.store(static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull +
+			static_cast<std::uint64_t>(ts.tv_nsec), std::memory_order_relaxed);
+#endif
+#if defined(SYS_HAVE_RUSAGE_THREAD)
+	struct rusage usage;
+	if (::getrusage(RUSAGE_THREAD, &usage) == 0)
+	{
+		voluntary_.store(static_cast<std::uint64_t>(usage.ru_nvcsw), std::memory_order_relaxed);
+		involuntary_.store(static_cast<std::uint64_t>(usage.ru_nivcsw), std::memory_order_relaxed);
+	}
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef __SYS_THREAD_STATS__
+#define __SYS_THREAD_STATS__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(SYS_WIN32)
+#include <time.h>
+#endif
+
+namespace sys
+{
+	struct histogram_snapshot
+	{
+		std::vector<std::uint64_t> counts;
+		std::uint64_t count = 0;
+		std::uint64_t sum = 0;
+		std::uint64_t max = 0;
+
+		std::uint64_t percentile(double p) const;
+		void merge(const histogram_snapshot& other);
+	};
+
+	// log-linear buckets, 16 per power of two, so any value is off by at
+	// most 1/16; written by one thread, read by anyone
+	class latency_histogram : public noncopyable
+	{
+	public:
+		static const std::size_t sub_buckets = 16;
+		static const std::size_t buckets = 61 * sub_buckets;
+	private:
+		std::atomic<std::uint64_t> counts_[buckets];
+		std::atomic<std::uint64_t> count_;
+		std::atomic<std::uint64_t> sum_;
+		std::atomic<std::uint64_t> max_;
+	public:
+		latency_histogram(void);
+		virtual ~latency_histogram(void);
+	public:
+		void record(std::uint64_t value);
+		histogram_snapshot snapshot(void) const;
+	public:
+		static std::size_t bucket(std::uint64_t value);
+		static std::uint64_t upper_bound(std::size_t bucket);
+	};
+
+	struct thread_stats_snapshot
+	{
+		std::thread::id thread;
+		std::uint64_t os_id = 0;
+		std::uint64_t cpu_time = 0;
+		std::uint64_t voluntary_switches = 0;
+		std::uint64_t involuntary_switches = 0;
+		std::uint64_t tasks = 0;
+		std::uint64_t steals = 0;
+		std::uint64_t parks = 0;
+		histogram_snapshot queue_wait;
+		histogram_snapshot run_time;
+	};
+
+	// one per thread and on its own cache lines; recording is skipped
+	// unless enable(true) was called. Times are in nanoseconds.
+	class alignas(64) thread_stats : public noncopyable
+	{
+		std::thread::id thread_;
+		std::uint64_t os_id_;
+#if !defined(SYS_WIN32)
+		clockid_t clock_;
+#endif
+		std::atomic<std::uint64_t> tasks_;
+		std::atomic<std::uint64_t> steals_;
+		std::atomic<std::uint64_t> parks_;
+		std::atomic<std::uint64_t> cpu_time_;
+		std::atomic<std::uint64_t> voluntary_;
+		std::atomic<std::uint64_t> involuntary_;
+		latency_histogram queue_wait_;
+		latency_histogram run_time_;
+	public:
+		thread_stats(void);
+		virtual ~thread_stats(void);
+	public:
+		static void enable(bool on);
+		static bool enabled(void);
+		static thread_stats& current(void);
+		static std::vector<thread_stats_snapshot> snapshot(void);
+		static std::string prometheus(void);
+	public:
+		void task(std::uint64_t queue_wait, std::uint64_t run_time);
+		void steal(void);
+		void park(void);
+		// reads this thread's cpu time and context switches; call it on
+		// the thread itself. Elsewhere only the cpu time is current.
+		void refresh(void);
+	};
+}
+
+#endif
+
@@ -0,0 +1,373 @@
+#include "sys.config.h"
+#include "sys.timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <limits>
+
+#if defined(SYS_HAVE_TIMERFD)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+static const std::uint64_t no_tick = std::numeric_limits<std::uint64_t>::max();
+static const std::uint64_t max_delta = (std::uint64_t(1) << 32) - 1;
+static const std::uint64_t slot_bits = 8;
+
+sys::timer_wheel::timer_wheel(sys::thread_group& group, sys::thread_pool& pool)
+	: timer_wheel(group, pool, std::chrono::milliseconds(1))
+{
+}
+
+sys::timer_wheel::timer_wheel(sys::thread_group& group, sys::thread_pool& pool,
+	std::chrono::nanoseconds resolution)
+	: group_(group)
+	, pool_(pool)
+	, resolution_(std::max(resolution, std::chrono::nanoseconds(1)))
+	, origin_(std::chrono::steady_clock::now())
+	, free_(nil)
+	, current_(0)
+	, armed_(0)
+	, size_(0)
+	, stop_(false)
+	, timer_fd_(-1)
+	, wakeup_fd_(-1)
+{
+	std::fill(std::begin(heads_), std::end(heads_), nil);
+	std::fill(std::begin(occupied_), std::end(occupied_), 0);
+#if defined(SYS_HAVE_TIMERFD)
+	timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+	thread_ = group_.create([this]() { run(); });
+}
+
+sys::timer_wheel::~timer_wheel(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+		wake();
+	}
+	if (std::jthread t = group_.remove(thread_); t.joinable())
+		t.join();
+#if defined(SYS_HAVE_TIMERFD)
+	if (timer_fd_ != -1)
+		::close(timer_fd_);
+	if (wakeup_fd_ != -1)
+		::close(wakeup_fd_);
+#endif
+}
+
+sys::timer_wheel::timer_id sys::timer_wheel::schedule(std::chrono::nanoseconds delay,
+	function_type f)
+{
+	const std::uint64_t offset = std::max<std::int64_t>(0, delay.count());
+	return add(now() + offset, 0, std::move(f));
+}
+
+sys::timer_wheel::timer_id sys::timer_wheel::schedule_at(
+	std::chrono::steady_clock::time_point when, function_type f)
+{
+	const std::int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		when - origin_).count();
+	return add(std::max<std::int64_t>(0, offset), 0, std::move(f));
+}
+
+sys::timer_wheel::timer_id sys::timer_wheel::schedule_every(
+	std::chrono::nanoseconds period, function_type f)
+{
+	return schedule_every(period, period, std::move(f));
+}
+
+sys::timer_wheel::timer_id sys::timer_wheel::schedule_every(
+	std::chrono::nanoseconds first, std::chrono::nanoseconds period, function_type f)
+{
+	const std::uint64_t offset = std::max<std::int64_t>(0, first.count());
+	const std::uint64_t every = std::max<std::int64_t>(1, period.count());
+	return add(now() + offset, every, std::move(f));
+}
+
+bool sys::timer_wheel::cancel(timer_id id)
+{
+	const std::uint32_t index = std::uint32_t(id);
+	const std::uint32_t generation = std::uint32_t(id >> 32);
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (index >= nodes_.size() || nodes_[index].generation != generation ||
+			nodes_[index].slot == nil)
+		return false;
+	unlink(index);
+	release(index);
+	return true;
+}
+
+std::size_t sys::timer_wheel::size(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return size_;
+}
+
+sys::timer_wheel::timer_id sys::timer_wheel::add(std::uint64_t expires,
+	std::uint64_t period, function_type&& f)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::uint32_t index = free_;
+	if (index != nil)
+		free_ = nodes_[index].next;
+	else
+	{
+		index = std::uint32_t(nodes_.size());
+		nodes_.emplace_back();
+	}
+	node& n = nodes_[index];
+	n.expires = expires;
+	n.period = period;
+	n.function = std::move(f);
+	link(index);
+	++size_;
+	if (std::max(tick_of(expires), current_) < armed_)
+	{
+		armed_ = 0;
+		wake();
+	}
+	return (std::uint64_t(n.generation) << 32) | index;
+}
+
+std::uint64_t sys::timer_wheel::now(void) const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - origin_).count();
+}
+
+// rounded up, so a timer never fires before its time
+std::uint64_t sys::timer_wheel::tick_of(std::uint64_t time) const
+{
+	const std::uint64_t resolution = resolution_.count();
+	return time / resolution + (time % resolution != 0 ? 1 : 0);
+}
+
+void sys::timer_wheel::link(std::uint32_t index)
+{
+	node& n = nodes_[index];
+	std::uint64_t tick = std::max(tick_of(n.expires), current_);
+	const std::uint64_t delta = std::min(tick - current_, max_delta);
+	tick = current_ + delta;
+
+	std::size_t level = 0;
+	while (level + 1 < levels && delta >= std::uint64_t(1) << (slot_bits * (level + 1)))
+		++level;
+	const std::size_t slot = level * slots + ((tick >> (slot_bits * level)) & (slots - 1));
+
+	n.slot = std::uint32_t(slot);
+	n.prev = nil;
+	n.next = heads_[slot];
+	if (n.next != nil)
+		nodes_[n.next].prev = index;
+	heads_[slot] = index;
+	occupied_[slot / 64] |= std::uint64_t(1) << (slot % 64);
+}
+
+void sys::timer_wheel::unlink(std::uint32_t index)
+{
+	node& n = nodes_[index];
+	if (n.prev != nil)
+		nodes_[n.prev].next = n.next;
+	else
+	{
+		heads_[n.slot] = n.next;
+		if (n.next == nil)
+			occupied_[n.slot / 64] &= ~(std::uint64_t(1) << (n.slot % 64));
+	}
+	if (n.next != nil)
+		nodes_[n.next].prev = n.prev;
+	n.slot = nil;
+}
+
+void sys::timer_wheel::release(std::uint32_t index)
+{
+	node& n = nodes_[index];
+	n.function = nullptr;
+	if (++n.generation == 0)
+		n.generation = 1;
+	n.next = free_;
+	free_ = index;
+	--size_;
+}
+
+// moves every timer of a coarse slot one level down or more
+void sys::timer_wheel::cascade(std::size_t level, std::size_t slot)
+{
+	const std::size_t index = level * slots + slot;
+	std::uint32_t head = heads_[index];
+	heads_[index] = nil;
+	occupied_[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+	while (head != nil)
+	{
+		const std::uint32_t next = nodes_[head].next;
+		link(head);
+		head = next;
+	}
+}
+
+// processes every tick up to and including until, jumping over the empty ones
+void sys::timer_wheel::advance(std::uint64_t until,
+	std::vector<function_type>& expired)
+{
+	while (current_ <= until)
+	{
+		const std::uint64_t tick = next_tick();
+		if (tick > until)
+		{
+			current_ = until + 1;
+			break;
+		}
+		current_ = tick;
+		for (std::size_t level = 1; level < levels; ++level)
+		{
+			const std::uint64_t shift = slot_bits * level;
+			if ((tick & ((std::uint64_t(1) << shift) - 1)) != 0)
+				break;
+			cascade(level, (tick >> shift) & (slots - 1));
+		}
+
+		const std::size_t slot = tick & (slots - 1);
+		std::uint32_t head = heads_[slot];
+		heads_[slot] = nil;
+		occupied_[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+		while (head != nil)
+		{
+			node& n = nodes_[head];
+			const std::uint32_t next = n.next;
+			n.slot = nil;
+			if (n.period == 0)
+			{
+				expired.push_back(std::move(n.function));
+				release(head);
+			}
+			else
+			{
+				expired.push_back(n.function);
+				const std::uint64_t due = tick * resolution_.count();
+				if (n.expires <= due)
+					n.expires += ((due - n.expires) / n.period + 1) * n.period;
+				link(head);
+			}
+			head = next;
+		}
+		current_ = tick + 1;
+	}
+}
+
+// the first tick at or after current_ that fires a timer or cascades a
+// slot, found from the occupancy bits of each level
+std::uint64_t sys::timer_wheel::next_tick(void) const
+{
+	std::uint64_t best = no_tick;
+	for (std::size_t level = 0; level < levels; ++level)
+	{
+		const std::uint64_t shift = slot_bits * level;
+		const std::uint64_t position =
+			(current_ + (std::uint64_t(1) << shift) - 1) >> shift;
+		const std::size_t start = position & (slots - 1);
+		const std::uint64_t* bits = occupied_ + level * slots / 64;
+		for (std::size_t offset = 0; offset < slots; )
+		{
+			const std::size_t slot = (start + offset) & (slots - 1);
+			const std::uint64_t word = bits[slot / 64] >> (slot % 64);
+			if (word == 0)
+			{
+				offset += 64 - slot % 64;
+				continue;
+			}
+			offset += std::countr_zero(word);
+			if (offset < slots)
+				best = std::min(best, (position + offset) << shift);
+			break;
+		}
+	}
+	return best;
+}
+
+void sys::timer_wheel::wake(void)
+{
+#if defined(SYS_HAVE_TIMERFD)
+	if (wakeup_fd_ != -1)
+	{
+		const std::uint64_t one = 1;
+		while (::write(wakeup_fd_, &one, sizeof(one)) == -1 && errno == EINTR)
+			;
+		return;
+	}
+#endif
+	cv_.notify_one();
+}
+
+// armed_ holds the tick slept for, zero while the thread is awake and
+// will look at the wheel again anyway
+void sys::timer_wheel::wait(std::unique_lock<std::mutex>& lock, std::uint64_t tick)
+{
+	armed_ = tick;
+#if defined(SYS_HAVE_TIMERFD)
+	if (timer_fd_ != -1 && wakeup_fd_ != -1)
+	{
+		struct itimerspec spec = {};
+		if (tick != no_tick)
+		{
+			const std::uint64_t deadline = tick * resolution_.count();
+			const std::uint64_t current = now();
+			const std::uint64_t delay = deadline > current ? deadline - current : 1;
+			spec.it_value.tv_sec = time_t(delay / 1000000000);
+			spec.it_value.tv_nsec = long(delay % 1000000000);
+		}
+		::timerfd_settime(timer_fd_, 0, &spec, nullptr);
+		lock.unlock();
+
+		struct pollfd fds[2];
+		fds[0].fd = timer_fd_;
+		fds[0].events = POLLIN;
+		fds[1].fd = wakeup_fd_;
+		fds[1].events = POLLIN;
+		if (::poll(fds, 2, -1) > 0)
+		{
+			std::uint64_t count;
+			if (fds[0].revents & POLLIN)
+				while (::read(timer_fd_, &count, sizeof(count)) == -1 && errno == EINTR)
+					;
+			if (fds[1].revents & POLLIN)
+				while (::read(wakeup_fd_, &count, sizeof(count)) == -1 && errno == EINTR)
+					;
+		}
+		lock.lock();
+		armed_ = 0;
+		return;
+	}
+#endif
+	if (tick == no_tick)
+		cv_.wait(lock);
+	else
+		cv_.wait_until(lock, origin_ + tick * resolution_);
+	armed_ = 0;
+}
+
+void sys::timer_wheel::run(void)
+{
+	std::vector<function_type> expired;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!stop_)
+	{
+		advance(now() / resolution_.count(), expired);
+		if (!expired.empty())
+		{
+			lock.unlock();
+			for (function_type& f : expired)
+				pool_.post(std::move(f));
+			expired.clear();
+			lock.lock();
+			continue;
+		}
+		wait(lock, next_tick());
+	}
+}
\ No newline at end of file
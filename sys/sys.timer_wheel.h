@@ -0,0 +1,93 @@
+#ifndef __SYS_TIMER_WHEEL__
+#define __SYS_TIMER_WHEEL__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.thread_group.h"
+#include "sys.thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sys
+{
+	// four levels of 256 slots; a timer sits in the coarsest level that
+	// still tells it apart and moves down as its time comes closer. One
+	// thread advances the wheel and posts expired callbacks to the pool.
+	class timer_wheel : public noncopyable
+	{
+	public:
+		typedef std::uint64_t timer_id;
+		typedef std::function<void(void)> function_type;
+	private:
+		static const std::size_t levels = 4;
+		static const std::size_t slots = 256;
+		static const std::uint32_t nil = 0xffffffffu;
+
+		struct node
+		{
+			std::uint64_t expires = 0;
+			std::uint64_t period = 0;
+			std::uint32_t next = nil;
+			std::uint32_t prev = nil;
+			std::uint32_t generation = 1;
+			std::uint32_t slot = nil;
+			function_type function;
+		};
+	private:
+		thread_group& group_;
+		thread_pool& pool_;
+		std::chrono::nanoseconds resolution_;
+		std::chrono::steady_clock::time_point origin_;
+		std::vector<node> nodes_;
+		std::uint32_t free_;
+		std::uint32_t heads_[levels * slots];
+		std::uint64_t occupied_[levels * slots / 64];
+		std::uint64_t current_;
+		std::uint64_t armed_;
+		std::size_t size_;
+		bool stop_;
+		mutable std::mutex mutex_;
+		std::condition_variable cv_;
+		int timer_fd_;
+		int wakeup_fd_;
+		std::thread::id thread_;
+	public:
+		timer_wheel(thread_group& group, thread_pool& pool);
+		timer_wheel(thread_group& group, thread_pool& pool,
+			std::chrono::nanoseconds resolution);
+		virtual ~timer_wheel(void);
+	public:
+		timer_id schedule(std::chrono::nanoseconds delay, function_type f);
+		timer_id schedule_at(std::chrono::steady_clock::time_point when, function_type f);
+		// runs every period counted from the first run, so late runs do
+		// not push the later ones back; missed periods are skipped
+		timer_id schedule_every(std::chrono::nanoseconds period, function_type f);
+		timer_id schedule_every(std::chrono::nanoseconds first,
+			std::chrono::nanoseconds period, function_type f);
+		// a callback already handed to the pool still runs
+		bool cancel(timer_id id);
+		std::size_t size(void) const;
+	private:
+		timer_id add(std::uint64_t expires, std::uint64_t period, function_type&& f);
+		std::uint64_t now(void) const;
+		std::uint64_t tick_of(std::uint64_t time) const;
+		void link(std::uint32_t index);
+		void unlink(std::uint32_t index);
+		void release(std::uint32_t index);
+		void cascade(std::size_t level, std::size_t slot);
+		void advance(std::uint64_t until, std::vector<function_type>& expired);
+		std::uint64_t next_tick(void) const;
+		void wake(void);
+		void wait(std::unique_lock<std::mutex>& lock, std::uint64_t tick);
+		void run(void);
+	};
+}
+
+#endif
+
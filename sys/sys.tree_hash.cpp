@@ -0,0 +1,637 @@
+#include "sys.config.h"
+#include "sys.tree_hash.h"
+#include "sys.parallel_walker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <thread>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const std::uint64_t prime64_1 = 0x9E3779B185EBCA87ull;
+static const std::uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Full;
+static const std::uint64_t prime64_3 = 0x165667B19E3779F9ull;
+static const std::uint64_t prime64_4 = 0x85EBCA77C2B2AE63ull;
+static const std::uint64_t prime64_5 = 0x27D4EB2F165667C5ull;
+
+static const int high_rotations[8] = { 1, 7, 12, 18, 23, 29, 34, 40 };
+static const int low_rotations[8] = { 41, 35, 30, 24, 19, 13, 8, 2 };
+
+static const char cache_magic[8] = { 'S', 'Y', 'S', 'T', 'H', 'C', '\0', '\0' };
+static const std::uint32_t cache_version = 2;
+static const std::size_t cache_shards = 64;
+static const std::size_t hash_buffer_size = 1 << 20;
+static const std::uint64_t hash_mmap_threshold = 1 << 20;
+
+namespace
+{
+	inline std::uint64_t rotl64(std::uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline std::uint64_t read64(const unsigned char* p)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline std::uint32_t read32(const unsigned char* p)
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline std::uint64_t round64(std::uint64_t acc, std::uint64_t input)
+	{
+		acc += input * prime64_2;
+		acc = rotl64(acc, 31);
+		return acc * prime64_1;
+	}
+
+	inline std::uint64_t merge64(std::uint64_t acc, std::uint64_t value)
+	{
+		acc ^= round64(0, value);
+		return acc * prime64_1 + prime64_4;
+	}
+
+	inline std::uint64_t avalanche64(std::uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= prime64_2;
+		h ^= h >> 29;
+		h *= prime64_3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	// each half of the digest folds in all eight lanes, with its own
+	// rotations and merge order, so neither depends on only part of a stripe
+	std::uint64_t converge(const std::uint64_t* acc, const int* rotations, bool reverse)
+	{
+		std::uint64_t h = 0;
+		for (int i = 0; i < 8; ++i)
+			h += rotl64(acc[i], rotations[i]);
+		for (int i = 0; i < 8; ++i)
+			h = merge64(h, acc[reverse ? 7 - i : i]);
+		return h;
+	}
+
+	std::uint64_t finish(std::uint64_t h, const unsigned char* p, std::size_t size)
+	{
+		for (; size >= 8; p += 8, size -= 8)
+			h = rotl64(h ^ round64(0, read64(p)), 27) * prime64_1 + prime64_4;
+		if (size >= 4)
+		{
+			h = rotl64(h ^ (read32(p) * prime64_1), 23) * prime64_2 + prime64_3;
+			p += 4;
+			size -= 4;
+		}
+		for (; size > 0; ++p, --size)
+			h = rotl64(h ^ (*p * prime64_5), 11) * prime64_1;
+		return avalanche64(h);
+	}
+
+	struct file_meta
+	{
+		std::uint64_t dev;
+		std::uint64_t inode;
+		std::uint64_t size;
+		std::int64_t mtime;
+	};
+
+	struct tree_child
+	{
+		std::string name;
+		std::uint8_t type;
+		sys::content_hash hash;
+	};
+
+	sys::content_hash combine(std::vector<tree_child>& children)
+	{
+		std::sort(children.begin(), children.end(),
+			[](const tree_child& lhs, const tree_child& rhs) {
+				return lhs.name < rhs.name;
+			});
+		sys::hasher h;
+		for (const tree_child& child : children)
+		{
+			unsigned char record[4 + 1 + 16];
+			const std::uint32_t size = static_cast<std::uint32_t>(child.name.size());
+			std::memcpy(record, &size, 4);
+			record[4] = child.type;
+			std::memcpy(record + 5, &child.hash.high, 8);
+			std::memcpy(record + 13, &child.hash.low, 8);
+			h.update(record, 5);
+			h.update(child.name.data(), child.name.size());
+			h.update(record + 5, 16);
+		}
+		return h.digest();
+	}
+
+#if defined(SYS_WIN32)
+	bool stat_file(const sys::walk_entry& entry, file_meta& meta)
+	{
+		struct ::_stat64 st;
+		if (::_stat64(entry.path, &st) != 0)
+			return false;
+		meta.dev = static_cast<std::uint64_t>(st.st_dev);
+		meta.inode = static_cast<std::uint64_t>(st.st_ino);
+		meta.size = static_cast<std::uint64_t>(st.st_size);
+		meta.mtime = static_cast<std::int64_t>(st.st_mtime) * 1000000000;
+		return true;
+	}
+
+	bool hash_file(const sys::walk_entry& entry, const file_meta&,
+		std::vector<unsigned char>& buffer, sys::content_hash& hash)
+	{
+		std::ifstream ifs(entry.path, std::ios::binary);
+		if (!ifs)
+			return false;
+		sys::hasher h;
+		while (ifs)
+		{
+			ifs.read(reinterpret_cast<char*>(buffer.data()),
+				static_cast<std::streamsize>(buffer.size()));
+			h.update(buffer.data(), static_cast<std::size_t>(ifs.gcount()));
+		}
+		if (ifs.bad())
+			return false;
+		hash = h.digest();
+		return true;
+	}
+#else
+	const char* entry_name(const sys::walk_entry& entry)
+	{
+		return entry.dirfd == AT_FDCWD ? entry.path : entry.path + entry.name_pos;
+	}
+
+	bool stat_file(const sys::walk_entry& entry, file_meta& meta)
+	{
+		struct stat st;
+		if (::fstatat(entry.dirfd, entry_name(entry), &st,
+				entry.depth != 0 ? AT_SYMLINK_NOFOLLOW : 0) != 0)
+			return false;
+		meta.dev = static_cast<std::uint64_t>(st.st_dev);
+		meta.inode = static_cast<std::uint64_t>(st.st_ino);
+		meta.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+		meta.mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+		meta.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	bool hash_file(const sys::walk_entry& entry, const file_meta& meta,
+		std::vector<unsigned char>& buffer, sys::content_hash& hash)
+	{
+		sys::hasher h;
+		if (entry.type == sys::symlink_file)
+		{
+			const ssize_t n = ::readlinkat(entry.dirfd, entry_name(entry),
+				reinterpret_cast<char*>(buffer.data()), buffer.size());
+			if (n < 0)
+				return false;
+			h.update(buffer.data(), static_cast<std::size_t>(n));
+			hash = h.digest();
+			return true;
+		}
+
+		const int fd = ::openat(entry.dirfd, entry_name(entry),
+			O_RDONLY | O_CLOEXEC | (entry.depth != 0 ? O_NOFOLLOW : 0));
+		if (fd == -1)
+			return false;
+
+		bool result = true;
+		void* addr = meta.size >= hash_mmap_threshold ?
+			::mmap(nullptr, static_cast<std::size_t>(meta.size), PROT_READ,
+				MAP_SHARED, fd, 0) : MAP_FAILED;
+		if (addr != MAP_FAILED)
+		{
+			::madvise(addr, static_cast<std::size_t>(meta.size), MADV_SEQUENTIAL);
+			h.update(addr, static_cast<std::size_t>(meta.size));
+			::munmap(addr, static_cast<std::size_t>(meta.size));
+		}
+		else
+		{
+			for (;;)
+			{
+				const ssize_t n = ::read(fd, buffer.data(), buffer.size());
+				if (n == 0)
+					break;
+				if (n < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					result = false;
+					break;
+				}
+				h.update(buffer.data(), static_cast<std::size_t>(n));
+			}
+		}
+		const int err = errno;
+		::close(fd);
+		errno = err;
+		if (result)
+			hash = h.digest();
+		return result;
+	}
+#endif
+
+	class hash_visitor : public sys::walk_visitor
+	{
+		struct alignas(64) shard
+		{
+			std::mutex mutex;
+			std::unordered_map<std::string, std::vector<tree_child>> dirs;
+		};
+
+		struct alignas(64) worker
+		{
+			std::vector<unsigned char> buffer;
+		};
+
+		sys::tree_hash_cache* cache_;
+		std::vector<shard> shards_;
+		std::vector<worker> workers_;
+		std::atomic<int> error_;
+	public:
+		hash_visitor(sys::tree_hash_cache* cache, std::size_t workers)
+			: cache_(cache)
+			, shards_(cache_shards)
+			, workers_(workers)
+			, error_(0)
+		{
+		}
+
+		sys::walk_action_t visit(const sys::walk_entry& entry,
+			std::size_t index) override
+		{
+			tree_child child;
+			child.name.assign(entry.path + entry.name_pos, entry.size - entry.name_pos);
+			child.type = static_cast<std::uint8_t>(entry.type);
+
+			if (entry.type == sys::directory_file)
+			{
+				std::vector<tree_child> children;
+				take(std::string_view(entry.path, entry.size), children);
+				child.hash = combine(children);
+			}
+			else if (entry.type == sys::regular_file || entry.type == sys::symlink_file)
+			{
+				worker& w = workers_[index];
+				if (w.buffer.empty())
+					w.buffer.resize(hash_buffer_size);
+				if (!hash_entry(entry, w.buffer, child.hash))
+					set_error(errno);
+			}
+
+			add(std::string_view(entry.path,
+				entry.name_pos > 1 ? entry.name_pos - 1 : entry.name_pos),
+				std::move(child));
+			return sys::walk_continue;
+		}
+
+		void take(std::string_view dirname, std::vector<tree_child>& children)
+		{
+			shard& s = find(dirname);
+			std::lock_guard<std::mutex> guard(s.mutex);
+			const auto it = s.dirs.find(std::string(dirname));
+			if (it == s.dirs.end())
+				return;
+			children.swap(it->second);
+			s.dirs.erase(it);
+		}
+
+		void set_error(int err)
+		{
+			int expected = 0;
+			error_.compare_exchange_strong(expected, err);
+		}
+
+		int error(void) const
+		{
+			return error_.load();
+		}
+	private:
+		shard& find(std::string_view dirname)
+		{
+			return shards_[std::hash<std::string_view>()(dirname) % shards_.size()];
+		}
+
+		void add(std::string_view dirname, tree_child&& child)
+		{
+			shard& s = find(dirname);
+			std::lock_guard<std::mutex> guard(s.mutex);
+			s.dirs[std::string(dirname)].push_back(std::move(child));
+		}
+
+		bool hash_entry(const sys::walk_entry& entry,
+			std::vector<unsigned char>& buffer, sys::content_hash& hash)
+		{
+			file_meta meta;
+			if (!stat_file(entry, meta))
+				return false;
+			if (cache_ != nullptr &&
+				cache_->lookup(meta.dev, meta.inode, meta.size, meta.mtime, hash))
+				return true;
+			if (!hash_file(entry, meta, buffer, hash))
+				return false;
+			if (cache_ != nullptr)
+				cache_->store(meta.dev, meta.inode, meta.size, meta.mtime, hash);
+			return true;
+		}
+	};
+
+	sys::content_hash tree_hash(const sys::path& root, sys::thread_group& group,
+		sys::tree_hash_cache* cache, int& error)
+	{
+		error = 0;
+		std::string root_name(root.native());
+		while (root_name.size() > 1 &&
+				std::strchr(sys::path::separators, root_name.back()))
+			root_name.pop_back();
+
+		sys::parallel_walk_options options;
+		options.order = sys::walk_post_order;
+		options.threads = std::max(1u, std::thread::hardware_concurrency());
+		hash_visitor visitor(cache, options.threads);
+
+		// the root is followed, so a symlink to a directory hashes the tree
+		const sys::file_type_t type = root.target_status();
+		if (type != sys::directory_file)
+		{
+			sys::walk_entry entry;
+			entry.path = root_name.c_str();
+			entry.size = root_name.size();
+			entry.name_pos = 0;
+			entry.depth = 0;
+			entry.inode = 0;
+			entry.type = type;
+			entry.order = sys::walk_post_order;
+			entry.dirfd = AT_FDCWD;
+			visitor.visit(entry, 0);
+			std::vector<tree_child> children;
+			visitor.take(std::string_view(), children);
+			error = visitor.error();
+			if (type == sys::file_not_found || type == sys::status_error)
+				error = ENOENT;
+			return children.empty() ? sys::content_hash() : children.front().hash;
+		}
+
+		sys::parallel_walker w(root_name, options);
+		w.walk(group, visitor);
+		error = visitor.error() != 0 ? visitor.error() : w.error();
+
+		std::vector<tree_child> children;
+		visitor.take(root_name, children);
+		return combine(children);
+	}
+}
+
+std::string sys::content_hash::hex(void) const
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string result(32, '0');
+	for (int i = 0; i < 16; ++i)
+	{
+		result[15 - i] = digits[(high >> (i * 4)) & 0xf];
+		result[31 - i] = digits[(low >> (i * 4)) & 0xf];
+	}
+	return result;
+}
+
+sys::hasher::hasher(void)
+	: hasher(0)
+{
+}
+
+sys::hasher::hasher(std::uint64_t seed)
+	: seed_(seed)
+{
+	reset();
+}
+
+void sys::hasher::reset(void)
+{
+	const std::uint64_t seed2 = seed_ ^ prime64_3;
+	acc_[0] = seed_ + prime64_1 + prime64_2;
+	acc_[1] = seed_ + prime64_2;
+	acc_[2] = seed_;
+	acc_[3] = seed_ - prime64_1;
+	acc_[4] = seed2 + prime64_1 + prime64_2;
+	acc_[5] = seed2 + prime64_2;
+	acc_[6] = seed2;
+	acc_[7] = seed2 - prime64_1;
+	buffered_ = 0;
+	total_ = 0;
+}
+
+void sys::hasher::update(const void* data, std::size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	total_ += size;
+
+	if (buffered_ != 0)
+	{
+		const std::size_t fill = std::min(size, sizeof(buffer_) - buffered_);
+		std::memcpy(buffer_ + buffered_, p, fill);
+		buffered_ += fill;
+		p += fill;
+		size -= fill;
+		if (buffered_ < sizeof(buffer_))
+			return;
+		consume(buffer_);
+		buffered_ = 0;
+	}
+
+	for (; size >= sizeof(buffer_); p += sizeof(buffer_), size -= sizeof(buffer_))
+		consume(p);
+
+	std::memcpy(buffer_, p, size);
+	buffered_ = size;
+}
+
+sys::content_hash sys::hasher::digest(void) const
+{
+	std::uint64_t h1, h2;
+	if (total_ >= sizeof(buffer_))
+	{
+		h1 = converge(acc_, high_rotations, false);
+		h2 = converge(acc_, low_rotations, true);
+	}
+	else
+	{
+		h1 = seed_ + prime64_5;
+		h2 = (seed_ ^ prime64_3) + prime64_5;
+	}
+	h1 += total_;
+	h2 += total_ * prime64_1;
+
+	content_hash result;
+	result.high = finish(h1, buffer_, buffered_);
+	result.low = finish(h2 ^ rotl64(result.high, 29), buffer_, buffered_);
+	return result;
+}
+
+void sys::hasher::consume(const unsigned char* p)
+{
+	// eight independent lanes so the loop vectorises where the target allows
+	for (int i = 0; i < 8; ++i)
+		acc_[i] = round64(acc_[i], read64(p + i * 8));
+}
+
+std::size_t sys::tree_hash_cache::key_hash::operator()(const key& k) const
+{
+	return static_cast<std::size_t>(
+		avalanche64(k.inode ^ rotl64(k.dev, 32)));
+}
+
+sys::tree_hash_cache::tree_hash_cache(void)
+	: shards_(cache_shards)
+{
+}
+
+sys::tree_hash_cache::~tree_hash_cache(void)
+{
+}
+
+bool sys::tree_hash_cache::lookup(std::uint64_t dev, std::uint64_t inode,
+	std::uint64_t size, std::int64_t mtime, sys::content_hash& hash)
+{
+	const key k = { dev, inode };
+	shard& s = find(k);
+	std::lock_guard<std::mutex> guard(s.mutex);
+	const auto it = s.records.find(k);
+	if (it == s.records.end() || it->second.size != size ||
+		it->second.mtime != mtime)
+		return false;
+	it->second.used = true;
+	hash = it->second.hash;
+	return true;
+}
+
+void sys::tree_hash_cache::store(std::uint64_t dev, std::uint64_t inode,
+	std::uint64_t size, std::int64_t mtime, const sys::content_hash& hash)
+{
+	const key k = { dev, inode };
+	shard& s = find(k);
+	std::lock_guard<std::mutex> guard(s.mutex);
+	s.records[k] = { size, mtime, hash, true };
+}
+
+void sys::tree_hash_cache::prune(void)
+{
+	for (shard& s : shards_)
+	{
+		std::lock_guard<std::mutex> guard(s.mutex);
+		for (auto it = s.records.begin(); it != s.records.end(); )
+		{
+			if (!it->second.used)
+				it = s.records.erase(it);
+			else
+			{
+				it->second.used = false;
+				++it;
+			}
+		}
+	}
+}
+
+void sys::tree_hash_cache::clear(void)
+{
+	for (shard& s : shards_)
+	{
+		std::lock_guard<std::mutex> guard(s.mutex);
+		s.records.clear();
+	}
+}
+
+std::size_t sys::tree_hash_cache::size(void)
+{
+	std::size_t count = 0;
+	for (shard& s : shards_)
+	{
+		std::lock_guard<std::mutex> guard(s.mutex);
+		count += s.records.size();
+	}
+	return count;
+}
+
+bool sys::tree_hash_cache::load(const sys::path& name)
+{
+	std::ifstream ifs(name.c_str(), std::ios::binary);
+	char magic[8];
+	std::uint32_t version = 0;
+	std::uint64_t count = 0;
+	ifs.read(magic, sizeof(magic));
+	ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+	ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+	if (!ifs || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+		version != cache_version)
+		return false;
+
+	clear();
+	for (std::uint64_t i = 0; i < count; ++i)
+	{
+		std::uint64_t fields[6];
+		if (!ifs.read(reinterpret_cast<char*>(fields), sizeof(fields)))
+			return false;
+		const key k = { fields[0], fields[1] };
+		find(k).records[k] = { fields[2], static_cast<std::int64_t>(fields[3]),
+			{ fields[4], fields[5] }, false };
+	}
+	return true;
+}
+
+bool sys::tree_hash_cache::save(const sys::path& name)
+{
+	std::ofstream ofs(name.c_str(), std::ios::binary | std::ios::trunc);
+	const std::uint64_t count = size();
+	ofs.write(cache_magic, sizeof(cache_magic));
+	ofs.write(reinterpret_cast<const char*>(&cache_version), sizeof(cache_version));
+	ofs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	for (shard& s : shards_)
+	{
+		std::lock_guard<std::mutex> guard(s.mutex);
+		for (const auto& r : s.records)
+		{
+			const std::uint64_t fields[6] = {
+				r.first.dev, r.first.inode, r.second.size,
+				static_cast<std::uint64_t>(r.second.mtime),
+				r.second.hash.high, r.second.hash.low
+			};
+			ofs.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+		}
+	}
+	return ofs.good();
+}
+
+sys::tree_hash_cache::shard& sys::tree_hash_cache::find(const key& k)
+{
+	return shards_[key_hash()(k) % shards_.size()];
+}
+
+sys::content_hash sys::tree_hash(const sys::path& root, sys::thread_group& group,
+	int& error)
+{
+	return ::tree_hash(root, group, nullptr, error);
+}
+
+sys::content_hash sys::tree_hash(const sys::path& root, sys::thread_group& group,
+	sys::tree_hash_cache& cache, int& error)
+{
+	return ::tree_hash(root, group, &cache, error);
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef __SYS_TREE_HASH__
+#define __SYS_TREE_HASH__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sys
+{
+	struct content_hash
+	{
+		std::uint64_t high = 0;
+		std::uint64_t low = 0;
+
+		bool operator==(const content_hash& other) const
+		{
+			return high == other.high && low == other.low;
+		}
+
+		bool operator!=(const content_hash& other) const
+		{
+			return !(*this == other);
+		}
+
+		std::string hex(void) const;
+	};
+
+	// 128-bit non-cryptographic hash built from eight xxh64 lanes, each
+	// half of the digest mixing all of them; not for adversarial input
+	class hasher
+	{
+		std::uint64_t acc_[8];
+		unsigned char buffer_[64];
+		std::size_t buffered_;
+		std::uint64_t total_;
+		std::uint64_t seed_;
+	public:
+		hasher(void);
+		hasher(std::uint64_t seed);
+	public:
+		void reset(void);
+		void update(const void* data, std::size_t size);
+		content_hash digest(void) const;
+	private:
+		void consume(const unsigned char* p);
+	};
+
+	class tree_hash_cache : public noncopyable
+	{
+		struct key
+		{
+			std::uint64_t dev;
+			std::uint64_t inode;
+
+			bool operator==(const key& other) const
+			{
+				return dev == other.dev && inode == other.inode;
+			}
+		};
+
+		struct key_hash
+		{
+			std::size_t operator()(const key& k) const;
+		};
+
+		struct record
+		{
+			std::uint64_t size;
+			std::int64_t mtime;
+			content_hash hash;
+			bool used;
+		};
+
+		struct alignas(64) shard
+		{
+			std::mutex mutex;
+			std::unordered_map<key, record, key_hash> records;
+		};
+	private:
+		std::vector<shard> shards_;
+	public:
+		tree_hash_cache(void);
+		virtual ~tree_hash_cache(void);
+	public:
+		bool lookup(std::uint64_t dev, std::uint64_t inode, std::uint64_t size,
+			std::int64_t mtime, content_hash& hash);
+		void store(std::uint64_t dev, std::uint64_t inode, std::uint64_t size,
+			std::int64_t mtime, const content_hash& hash);
+		// drops records not looked up or stored since the last prune
+		void prune(void);
+		void clear(void);
+		std::size_t size(void);
+	public:
+		bool load(const path& name);
+		bool save(const path& name);
+	private:
+		shard& find(const key& k);
+	};
+
+	// a symlink given as root is followed, those below it are hashed as links
+	content_hash tree_hash(const path& root, thread_group& group, int& error);
+	content_hash tree_hash(const path& root, thread_group& group,
+		tree_hash_cache& cache, int& error);
+}
+
+#endif
+
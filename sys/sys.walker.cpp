@@ -0,0 +1,225 @@
+#include "sys.config.h"
+#include "sys.walker.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if !defined(SYS_WIN32)
+#include <fcntl.h>
+#endif
+
+static const std::size_t walker_batch_size = 256;
+
+sys::walker::walker(const sys::path& root)
+	: walker(root, walk_options())
+{
+}
+
+sys::walker::walker(const sys::path& root, const sys::walk_options& options)
+	: root_(root)
+	, options_(options)
+	, error_(0)
+{
+}
+
+sys::walker::~walker(void)
+{
+}
+
+sys::walker& sys::walker::filter(const filter_type& f)
+{
+	filter_ = f;
+	return *this;
+}
+
+int sys::walker::error(void) const
+{
+	return error_;
+}
+
+bool sys::walker::walk(const visitor_type& visit)
+{
+	error_ = 0;
+	path_.assign(root_.native());
+	while (path_.size() > 1 && std::strchr(path::separators, path_.back()))
+		path_.pop_back();
+
+#if defined(SYS_WIN32)
+	dir d(path_.c_str(), options_.buffer_size);
+	if (!d.is_open())
+	{
+		error_ = ENOENT;
+		return false;
+	}
+#else
+	dir d(AT_FDCWD, path_.c_str(), true, options_.buffer_size);
+	if (!d.is_open() || !enter_dir(d))
+	{
+		error_ = errno;
+		return false;
+	}
+#endif
+
+	const walk_action_t action = walk_dir(d, 1, visit);
+	ancestors_.clear();
+	return action != walk_stop;
+}
+
+sys::walk_action_t sys::walker::walk_dir(sys::dir& d, std::size_t depth,
+	const visitor_type& visit)
+{
+	if (batches_.size() < depth)
+		batches_.resize(depth, std::vector<dir_entry>(walker_batch_size));
+	std::vector<dir_entry>& batch = batches_[depth - 1];
+
+	const std::size_t base = path_.size();
+	const bool need_separator =
+		base != 0 && !std::strchr(path::separators, path_[base - 1]);
+
+	std::size_t count;
+	while ((count = d.read_batch(batch)) > 0)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			path_.resize(base);
+			if (need_separator)
+				path_ += path::preferred_separator;
+			path_.append(batch[i].name, batch[i].size);
+
+			walk_entry entry;
+			entry.path = path_.c_str();
+			entry.size = path_.size();
+			entry.name_pos = path_.size() - batch[i].size;
+			entry.depth = depth;
+			entry.inode = batch[i].inode;
+			entry.type = batch[i].type;
+			entry.order = walk_pre_order;
+#if defined(SYS_WIN32)
+			entry.dirfd = AT_FDCWD;
+#else
+			entry.dirfd = d.native_handle();
+#endif
+			if (walk_entry_at(d, entry, visit) == walk_stop)
+				return walk_stop;
+		}
+	}
+	if (d.error() != 0 && error_ == 0)
+		error_ = d.error();
+	path_.resize(base);
+	return walk_continue;
+}
+
+sys::walk_action_t sys::walker::walk_entry_at(sys::dir& d,
+	sys::walk_entry& entry, const visitor_type& visit)
+{
+	if (entry.type == type_unknown ||
+		(entry.type == symlink_file && options_.follow_symlinks))
+		entry.type = resolve_type(d, entry);
+
+	walk_action_t action(walk_continue);
+	if (filter_)
+	{
+		action = filter_(entry);
+		if (action != walk_continue)
+			return action;
+	}
+
+	bool descend = entry.type == directory_file &&
+		entry.depth < options_.max_depth;
+
+	if (options_.order & walk_pre_order)
+	{
+		action = visit(entry);
+		if (action == walk_stop)
+			return walk_stop;
+		if (action == walk_skip)
+			descend = false;
+	}
+
+	if (descend)
+	{
+#if defined(SYS_WIN32)
+		dir child(entry.path, options_.buffer_size);
+		if (!child.is_open())
+		{
+			if (error_ == 0)
+				error_ = ENOENT;
+		}
+		else
+		{
+			action = walk_dir(child, entry.depth + 1, visit);
+		}
+#else
+		dir child(d.native_handle(), entry.path + entry.name_pos,
+			options_.follow_symlinks, options_.buffer_size);
+		if (!child.is_open())
+		{
+			if (error_ == 0)
+				error_ = errno;
+		}
+		else if (enter_dir(child))
+		{
+			action = walk_dir(child, entry.depth + 1, visit);
+			ancestors_.pop_back();
+		}
+#endif
+		if (action == walk_stop)
+			return walk_stop;
+		entry.path = path_.c_str();
+	}
+
+	if (options_.order & walk_post_order)
+	{
+		entry.order = walk_post_order;
+		if (visit(entry) == walk_stop)
+			return walk_stop;
+	}
+	return walk_continue;
+}
+
+sys::file_type_t sys::walker::resolve_type(sys::dir& d,
+	const sys::walk_entry& entry)
+{
+#if defined(SYS_WIN32)
+	(void)d;
+	return path(entry.path).status();
+#else
+	const file_type_t type = d.status(entry.path + entry.name_pos,
+		options_.follow_symlinks);
+	if (type == status_error && entry.type != type_unknown)
+		return entry.type;
+	return type;
+#endif
+}
+
+bool sys::walker::enter_dir(sys::dir& child)
+{
+#if defined(SYS_WIN32)
+	(void)child;
+	return true;
+#else
+	struct stat st;
+	if (::fstat(child.native_handle(), &st) != 0)
+	{
+		if (error_ == 0)
+			error_ = errno;
+		return false;
+	}
+	if (!ancestors_.empty())
+	{
+		if (options_.same_filesystem && st.st_dev != ancestors_.front().dev)
+			return false;
+		if (options_.follow_symlinks)
+		{
+			for (const ancestor& a : ancestors_)
+			{
+				if (a.dev == st.st_dev && a.inode == st.st_ino)
+					return false;
+			}
+		}
+	}
+	ancestors_.push_back({ static_cast<std::uint64_t>(st.st_dev),
+		static_cast<std::uint64_t>(st.st_ino) });
+	return true;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef __SYS_WALKER__
+#define __SYS_WALKER__
+
+#include "sys.config.h"
+#include "sys.dir.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sys
+{
+	typedef enum
+	{
+		walk_continue, walk_skip, walk_stop
+	} walk_action_t;
+
+	typedef enum
+	{
+		walk_pre_order = 1, walk_post_order = 2
+	} walk_order_t;
+
+	struct walk_options
+	{
+		int order = walk_pre_order;
+		std::size_t max_depth = static_cast<std::size_t>(-1);
+		bool same_filesystem = false;
+		bool follow_symlinks = false;
+		// per open directory; dir::large_buffer_size suits a few huge ones
+		std::size_t buffer_size = dir::default_buffer_size;
+	};
+
+	struct walk_entry
+	{
+		const char* path;
+		std::size_t size;
+		std::size_t name_pos;
+		std::size_t depth;
+		std::uint64_t inode;
+		file_type_t type;
+		walk_order_t order;
+		int dirfd;
+	};
+
+	class walker : public noncopyable
+	{
+	public:
+		typedef std::function<walk_action_t(const walk_entry&)> filter_type;
+		typedef std::function<walk_action_t(const walk_entry&)> visitor_type;
+	private:
+		struct ancestor
+		{
+			std::uint64_t dev;
+			std::uint64_t inode;
+		};
+	private:
+		path root_;
+		walk_options options_;
+		filter_type filter_;
+		std::string path_;
+		std::vector<ancestor> ancestors_;
+		std::deque<std::vector<dir_entry>> batches_;
+		int error_;
+	public:
+		walker(const path& root);
+		walker(const path& root, const walk_options& options);
+		virtual ~walker(void);
+	public:
+		walker& filter(const filter_type& f);
+		bool walk(const visitor_type& visit);
+		int error(void) const;
+	private:
+		walk_action_t walk_dir(dir& d, std::size_t depth,
+			const visitor_type& visit);
+		walk_action_t walk_entry_at(dir& d, walk_entry& entry,
+			const visitor_type& visit);
+		file_type_t resolve_type(dir& d, const walk_entry& entry);
+		bool enter_dir(dir& child);
+	};
+}
+
+#endif
+
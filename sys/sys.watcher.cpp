@@ -0,0 +1,348 @@
+#include "sys.config.h"
+#include "sys.watcher.h"
+#include "sys.walker.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(SYS_HAVE_INOTIFY)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+static const std::uint32_t watcher_mask = IN_CREATE | IN_DELETE | IN_MODIFY |
+	IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+	IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+#endif
+
+thread_local bool sys::watcher::stopped_ = false;
+
+sys::watcher::watcher(const sys::path& root)
+	: watcher(root, std::chrono::milliseconds(50))
+{
+}
+
+sys::watcher::watcher(const sys::path& root, std::chrono::milliseconds window)
+	: root_(root)
+	, window_(window)
+	, group_(nullptr)
+	, reader_()
+	, dispatcher_()
+	, fd_(-1)
+	, wakeup_(-1)
+	, stop_(false)
+{
+}
+
+sys::watcher::~watcher(void)
+{
+	stop();
+}
+
+bool sys::watcher::start(sys::thread_group& group, const callback_type& callback)
+{
+#if defined(SYS_HAVE_INOTIFY)
+	if (reader_ != std::thread::id())
+		return false;
+
+	fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	wakeup_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd_ == -1 || wakeup_ == -1)
+	{
+		stop();
+		return false;
+	}
+
+	std::string root(root_.native());
+	while (root.size() > 1 && std::strchr(path::separators, root.back()))
+		root.pop_back();
+	root_.assign(root);
+
+	add_watches(root, false);
+	if (watches_.empty())
+	{
+		stop();
+		return false;
+	}
+
+	callback_ = callback;
+	group_ = &group;
+	stop_.store(false, std::memory_order_relaxed);
+	// under the lock, so a callback calling stop() sees both ids
+	std::lock_guard<std::mutex> guard(mutex_);
+	reader_ = group.create([this]() { read_events(); });
+	dispatcher_ = group.create([this]() { dispatch(); });
+	return true;
+#else
+	(void)group;
+	(void)callback;
+	return false;
+#endif
+}
+
+void sys::watcher::stop(void)
+{
+#if defined(SYS_HAVE_INOTIFY)
+	stop_.store(true, std::memory_order_release);
+	if (wakeup_ != -1)
+	{
+		const std::uint64_t one = 1;
+		while (::write(wakeup_, &one, sizeof(one)) == -1 && errno == EINTR)
+			;
+	}
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		cv_.notify_all();
+	}
+	for (std::thread::id id : { reader_, dispatcher_ })
+	{
+		if (id == std::thread::id())
+			continue;
+		std::jthread t = group_->remove(id);
+		if (!t.joinable())
+			continue;
+		if (id == std::this_thread::get_id())
+		{
+			stopped_ = true;
+			t.detach();
+		}
+		else
+			t.join();
+	}
+	reader_ = std::thread::id();
+	dispatcher_ = std::thread::id();
+	group_ = nullptr;
+
+	if (fd_ != -1)
+		::close(fd_);
+	if (wakeup_ != -1)
+		::close(wakeup_);
+	fd_ = -1;
+	wakeup_ = -1;
+	watches_.clear();
+	moves_.clear();
+	pending_.clear();
+	index_.clear();
+	batches_.clear();
+#endif
+}
+
+void sys::watcher::read_events(void)
+{
+#if defined(SYS_HAVE_INOTIFY)
+	alignas(struct inotify_event) char buf[65536];
+	struct pollfd fds[2];
+	fds[0].fd = fd_;
+	fds[0].events = POLLIN;
+	fds[1].fd = wakeup_;
+	fds[1].events = POLLIN;
+
+	while (!stop_.load(std::memory_order_acquire))
+	{
+		int timeout = -1;
+		if (!pending_.empty())
+		{
+			const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - first_);
+			timeout = elapsed >= window_ ? 0 :
+				static_cast<int>((window_ - elapsed).count());
+		}
+
+		const int result = ::poll(fds, 2, timeout);
+		if (result == -1 && errno != EINTR)
+			break;
+		if (result > 0 && (fds[1].revents & POLLIN))
+			break;
+
+		if (result > 0 && (fds[0].revents & POLLIN))
+		{
+			ssize_t size;
+			while ((size = ::read(fd_, buf, sizeof(buf))) > 0)
+			{
+				for (const char* p = buf; p < buf + size; )
+				{
+					const struct inotify_event* ev =
+						reinterpret_cast<const struct inotify_event*>(p);
+					p += sizeof(struct inotify_event) + ev->len;
+
+					if (ev->mask & IN_Q_OVERFLOW)
+					{
+						resync();
+						continue;
+					}
+
+					const auto it = watches_.find(ev->wd);
+					if (it == watches_.end())
+						continue;
+					if (ev->mask & IN_IGNORED)
+					{
+						watches_.erase(it);
+						continue;
+					}
+					if (ev->len == 0)
+						continue;
+
+					std::string name(it->second);
+					name += path::preferred_separator;
+					name += ev->name;
+					const bool directory = (ev->mask & IN_ISDIR) != 0;
+
+					unsigned events = 0;
+					if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+						events |= watch_created;
+					if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+						events |= watch_removed;
+					if (ev->mask & (IN_MODIFY | IN_CLOSE_WRITE))
+						events |= watch_modified;
+					if (ev->mask & IN_ATTRIB)
+						events |= watch_attrib;
+
+					if (directory && (ev->mask & IN_CREATE))
+						add_watches(name, true);
+					else if (directory && (ev->mask & IN_MOVED_FROM))
+						moves_[ev->cookie] = name;
+					else if (directory && (ev->mask & IN_MOVED_TO))
+					{
+						const auto from = moves_.find(ev->cookie);
+						if (from != moves_.end())
+						{
+							rename_watches(from->second, name);
+							moves_.erase(from);
+						}
+						else
+							add_watches(name, true);
+					}
+					record(name, events, directory);
+				}
+			}
+
+			for (const auto& move : moves_)
+				remove_watches(move.second);
+			moves_.clear();
+		}
+
+		if (!pending_.empty() &&
+			std::chrono::steady_clock::now() - first_ >= window_)
+			flush();
+	}
+#endif
+}
+
+void sys::watcher::dispatch(void)
+{
+	std::vector<watch_event> batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this]() {
+				return stop_.load(std::memory_order_acquire) || !batches_.empty();
+			});
+			if (stop_.load(std::memory_order_acquire))
+				break;
+			batch.swap(batches_.front());
+			batches_.pop_front();
+		}
+		callback_(batch);
+		// stopped from the callback, the watcher may already be gone
+		if (stopped_)
+			return;
+		batch.clear();
+	}
+}
+
+void sys::watcher::add_watches(const std::string& dirname, bool report)
+{
+#if defined(SYS_HAVE_INOTIFY)
+	const int wd = ::inotify_add_watch(fd_, dirname.c_str(), watcher_mask);
+	if (wd == -1)
+		return;
+	watches_[wd] = dirname;
+
+	walk_options options;
+	options.order = walk_pre_order;
+	options.same_filesystem = true;
+	walker w(dirname, options);
+	w.walk([this, report](const walk_entry& entry) {
+		const bool directory = entry.type == directory_file;
+		if (directory)
+		{
+			const int wd = ::inotify_add_watch(fd_, entry.path, watcher_mask);
+			if (wd != -1)
+				watches_[wd].assign(entry.path, entry.size);
+		}
+		if (report)
+			record(std::string(entry.path, entry.size), watch_created, directory);
+		return walk_continue;
+	});
+#else
+	(void)dirname;
+	(void)report;
+#endif
+}
+
+void sys::watcher::remove_watches(const std::string& dirname)
+{
+#if defined(SYS_HAVE_INOTIFY)
+	for (auto it = watches_.begin(); it != watches_.end(); )
+	{
+		const std::string& name = it->second;
+		if (name.compare(0, dirname.size(), dirname) == 0 &&
+			(name.size() == dirname.size() ||
+				name[dirname.size()] == path::preferred_separator))
+		{
+			::inotify_rm_watch(fd_, it->first);
+			it = watches_.erase(it);
+		}
+		else
+			++it;
+	}
+#else
+	(void)dirname;
+#endif
+}
+
+void sys::watcher::rename_watches(const std::string& from, const std::string& to)
+{
+	for (auto& watch : watches_)
+	{
+		std::string& name = watch.second;
+		if (name.compare(0, from.size(), from) == 0 &&
+			(name.size() == from.size() ||
+				name[from.size()] == path::preferred_separator))
+			name.replace(0, from.size(), to);
+	}
+}
+
+void sys::watcher::resync(void)
+{
+	pending_.clear();
+	index_.clear();
+	moves_.clear();
+	add_watches(root_.native(), false);
+	record(root_.native(), watch_rescan, true);
+}
+
+void sys::watcher::record(const std::string& name, unsigned events,
+	bool directory)
+{
+	const auto it = index_.find(name);
+	if (it != index_.end())
+	{
+		pending_[it->second].events |= events;
+		return;
+	}
+	if (pending_.empty())
+		first_ = std::chrono::steady_clock::now();
+	index_.emplace(name, pending_.size());
+	pending_.push_back({ name, events, directory });
+}
+
+void sys::watcher::flush(void)
+{
+	std::lock_guard<std::mutex> guard(mutex_);
+	batches_.push_back(std::move(pending_));
+	pending_.clear();
+	index_.clear();
+	cv_.notify_one();
+}
\ No newline at end of file
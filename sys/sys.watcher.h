@@ -0,0 +1,83 @@
+#ifndef __SYS_WATCHER__
+#define __SYS_WATCHER__
+
+#include "sys.config.h"
+#include "sys.noncopyable.h"
+#include "sys.path.h"
+#include "sys.thread_group.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sys
+{
+	typedef enum
+	{
+		watch_created = 1, watch_removed = 2, watch_modified = 4,
+		watch_attrib = 8, watch_rescan = 16
+	} watch_event_t;
+
+	struct watch_event
+	{
+		std::string path;
+		unsigned events;
+		bool directory;
+	};
+
+	class watcher : public noncopyable
+	{
+	public:
+		typedef std::function<void(std::vector<watch_event>&)> callback_type;
+	private:
+		path root_;
+		std::chrono::milliseconds window_;
+		callback_type callback_;
+		thread_group* group_;
+		std::thread::id reader_;
+		std::thread::id dispatcher_;
+		int fd_;
+		int wakeup_;
+		std::atomic<bool> stop_;
+		std::unordered_map<int, std::string> watches_;
+		std::unordered_map<std::uint32_t, std::string> moves_;
+		std::vector<watch_event> pending_;
+		std::unordered_map<std::string, std::size_t> index_;
+		std::chrono::steady_clock::time_point first_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::deque<std::vector<watch_event>> batches_;
+	private:
+		// set on a dispatcher thread whose callback called stop()
+		static thread_local bool stopped_;
+	public:
+		watcher(const path& root);
+		watcher(const path& root, std::chrono::milliseconds window);
+		virtual ~watcher(void);
+	public:
+		bool start(thread_group& group, const callback_type& callback);
+		// may be called from the callback; the dispatcher thread is then
+		// left to end on its own once the callback returns
+		void stop(void);
+	private:
+		void read_events(void);
+		void dispatch(void);
+		void add_watches(const std::string& dirname, bool report);
+		void remove_watches(const std::string& dirname);
+		void rename_watches(const std::string& from, const std::string& to);
+		void resync(void);
+		void record(const std::string& name, unsigned events, bool directory);
+		void flush(void);
+	};
+}
+
+#endif
+